@@ -34,6 +34,8 @@
 #include <gxx/device/mouse.h>
 #include <gxx/device/charinput.h>
 #include <gxx/cursor.h>
+#include <gxx/taskqueue.h>
+#include <gxx/framestats.h>
 
 #include <gx/gglobal.h>
 #include <gx/gtime.h>
@@ -42,6 +44,8 @@
 #include <vector>
 #include <queue>
 #include <string>
+#include <atomic>
+#include <unordered_map>
 
 
 namespace gxx
@@ -55,6 +59,23 @@ class AppContext;
 
 class NWindow;
 
+struct NativeBackend;
+
+/**
+ * Counters reported by the native backend for the last completed frame
+ */
+struct NativeFrameStats
+{
+    // Synchronous requests that blocked on a reply of the window system
+    uint32_t roundTrips = 0;
+    // Writes of the buffered requests to the window system connection
+    uint32_t flushes = 0;
+    // Queued pointer motion events merged into a later one of the same window
+    uint32_t compressedMotions = 0;
+    // Pixel bytes handed to the window system by software framebuffer presents
+    uint64_t uploadedBytes = 0;
+};
+
 /**
  * Interface for methods related to window oriented low-level windows+attribute encapsulation for upper level windows
  */
@@ -128,6 +149,18 @@ public:
 
     virtual void getCursorPosition(int32_t &x, int32_t &y) = 0;
 
+    void setFixedTimeStep(double step, uint32_t maxSteps);
+
+    double getFixedTimeStep() const;
+
+    uint32_t getFixedMaxSteps() const;
+
+    double getFixedStepAlpha() const;
+
+    void setMotionCompression(bool enable);
+
+    bool isMotionCompression() const;
+
 protected:
     friend class Window;
 
@@ -151,6 +184,13 @@ protected:
     bool mFocused = true;
 
     CursorMode::Enum mCursorMode = CursorMode::Normal;
+
+    double mFixedStep = 0;
+    uint32_t mFixedMaxSteps = 5;
+    double mFixedAccumulator = 0;
+    double mFixedAlpha = 0;
+
+    bool mMotionCompression = true;
 };
 
 /**
@@ -207,15 +247,36 @@ public:
 protected:
     void handleEvent(Event *event) override;
 
+private:
+    /**
+     * Run the fixed timestep driver for one frame
+     * @return false if the window asked to exit
+     */
+    bool fixedUpdate(double delta);
+
+    /**
+     * Close the timing of the previous frame and start a new one
+     * @param now   FrameStats::now() at the start of the native pump
+     */
+    void beginFrameTiming(int64_t now);
+
+    void setPhaseTime(FramePhase::Enum phase, int64_t start, int64_t end);
+
 private:
     friend class AppContext;
 
+    friend class Window;
+
     NWindow *mNativeWindow = nullptr;
 
     EventMana *mEventMana = nullptr;
 
     gx::GTime mFrameTime;
 
+    FrameStats mFrameStats;
+    FrameTiming mFrameTiming;
+    int64_t mFrameStart = 0;
+
     bool mRunning = false;
     bool mExited = false;
 };
@@ -244,6 +305,12 @@ public:
 
     void closeAll();
 
+    /**
+     * Queue a task to run on the main thread, may be called from any thread
+     * @return false if the task queue is full
+     */
+    bool postMainThreadTask(InlineTask &&task);
+
     void processEvents()
     {
         mEventMana->processEvents();
@@ -253,6 +320,18 @@ public:
 
     std::vector<GamepadStateInfo> getConnectedGamepadStateInfos() override;
 
+    /**
+     * Number of native window commands that were replaced by a newer value in the same frame
+     * and therefore never reached the native window
+     */
+    uint64_t savedNativeCommandCount() const;
+
+    /**
+     * Native backend counters of the last completed frame, used to spot regressions such as
+     * synchronous round trips to the window system on the hot path
+     */
+    NativeFrameStats nativeFrameStats() const;
+
 protected:  // Platform related, down
     void handleEvent(Event *event) override
     {
@@ -287,6 +366,10 @@ protected:  // Platform independent, on top
 
     void postSetCursorPos(WindowContext *window, int32_t x, int32_t y);
 
+    void onDeviceHandlerRegistered(BaseDeviceHandler *deviceHandler) override;
+
+    void onDeviceHandlerUnregistered(BaseDeviceHandler *deviceHandler) override;
+
 private:
     void destroyWindow(WindowHandle *wh);
 
@@ -296,6 +379,56 @@ private:
 
     void nativeDestroyW(WindowHandle *wh);
 
+    void runMainThreadTasks();
+
+    /**
+     * Apply the coalesced window commands, then flush the native connection
+     */
+    void flushNativeCommands();
+
+    void setCharInputEnabled(uint32_t windowId, bool enabled);
+
+private:
+    /**
+     * Last value of each window command posted within the current frame, applied in the order
+     * the values were last set. A command replaced by a newer one of the same kind is dropped
+     * and the newer one takes its place at the end, so the final state matches applying every
+     * command in sequence.
+     */
+    struct PendingNativeCommands
+    {
+        enum Kind : uint8_t
+        {
+            Size,
+            Pos,
+            Title,
+            State,
+            Flags,
+            Cursor,
+            CursorMode,
+            CursorPos,
+
+            Count
+        };
+
+        uint8_t order[Count] = {};
+        uint8_t orderCount = 0;
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        int32_t x = 0;
+        int32_t y = 0;
+        std::string title;
+        WindowState::Enum state = WindowState::Normal;
+        WindowFlags windowFlags = 0;
+        gxx::Cursor cursor;
+        CursorMode::Enum cursorMode = CursorMode::Normal;
+        int32_t cursorX = 0;
+        int32_t cursorY = 0;
+    };
+
+    PendingNativeCommands &pendingCommands(WindowContext *window, PendingNativeCommands::Kind kind);
+
 private:
     friend class WindowContext;
 
@@ -308,6 +441,17 @@ private:
 
     using DelayedTask = std::function<void()>;
     std::queue<DelayedTask> mDelayedTasks;
+
+    TaskQueue mMainThreadTasks;
+    std::atomic<bool> mWakeupPending{false};
+
+    std::unordered_map<WindowContext *, PendingNativeCommands> mPendingCommands;
+    uint64_t mSavedNativeCommands = 0;
+
+    // Number of CharInput handlers of each window id
+    std::unordered_map<uint32_t, uint32_t> mCharInputHandlers;
+
+    const NativeBackend *mNative = nullptr;
 };
 
 
@@ -384,15 +528,7 @@ struct AppNativeEvents
     enum Enum
     {
         Exit,
-        SetWindowSize,
-        SetWindowPos,
-        SetWindowTitle,
-        SetWindowState,
-        SetWindowFlags,
         ShowInfoDialog,
-        SetCursor,
-        SetCursorMode,
-        SetCursorPos,
     };
 };
 
@@ -414,63 +550,6 @@ public:
     {}
 };
 
-class ANSetWinSizeEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetWinSizeEvent(WindowContext *window, uint32_t w, uint32_t h)
-            : ANBaseEvent(window, AppNativeEvents::SetWindowSize), width(w), height(h)
-    {}
-
-public:
-    uint32_t width;
-    uint32_t height;
-};
-
-class ANSetWinPosEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetWinPosEvent(WindowContext *window, int32_t x, int32_t y)
-            : ANBaseEvent(window, AppNativeEvents::SetWindowPos), x(x), y(y)
-    {}
-
-public:
-    int32_t x;
-    int32_t y;
-};
-
-class ANSetWinTitleEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetWinTitleEvent(WindowContext *window, std::string title)
-            : ANBaseEvent(window, AppNativeEvents::SetWindowTitle), title(std::move(title))
-    {}
-
-public:
-    std::string title;
-};
-
-class ANSetWinStateEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetWinStateEvent(WindowContext *window, WindowState::Enum state)
-            : ANBaseEvent(window, AppNativeEvents::SetWindowState), state(state)
-    {}
-
-public:
-    WindowState::Enum state;
-};
-
-class ANSetWinFlagsEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetWinFlagsEvent(WindowContext *window, WindowFlags flags)
-            : ANBaseEvent(window, AppNativeEvents::SetWindowFlags), flags(flags)
-    {}
-
-public:
-    WindowFlags flags;
-};
-
 class ANShowInfoDialogEvent : public ANBaseEvent
 {
 public:
@@ -483,40 +562,6 @@ public:
     std::string message;
 };
 
-class ANSetCursorEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetCursorEvent(WindowContext *window, const Cursor &cursor)
-            : ANBaseEvent(window, AppNativeEvents::SetCursor), cursor(cursor)
-    {}
-
-public:
-    Cursor cursor;
-};
-
-class ANSetCursorModeEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetCursorModeEvent(WindowContext *window, CursorMode::Enum mode)
-            : ANBaseEvent(window, AppNativeEvents::SetCursorMode), mode(mode)
-    {}
-
-public:
-    CursorMode::Enum mode;
-};
-
-class ANSetCursorPosEvent : public ANBaseEvent
-{
-public:
-    explicit ANSetCursorPosEvent(WindowContext *window, int32_t x, int32_t y)
-            : ANBaseEvent(window, AppNativeEvents::SetCursorPos), x(x), y(y)
-    {}
-
-public:
-    int32_t x;
-    int32_t y;
-};
-
 }
 
 #endif //GXX_ENTRY_H
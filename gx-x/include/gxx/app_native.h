@@ -40,6 +40,10 @@ class AppContext;
 
 class Cursor;
 
+class FrameBuffer;
+
+struct NativeFrameStats;
+
 class NWindow
 {
 public:
@@ -84,6 +88,30 @@ public:
     virtual void setCursorPosition(int32_t x, int32_t y) = 0;
 
     virtual void getCursorPosition(int32_t &x, int32_t &y) = 0;
+
+    /**
+     * Called when the first CharInput handler of the window is registered and after the last one is removed,
+     * platforms with a per-window input context create and destroy it here
+     */
+    virtual void setCharInputEnabled(bool enabled)
+    {}
+
+    /**
+     * CPU backbuffer with the current window size, recreated after a resize,
+     * nullptr if the platform has no software presentation path
+     */
+    virtual FrameBuffer *getFrameBuffer()
+    {
+        return nullptr;
+    }
+
+    /**
+     * @return false if there is no framebuffer or the previous present is still in progress
+     */
+    virtual bool presentFrameBuffer()
+    {
+        return false;
+    }
 };
 
 extern NWindow *createNativeWindow();
@@ -98,6 +126,63 @@ extern std::vector<GamepadStateInfo> nativeGetConnectedGamepadStateInfos();
 
 extern void nativeGetDesktopSize(uint32_t &w, uint32_t &h);
 
+/**
+ * Wake up the native event loop if it is waiting for events, may be called from any thread
+ */
+extern void nativeWakeup();
+
+/**
+ * Read pending native events once per loop and dispatch them to their windows,
+ * for platforms that pump events per NWindow::frame this does nothing
+ */
+extern void nativePollEvents();
+
+/**
+ * Submit the requests buffered during this frame to the native window system
+ */
+extern void nativeFlush();
+
+/**
+ * Counters of the last frame, a frame ends with nativeFlush
+ */
+extern NativeFrameStats nativeGetFrameStats();
+
+/**
+ * Entry points of a native backend, AppContext selects one in init
+ */
+struct NativeBackend
+{
+    NWindow *(*createWindow)();
+
+    int (*init)(AppContext *appCtx);
+
+    int (*terminate)(AppContext *appCtx);
+
+    bool (*deviceSupport)(DeviceType::Enum type);
+
+    std::vector<GamepadStateInfo> (*getConnectedGamepadStateInfos)();
+
+    void (*getDesktopSize)(uint32_t &w, uint32_t &h);
+
+    void (*wakeup)();
+
+    void (*pollEvents)();
+
+    void (*flush)();
+
+    NativeFrameStats (*getFrameStats)();
+};
+
+/**
+ * The window system of the platform, made of the native* functions above
+ */
+extern const NativeBackend &platformNativeBackend();
+
+/**
+ * Windows that only exist in memory, for running without a window system, see Application::setHeadless
+ */
+extern const NativeBackend &headlessNativeBackend();
+
 }
 
 #endif //GXX_NATIVE_APP_H
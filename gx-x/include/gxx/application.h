@@ -26,6 +26,7 @@
 #include <gx/gglobal.h>
 
 #include <gxx/device/device_type.h>
+#include <gxx/taskqueue.h>
 
 #include <string>
 
@@ -72,6 +73,15 @@ public:
 
     void addWindow(Window *window);
 
+    /**
+     * Run a task on the main thread during the next loop iteration.
+     * Can be called from any thread, wakes up the native loop if it is waiting for events.
+     *
+     * @param task  Callable stored inline without allocation, see InlineTask
+     * @return false if the main thread task queue is full
+     */
+    bool runOnMainThread(InlineTask task);
+
     void setName(const std::string &appName);
 
     std::string getName();
@@ -92,6 +102,16 @@ public:
 public:
     static Application *application();
 
+    /**
+     * Run without a window system: windows, their state and framebuffers only exist in memory,
+     * input is injected through the AppContext device driver posts.
+     * Must be called before the Application is constructed, setting the GXX_HEADLESS environment
+     * variable to a value other than 0 has the same effect.
+     */
+    static void setHeadless(bool headless);
+
+    static bool isHeadless();
+
 private:
     int init();
 
@@ -106,6 +126,8 @@ private:
 
 private:
     static Application *sApplication;
+
+    static bool sHeadless;
 };
 
 }
@@ -25,243 +25,492 @@
 
 #include <vector>
 #include <algorithm>
+#include <memory>
+#include <type_traits>
 #include <memory.h>
 
 #include <gx/allocator.h>
 #include <gx/debug.h>
 
+#include "bitmapview.h"
+#include "blit.h"
+
 
 namespace gxx
 {
 
-template<typename Allocator, typename PIXEL>
+/**
+ * Pixels are kept in heap storage owned through a shared_ptr, moves only transfer the storage.
+ * Copies are deep unless made with share(), shared storage is copied by the first holder that writes to it.
+ *
+ * @tparam ROW_ALIGNMENT  0 for tightly packed rows, or a power of two (typically 32 or 64) that every row
+ *                        starts on, rows are then padded to stride() bytes so SIMD kernels can use aligned
+ *                        loads and whole vectors per row without a scalar tail
+ */
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT = 0>
 class BitmapBase
 {
+    static_assert((ROW_ALIGNMENT & (ROW_ALIGNMENT - 1)) == 0, "Row alignment must be 0 or a power of two");
+    static_assert(std::is_trivially_copyable<PIXEL>::value, "Pixels are copied as bytes");
+
 private:
     static constexpr const uint32_t kPixelSize = sizeof(PIXEL);
 
+    static constexpr uint32_t gcd(uint32_t a, uint32_t b)
+    {
+        return b == 0 ? a : gcd(b, a % b);
+    }
+
+    /**
+     * Strides are multiples of both the row alignment and the pixel size, so rows hold whole pixels
+     */
+    static constexpr const uint32_t kStrideUnit =
+            ROW_ALIGNMENT == 0 ? kPixelSize : ROW_ALIGNMENT / gcd(ROW_ALIGNMENT, kPixelSize) * kPixelSize;
+
+    static constexpr const uint32_t kBufferAlignment =
+            ROW_ALIGNMENT > alignof(PIXEL) ? ROW_ALIGNMENT : (uint32_t) alignof(PIXEL);
+
+public:
+    static constexpr const uint32_t kRowAlignment = ROW_ALIGNMENT;
+
 public:
     explicit BitmapBase()
-            : mAllocator(),
-              mBuffer(mAllocator),
+            : mStorage(),
               mWidth(0),
               mHeight(0)
     {}
 
     explicit BitmapBase(uint32_t width, uint32_t height);
 
+    /**
+     * Copy the pixels of a view
+     */
+    explicit BitmapBase(const BitmapView<const PIXEL> &view);
+
     BitmapBase(const BitmapBase &b) noexcept;
 
     BitmapBase(BitmapBase &&b) noexcept;
 
-    BitmapBase<Allocator, PIXEL> &operator=(const BitmapBase<Allocator, PIXEL> &b) noexcept;
+    BitmapBase &operator=(const BitmapBase &b) noexcept;
 
-    BitmapBase<Allocator, PIXEL> &operator=(BitmapBase<Allocator, PIXEL> &&b) noexcept;
+    BitmapBase &operator=(BitmapBase &&b) noexcept;
 
 public:
+    /**
+     * Resize to zero filled pixels, the buffer is reused when it is not shared and large enough
+     */
     void reset(uint32_t width, uint32_t height);
 
+    /**
+     * Resize without clearing, for bitmaps about to be overwritten entirely.
+     * Reuses the buffer like reset(), the contents are then left over pixels, otherwise indeterminate.
+     */
+    void resetUninitialized(uint32_t width, uint32_t height);
+
     uint32_t width() const;
 
     uint32_t height() const;
 
+    /**
+     * Size of the pixel buffer, stride() * height()
+     */
     uint64_t byteSize() const;
 
     uint32_t pixelBytes() const;
 
+    /**
+     * Distance in bytes between the starts of two rows, width() * pixelBytes() rounded up to the row alignment
+     */
+    uint32_t stride() const;
+
+    /**
+     * Same as stride(), the name used by BitmapView and FrameBuffer
+     */
     uint32_t bytesPerLine() const;
 
+    /**
+     * Index of a pixel in the buffer counted in pixels, padding included
+     */
     uint32_t pixelIndex(uint32_t x, uint32_t y) const;
 
     unsigned char *data();
 
     const unsigned char *data() const;
 
+    /**
+     * Copy tightly packed rows of width() pixels into the bitmap, stops at the end of the data or of the bitmap
+     */
     void setData(unsigned char *data, uint64_t size);
 
+    /**
+     * Large bitmaps are filled by Blit::fill, in parallel and bypassing the cache
+     */
     void fill(PIXEL pixel);
 
     void setPixel(uint32_t x, uint32_t y, PIXEL pixel);
 
     PIXEL getPixel(uint32_t x, uint32_t y) const;
 
-    BitmapBase<Allocator, PIXEL> copy(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+    /**
+     * A new bitmap of the same layout holding a copy of the rect
+     */
+    BitmapBase copy(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+
+    /**
+     * View of the pixels, valid until the bitmap is reset or destroyed
+     */
+    BitmapView<PIXEL> view();
+
+    BitmapView<const PIXEL> view() const;
+
+    /**
+     * A bitmap sharing the pixels of this one without copying them (copy-on-write),
+     * pointers returned by data() before sharing must not be written through afterwards
+     */
+    BitmapBase share() const;
+
+    bool isShared() const;
 
 private:
-    Allocator mAllocator;
-    std::vector<PIXEL, gx::STLAllocator<PIXEL, Allocator>> mBuffer;
+    static uint32_t strideOf(uint32_t width)
+    {
+        return (width * kPixelSize + kStrideUnit - 1) / kStrideUnit * kStrideUnit;
+    }
+
+    /**
+     * Bytes the allocator really hands out for a request of size, allocators that round requests up
+     * (such as BitmapPool) report it through a static classSize(), the others are taken as exact
+     */
+    template<typename A>
+    static auto capacityOf(uint64_t size, int) -> decltype((uint64_t) A::classSize(size))
+    {
+        return A::classSize(size);
+    }
+
+    template<typename A>
+    static uint64_t capacityOf(uint64_t size, long)
+    {
+        return size;
+    }
+
+    /**
+     * Pixel buffer aligned to the row alignment, the allocator lives here so it outlives the buffer.
+     * size is the part in use, a reset to a smaller bitmap keeps the capacity.
+     * An empty storage has no buffer and no capacity.
+     */
+    struct Storage
+    {
+        explicit Storage(uint64_t size, bool zero)
+                : allocator(),
+                  size(size),
+                  capacity(size > 0 ? capacityOf<Allocator>(size, 0) : 0),
+                  pixels(size > 0 ? (PIXEL *) allocator.alloc(capacity, kBufferAlignment) : nullptr)
+        {
+            if (pixels && zero) {
+                memset(pixels, 0, size);
+            }
+        }
+
+        Storage(const Storage &b)
+                : allocator(),
+                  size(b.size),
+                  capacity(b.size > 0 ? capacityOf<Allocator>(b.size, 0) : 0),
+                  pixels(b.size > 0 ? (PIXEL *) allocator.alloc(capacity, kBufferAlignment) : nullptr)
+        {
+            if (pixels) {
+                memcpy(pixels, b.pixels, size);
+            }
+        }
+
+        ~Storage()
+        {
+            if (pixels) {
+                allocator.free(pixels, capacity);
+            }
+        }
+
+        Storage &operator=(const Storage &) = delete;
+
+        Allocator allocator;
+        uint64_t size;
+        uint64_t capacity;
+        PIXEL *pixels;
+    };
+
+    void resize(uint32_t width, uint32_t height, bool zero);
+
+    /**
+     * Called before every write, takes a private copy of shared storage
+     */
+    void detach();
+
+private:
+    std::shared_ptr<Storage> mStorage;
     uint32_t mWidth;
     uint32_t mHeight;
 };
 
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL>::BitmapBase(uint32_t width, uint32_t height)
-        : mAllocator(),
-          mBuffer(width * height, mAllocator),
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::BitmapBase(uint32_t width, uint32_t height)
+        : mStorage(std::make_shared<Storage>((uint64_t) strideOf(width) * height, true)),
           mWidth(width),
           mHeight(height)
 {}
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL>::BitmapBase(const BitmapBase &b) noexcept
-        : mAllocator(),
-          mBuffer(b.mBuffer, mAllocator),
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::BitmapBase(const BitmapView<const PIXEL> &view)
+        : mStorage(),
+          mWidth(0),
+          mHeight(0)
+{
+    // The copy overwrites every pixel, only the row padding is cleared
+    resize(view.width(), view.height(), strideOf(view.width()) != view.width() * kPixelSize);
+    this->view().copyFrom(view);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::BitmapBase(const BitmapBase &b) noexcept
+        : mStorage(b.mStorage ? std::make_shared<Storage>(*b.mStorage) : nullptr),
           mWidth(b.mWidth),
           mHeight(b.mHeight)
 {
 }
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL>::BitmapBase(BitmapBase &&b) noexcept
-        : mAllocator(),
-          mBuffer(b.mBuffer, mAllocator),
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::BitmapBase(BitmapBase &&b) noexcept
+        : mStorage(std::move(b.mStorage)),
           mWidth(b.mWidth),
           mHeight(b.mHeight)
 {
-    b.mBuffer.clear();
     b.mWidth = 0;
     b.mHeight = 0;
 }
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL> &BitmapBase<Allocator, PIXEL>::operator=(const BitmapBase<Allocator, PIXEL> &b) noexcept
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::operator=(const BitmapBase &b) noexcept
 {
     if (this != &b) {
-        mBuffer = b.mBuffer;
+        mStorage = b.mStorage ? std::make_shared<Storage>(*b.mStorage) : nullptr;
         mWidth = b.mWidth;
         mHeight = b.mHeight;
     }
     return *this;
 }
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL> &BitmapBase<Allocator, PIXEL>::operator=(BitmapBase<Allocator, PIXEL> &&b) noexcept
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::operator=(BitmapBase &&b) noexcept
 {
     if (this != &b) {
-        mBuffer = b.mBuffer;
+        mStorage = std::move(b.mStorage);
         mWidth = b.mWidth;
         mHeight = b.mHeight;
-        b.mBuffer.clear();
         b.mWidth = 0;
         b.mHeight = 0;
     }
     return *this;
 }
 
-template<typename Allocator, typename PIXEL>
-void BitmapBase<Allocator, PIXEL>::reset(uint32_t width, uint32_t height)
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::reset(uint32_t width, uint32_t height)
 {
-    mBuffer.clear();
-    mBuffer.resize(width * height);
-    mWidth = width;
-    mHeight = height;
+    resize(width, height, true);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::resetUninitialized(uint32_t width, uint32_t height)
+{
+    resize(width, height, false);
 }
 
-template<typename Allocator, typename PIXEL>
-uint32_t BitmapBase<Allocator, PIXEL>::width() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::width() const
 {
     return mWidth;
 }
 
-template<typename Allocator, typename PIXEL>
-uint32_t BitmapBase<Allocator, PIXEL>::height() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::height() const
 {
     return mHeight;
 }
 
-template<typename Allocator, typename PIXEL>
-uint64_t BitmapBase<Allocator, PIXEL>::byteSize() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint64_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::byteSize() const
 {
-    return mBuffer.size() * kPixelSize;
+    return mStorage ? mStorage->size : 0;
 }
 
-template<typename Allocator, typename PIXEL>
-uint32_t BitmapBase<Allocator, PIXEL>::pixelBytes() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::pixelBytes() const
 {
     return kPixelSize;
 }
 
-template<typename Allocator, typename PIXEL>
-uint32_t BitmapBase<Allocator, PIXEL>::bytesPerLine() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::stride() const
 {
-    return mWidth * kPixelSize;
+    return strideOf(mWidth);
 }
 
-template<typename Allocator, typename PIXEL>
-uint32_t BitmapBase<Allocator, PIXEL>::pixelIndex(uint32_t x, uint32_t y) const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::bytesPerLine() const
 {
-    return mWidth * y + x;
+    return stride();
 }
 
-template<typename Allocator, typename PIXEL>
-unsigned char *BitmapBase<Allocator, PIXEL>::data()
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+uint32_t BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::pixelIndex(uint32_t x, uint32_t y) const
 {
-    return (unsigned char *) mBuffer.data();
+    return stride() / kPixelSize * y + x;
 }
 
-template<typename Allocator, typename PIXEL>
-const unsigned char *BitmapBase<Allocator, PIXEL>::data() const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+unsigned char *BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::data()
 {
-    return (unsigned char *) mBuffer.data();
+    detach();
+    return mStorage ? (unsigned char *) mStorage->pixels : nullptr;
 }
 
-template<typename Allocator, typename PIXEL>
-void BitmapBase<Allocator, PIXEL>::setData(unsigned char *data, uint64_t size)
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+const unsigned char *BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::data() const
 {
-    uint64_t maxSize = byteSize();
+    return mStorage ? (const unsigned char *) mStorage->pixels : nullptr;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::setData(unsigned char *data, uint64_t size)
+{
+    const uint64_t rowBytes = (uint64_t) mWidth * kPixelSize;
+    const uint64_t maxSize = rowBytes * mHeight;
     size = size > maxSize ? maxSize : size;
-    memcpy((unsigned char*)mBuffer.data(), data, size);
+    if (size == 0) {
+        return;
+    }
+    detach();
+    if (rowBytes == stride()) {
+        memcpy((unsigned char *) mStorage->pixels, data, size);
+        return;
+    }
+    for (uint64_t offset = 0, y = 0; offset < size; offset += rowBytes, y++) {
+        memcpy((unsigned char *) mStorage->pixels + y * stride(), data + offset, std::min(rowBytes, size - offset));
+    }
 }
 
-template<typename Allocator, typename PIXEL>
-void BitmapBase<Allocator, PIXEL>::fill(PIXEL pixel)
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::fill(PIXEL pixel)
 {
-    std::fill_n(mBuffer.begin(), mBuffer.size(), pixel);
+    if (!mStorage) {
+        return;
+    }
+    detach();
+    // Padding is filled too, whole rows stay valid pixels for kernels that run past width
+    if (mStorage->size < Blit::kLargeFillBytes) {
+        std::fill_n(mStorage->pixels, mStorage->size / kPixelSize, pixel);
+        return;
+    }
+    const uint32_t stride = this->stride();
+    Blit::fill(BitmapView<PIXEL>((unsigned char *) mStorage->pixels, stride / kPixelSize, mHeight, stride), pixel);
 }
 
-template<typename Allocator, typename PIXEL>
-void BitmapBase<Allocator, PIXEL>::setPixel(uint32_t x, uint32_t y, PIXEL pixel)
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::setPixel(uint32_t x, uint32_t y, PIXEL pixel)
 {
     GX_ASSERT(x < mWidth);
     GX_ASSERT(y < mHeight);
 
-    mBuffer[pixelIndex(x, y)] = pixel;
+    detach();
+    mStorage->pixels[pixelIndex(x, y)] = pixel;
 }
 
-template<typename Allocator, typename PIXEL>
-PIXEL BitmapBase<Allocator, PIXEL>::getPixel(uint32_t x, uint32_t y) const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+PIXEL BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::getPixel(uint32_t x, uint32_t y) const
 {
     GX_ASSERT(x < mWidth);
     GX_ASSERT(y < mHeight);
 
-    return mBuffer[pixelIndex(x, y)];
+    return mStorage->pixels[pixelIndex(x, y)];
 }
 
-template<typename Allocator, typename PIXEL>
-BitmapBase<Allocator, PIXEL>
-BitmapBase<Allocator, PIXEL>::copy(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::copy(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
 {
     GX_ASSERT(width > 0);
     GX_ASSERT(height > 0);
-    GX_ASSERT(x + width < mWidth);
-    GX_ASSERT(y + height < mHeight);
+    GX_ASSERT(x + width <= mWidth);
+    GX_ASSERT(y + height <= mHeight);
 
-    BitmapBase<Allocator, PIXEL> chip(width, height);
+    return BitmapBase(view().subView(x, y, width, height));
+}
 
-    for (uint32_t yi = 0; yi < height; yi++) {
-        for (uint32_t xi = 0; xi < width; xi++) {
-            chip.setPixel(xi, yi, this->getPixel(x + xi, y + yi));
-        }
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapView<PIXEL> BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::view()
+{
+    return BitmapView<PIXEL>(data(), mWidth, mHeight, stride());
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapView<const PIXEL> BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::view() const
+{
+    return BitmapView<const PIXEL>(data(), mWidth, mHeight, stride());
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::share() const
+{
+    BitmapBase shared;
+    shared.mStorage = mStorage;
+    shared.mWidth = mWidth;
+    shared.mHeight = mHeight;
+    return shared;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+bool BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::isShared() const
+{
+    return mStorage && mStorage.use_count() > 1;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::resize(uint32_t width, uint32_t height, bool zero)
+{
+    const uint64_t size = (uint64_t) strideOf(width) * height;
+    if (mStorage && !isShared() && mStorage->capacity >= size) {
+        mStorage->size = size;
+    } else {
+        // Never reuses shared storage, the other holders keep the old pixels
+        mStorage = std::make_shared<Storage>(size, zero);
+        zero = false;
     }
+    mWidth = width;
+    mHeight = height;
+    if (zero) {
+        // A reused buffer is cleared by fill(), in parallel when large
+        fill(PIXEL());
+    }
+}
 
-    return chip;
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+void BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>::detach()
+{
+    if (isShared()) {
+        mStorage = std::make_shared<Storage>(*mStorage);
+    }
 }
 
 
 template<typename PIXEL>
 using Bitmap = BitmapBase<gx::HeapPond, PIXEL>;
 
+/**
+ * Rows start on 64 byte boundaries, a cache line and a whole AVX-512 register
+ */
+template<typename PIXEL>
+using AlignedBitmap = BitmapBase<gx::HeapPond, PIXEL, 64>;
+
 }
 
 #endif //GXX_BITMAP_H
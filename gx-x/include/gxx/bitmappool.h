@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_BITMAPPOOL_H
+#define GXX_BITMAPPOOL_H
+
+#include "bitmap.h"
+
+#include <gx/gglobal.h>
+
+
+namespace gxx
+{
+
+/**
+ * Allocator for BitmapBase that recycles pixel buffers through a process wide cache
+ *
+ * Requests are rounded up to size classes (4 KB, then four classes per power of two, at most 25% slack),
+ * freed buffers are kept per class and handed to the next request of the same class.
+ * Instances are stateless handles, every bitmap using this allocator shares the cache.
+ * Buffers larger than kMaxPooledSize bypass the cache.
+ */
+class GX_API BitmapPool
+{
+public:
+    static constexpr const size_t kAlignment = 64;
+    static constexpr const size_t kMinClassSize = 4 * 1024;
+    static constexpr const size_t kMaxPooledSize = 64 * 1024 * 1024;
+
+    struct Stats
+    {
+        uint64_t hits = 0;          // Requests served from the cache
+        uint64_t misses = 0;        // Requests that allocated
+        uint64_t cachedBytes = 0;   // Bytes held by the cache now
+        uint64_t maxCachedBytes = 0;
+    };
+
+public:
+    /**
+     * @param alignment at most kAlignment, every buffer is aligned to kAlignment
+     */
+    void *alloc(size_t size, size_t alignment = kAlignment);
+
+    void free(void *p, size_t size);
+
+public:
+    /**
+     * Buffers freed while the cache holds this many bytes are released, defaults to 64 MB.
+     * Lowering it releases cached buffers until the cache fits the new limit.
+     */
+    static void setMaxCachedBytes(uint64_t bytes);
+
+    /**
+     * Release every cached buffer
+     */
+    static void trim();
+
+    static Stats stats();
+
+    /**
+     * Capacity actually allocated for a request of size bytes
+     */
+    static size_t classSize(size_t size);
+};
+
+template<typename PIXEL>
+using PooledBitmap = BitmapBase<BitmapPool, PIXEL>;
+
+}
+
+#endif //GXX_BITMAPPOOL_H
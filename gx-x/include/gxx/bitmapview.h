@@ -0,0 +1,253 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_BITMAPVIEW_H
+#define GXX_BITMAPVIEW_H
+
+#include <algorithm>
+#include <type_traits>
+#include <memory.h>
+
+#include <gx/debug.h>
+
+
+namespace gxx
+{
+
+/**
+ * Non-owning view of a rectangle of pixels, rows are bytesPerLine apart.
+ * Views are cheap to copy and sub-views share the pixels, the referenced buffer must outlive them.
+ *
+ * @tparam PIXEL  Pixel type, const for a read-only view
+ */
+template<typename PIXEL>
+class BitmapView
+{
+public:
+    using Pixel = typename std::remove_const<PIXEL>::type;
+    using Byte = typename std::conditional<std::is_const<PIXEL>::value, const unsigned char, unsigned char>::type;
+
+private:
+    static constexpr const uint32_t kPixelSize = sizeof(PIXEL);
+
+public:
+    explicit BitmapView()
+            : mData(nullptr),
+              mWidth(0),
+              mHeight(0),
+              mBytesPerLine(0)
+    {}
+
+    /**
+     * @param data          First pixel of the view
+     * @param bytesPerLine  Stride, at least width * sizeof(PIXEL)
+     */
+    explicit BitmapView(Byte *data, uint32_t width, uint32_t height, uint32_t bytesPerLine);
+
+    /**
+     * A mutable view converts to a read-only one
+     */
+    template<typename OTHER, typename = typename std::enable_if<std::is_same<const OTHER, PIXEL>::value>::type>
+    BitmapView(const BitmapView<OTHER> &b)
+            : mData(b.data()),
+              mWidth(b.width()),
+              mHeight(b.height()),
+              mBytesPerLine(b.bytesPerLine())
+    {}
+
+public:
+    uint32_t width() const;
+
+    uint32_t height() const;
+
+    uint32_t pixelBytes() const;
+
+    uint32_t bytesPerLine() const;
+
+    bool isEmpty() const;
+
+    /**
+     * Rows follow each other without padding, the pixels can be processed as one span
+     */
+    bool isContiguous() const;
+
+    Byte *data() const;
+
+    PIXEL *row(uint32_t y) const;
+
+    Pixel getPixel(uint32_t x, uint32_t y) const;
+
+    void setPixel(uint32_t x, uint32_t y, Pixel pixel) const;
+
+    void fill(Pixel pixel) const;
+
+    /**
+     * View of a region of this view, clipped to it, no pixel is copied
+     */
+    BitmapView<PIXEL> subView(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const;
+
+    /**
+     * Copy the pixels of src to the top left of this view, clipped to the smaller size,
+     * the two views may overlap within one buffer
+     */
+    void copyFrom(const BitmapView<const Pixel> &src) const;
+
+private:
+    Byte *mData;
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mBytesPerLine;
+};
+
+
+template<typename PIXEL>
+BitmapView<PIXEL>::BitmapView(Byte *data, uint32_t width, uint32_t height, uint32_t bytesPerLine)
+        : mData(data),
+          mWidth(width),
+          mHeight(height),
+          mBytesPerLine(bytesPerLine)
+{
+    GX_ASSERT(bytesPerLine >= width * kPixelSize);
+}
+
+template<typename PIXEL>
+uint32_t BitmapView<PIXEL>::width() const
+{
+    return mWidth;
+}
+
+template<typename PIXEL>
+uint32_t BitmapView<PIXEL>::height() const
+{
+    return mHeight;
+}
+
+template<typename PIXEL>
+uint32_t BitmapView<PIXEL>::pixelBytes() const
+{
+    return kPixelSize;
+}
+
+template<typename PIXEL>
+uint32_t BitmapView<PIXEL>::bytesPerLine() const
+{
+    return mBytesPerLine;
+}
+
+template<typename PIXEL>
+bool BitmapView<PIXEL>::isEmpty() const
+{
+    return mWidth == 0 || mHeight == 0;
+}
+
+template<typename PIXEL>
+bool BitmapView<PIXEL>::isContiguous() const
+{
+    return mBytesPerLine == mWidth * kPixelSize || mHeight <= 1;
+}
+
+template<typename PIXEL>
+typename BitmapView<PIXEL>::Byte *BitmapView<PIXEL>::data() const
+{
+    return mData;
+}
+
+template<typename PIXEL>
+PIXEL *BitmapView<PIXEL>::row(uint32_t y) const
+{
+    GX_ASSERT(y < mHeight);
+
+    return (PIXEL *) (mData + (uint64_t) mBytesPerLine * y);
+}
+
+template<typename PIXEL>
+typename BitmapView<PIXEL>::Pixel BitmapView<PIXEL>::getPixel(uint32_t x, uint32_t y) const
+{
+    GX_ASSERT(x < mWidth);
+
+    return row(y)[x];
+}
+
+template<typename PIXEL>
+void BitmapView<PIXEL>::setPixel(uint32_t x, uint32_t y, Pixel pixel) const
+{
+    GX_ASSERT(x < mWidth);
+
+    row(y)[x] = pixel;
+}
+
+template<typename PIXEL>
+void BitmapView<PIXEL>::fill(Pixel pixel) const
+{
+    if (isEmpty()) {
+        return;
+    }
+    if (isContiguous()) {
+        std::fill_n(row(0), (uint64_t) mWidth * mHeight, pixel);
+        return;
+    }
+    for (uint32_t y = 0; y < mHeight; y++) {
+        std::fill_n(row(y), mWidth, pixel);
+    }
+}
+
+template<typename PIXEL>
+BitmapView<PIXEL> BitmapView<PIXEL>::subView(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+{
+    x = std::min(x, mWidth);
+    y = std::min(y, mHeight);
+    width = std::min(width, mWidth - x);
+    height = std::min(height, mHeight - y);
+    if (width == 0 || height == 0) {
+        return BitmapView<PIXEL>();
+    }
+    return BitmapView<PIXEL>(mData + (uint64_t) mBytesPerLine * y + (uint64_t) x * kPixelSize,
+                             width, height, mBytesPerLine);
+}
+
+template<typename PIXEL>
+void BitmapView<PIXEL>::copyFrom(const BitmapView<const Pixel> &src) const
+{
+    const uint32_t width = std::min(mWidth, src.width());
+    const uint32_t height = std::min(mHeight, src.height());
+    if (width == 0 || height == 0) {
+        return;
+    }
+    if (width == mWidth && width == src.width() && isContiguous() && src.isContiguous()) {
+        memmove(data(), src.data(), (uint64_t) width * height * kPixelSize);
+        return;
+    }
+    if ((const unsigned char *) data() > (const unsigned char *) src.data()) {
+        // Bottom up, a region moved down within the same buffer must not read rows it already wrote
+        for (uint32_t y = height; y-- > 0;) {
+            memmove(row(y), src.row(y), (uint64_t) width * kPixelSize);
+        }
+        return;
+    }
+    for (uint32_t y = 0; y < height; y++) {
+        memmove(row(y), src.row(y), (uint64_t) width * kPixelSize);
+    }
+}
+
+}
+
+#endif //GXX_BITMAPVIEW_H
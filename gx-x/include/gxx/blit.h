@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_BLIT_H
+#define GXX_BLIT_H
+
+#include "bitmapview.h"
+
+#include <vector>
+
+#include <gx/gglobal.h>
+
+
+namespace gxx
+{
+
+/**
+ * Bulk pixel transfers between bitmap views
+ *
+ * The source is placed with its top left corner at (x, y) of the destination and clipped to it.
+ * Rows are copied with memcpy, compositing runs vectorized kernels of the set selected by PixelConvert.
+ * Source and destination must not overlap, except copy() which handles overlap within one buffer.
+ */
+class GX_API Blit
+{
+public:
+    /**
+     * Fills of at least this many bytes take the parallel path, smaller ones stay on std::fill_n
+     */
+    static constexpr const uint64_t kLargeFillBytes = 2 * 1024 * 1024;
+
+    template<typename PIXEL>
+    using SourceView = BitmapView<const typename std::remove_const<PIXEL>::type>;
+
+public:
+    template<typename PIXEL>
+    static void copy(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src);
+
+    /**
+     * Fill every pixel of the view, large views are split into row bands on worker threads
+     * and written with non-temporal stores once they exceed the last level cache
+     */
+    template<typename PIXEL>
+    static void fill(const BitmapView<PIXEL> &dst, PIXEL pixel);
+
+    /**
+     * Nearest neighbour scaling of the whole source to the rect (x, y, width, height) of the destination
+     */
+    template<typename PIXEL>
+    static void copyScaled(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                           const SourceView<PIXEL> &src);
+
+    /**
+     * Porter-Duff source-over of premultiplied 4 byte pixels with alpha in the last byte (Rgba, Bgra),
+     * the source alpha is scaled by opacity, results are exact to the rounding of c * a / 255
+     */
+    template<typename PIXEL>
+    static void sourceOver(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src,
+                           uint8_t opacity = 255);
+
+    /**
+     * Copy the source pixels whose colour channels differ from the key, alpha is ignored
+     */
+    template<typename PIXEL>
+    static void colorKey(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src,
+                         PIXEL key);
+
+private:
+    template<typename PIXEL>
+    static bool clip(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src,
+                     BitmapView<PIXEL> &dstClip, SourceView<PIXEL> &srcClip);
+
+    static void sourceOverRows(unsigned char *dst, uint32_t dstBytesPerLine,
+                               const unsigned char *src, uint32_t srcBytesPerLine,
+                               uint32_t width, uint32_t height, uint8_t opacity);
+
+    static void colorKeyRows(unsigned char *dst, uint32_t dstBytesPerLine,
+                             const unsigned char *src, uint32_t srcBytesPerLine,
+                             uint32_t width, uint32_t height, const unsigned char *key);
+
+    static void fillRows(unsigned char *dst, uint32_t dstBytesPerLine, uint32_t width, uint32_t height,
+                         const unsigned char *pixel, uint32_t pixelSize);
+};
+
+
+template<typename PIXEL>
+bool Blit::clip(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src,
+                BitmapView<PIXEL> &dstClip, SourceView<PIXEL> &srcClip)
+{
+    const int64_t x0 = std::max<int64_t>(x, 0);
+    const int64_t y0 = std::max<int64_t>(y, 0);
+    const int64_t x1 = std::min<int64_t>((int64_t) x + src.width(), dst.width());
+    const int64_t y1 = std::min<int64_t>((int64_t) y + src.height(), dst.height());
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    const auto width = (uint32_t) (x1 - x0);
+    const auto height = (uint32_t) (y1 - y0);
+    dstClip = dst.subView((uint32_t) x0, (uint32_t) y0, width, height);
+    srcClip = src.subView((uint32_t) (x0 - x), (uint32_t) (y0 - y), width, height);
+    return true;
+}
+
+template<typename PIXEL>
+void Blit::copy(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src)
+{
+    BitmapView<PIXEL> dstClip;
+    SourceView<PIXEL> srcClip;
+    if (clip(dst, x, y, src, dstClip, srcClip)) {
+        dstClip.copyFrom(srcClip);
+    }
+}
+
+template<typename PIXEL>
+void Blit::fill(const BitmapView<PIXEL> &dst, PIXEL pixel)
+{
+    if (dst.isEmpty()) {
+        return;
+    }
+    if ((uint64_t) dst.bytesPerLine() * dst.height() < kLargeFillBytes) {
+        dst.fill(pixel);
+        return;
+    }
+    fillRows(dst.data(), dst.bytesPerLine(), dst.width(), dst.height(), (const unsigned char *) &pixel,
+             sizeof(PIXEL));
+}
+
+template<typename PIXEL>
+void Blit::copyScaled(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, uint32_t width, uint32_t height,
+                      const SourceView<PIXEL> &src)
+{
+    if (width == 0 || height == 0 || src.isEmpty()) {
+        return;
+    }
+    if (width == src.width() && height == src.height()) {
+        copy(dst, x, y, src);
+        return;
+    }
+    const int64_t x0 = std::max<int64_t>(x, 0);
+    const int64_t y0 = std::max<int64_t>(y, 0);
+    const int64_t x1 = std::min<int64_t>((int64_t) x + width, dst.width());
+    const int64_t y1 = std::min<int64_t>((int64_t) y + height, dst.height());
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    // Source column of every destination column, sampled at pixel centres
+    std::vector<uint32_t> columns((size_t) (x1 - x0));
+    for (int64_t dx = x0; dx < x1; dx++) {
+        columns[dx - x0] = (uint32_t) (((uint64_t) (dx - x) * 2 + 1) * src.width() / ((uint64_t) width * 2));
+    }
+
+    int64_t lastSy = -1;
+    for (int64_t dy = y0; dy < y1; dy++) {
+        const auto sy = (int64_t) (((uint64_t) (dy - y) * 2 + 1) * src.height() / ((uint64_t) height * 2));
+        auto *dstRow = dst.row((uint32_t) dy) + x0;
+        if (sy == lastSy) {
+            // Repeated source rows when scaling up vertically
+            memcpy(dstRow, dst.row((uint32_t) dy - 1) + x0, columns.size() * sizeof(PIXEL));
+            continue;
+        }
+        const auto *srcRow = src.row((uint32_t) sy);
+        for (size_t i = 0; i < columns.size(); i++) {
+            dstRow[i] = srcRow[columns[i]];
+        }
+        lastSy = sy;
+    }
+}
+
+template<typename PIXEL>
+void Blit::sourceOver(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src,
+                      uint8_t opacity)
+{
+    static_assert(sizeof(PIXEL) == 4, "sourceOver needs 4 byte pixels with alpha in the last byte");
+
+    BitmapView<PIXEL> dstClip;
+    SourceView<PIXEL> srcClip;
+    if (opacity == 0 || !clip(dst, x, y, src, dstClip, srcClip)) {
+        return;
+    }
+    sourceOverRows(dstClip.data(), dstClip.bytesPerLine(), srcClip.data(), srcClip.bytesPerLine(),
+                   dstClip.width(), dstClip.height(), opacity);
+}
+
+template<typename PIXEL>
+void Blit::colorKey(const BitmapView<PIXEL> &dst, int32_t x, int32_t y, const SourceView<PIXEL> &src, PIXEL key)
+{
+    static_assert(sizeof(PIXEL) == 4, "colorKey needs 4 byte pixels with alpha in the last byte");
+
+    BitmapView<PIXEL> dstClip;
+    SourceView<PIXEL> srcClip;
+    if (!clip(dst, x, y, src, dstClip, srcClip)) {
+        return;
+    }
+    colorKeyRows(dstClip.data(), dstClip.bytesPerLine(), srcClip.data(), srcClip.bytesPerLine(),
+                 dstClip.width(), dstClip.height(), (const unsigned char *) &key);
+}
+
+}
+
+#endif //GXX_BLIT_H
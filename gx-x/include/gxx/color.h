@@ -72,6 +72,21 @@ struct Rgba
     };
 };
 
+struct Bgra
+{
+    union
+    {
+        struct
+        {
+            uint8_t b;
+            uint8_t g;
+            uint8_t r;
+            uint8_t a;
+        };
+        uint8_t v[4];
+    };
+};
+
 }
 
 #endif //GXX_COLOR_H
@@ -59,6 +59,15 @@ public:
 
     void processDeviceEvents();
 
+protected:
+    /**
+     * Called after a handler is registered and before it is unregistered,
+     * lets the driver keep device resources alive only while they have consumers
+     */
+    virtual void onDeviceHandlerRegistered(BaseDeviceHandler *deviceHandler);
+
+    virtual void onDeviceHandlerUnregistered(BaseDeviceHandler *deviceHandler);
+
 private:
     EventMana *mEventMana;
 };
@@ -35,6 +35,7 @@ class GX_API Keyboard : public BaseDeviceHandler
 public:
     using KeyPressEventFunc = std::function<void(Key::Enum, uint8_t)>;
     using KeyReleaseEventFunc = std::function<void(Key::Enum, uint8_t)>;
+    using KeyRepeatEventFunc = std::function<void(Key::Enum, uint8_t)>;
 
 public:
     explicit Keyboard(uint32_t windowId)
@@ -46,6 +47,11 @@ public:
 
     void setKeyReleaseEventCallback(KeyReleaseEventFunc callback);
 
+    /**
+     * Auto-repeat of a held key, repeats are passed to the press callback when this is not set
+     */
+    void setKeyRepeatEventCallback(KeyRepeatEventFunc callback);
+
 protected:
     void handleDeviceEEvent(Event *eEvent) override;
 
@@ -53,6 +59,8 @@ private:
     KeyPressEventFunc mKeyPressEventCb;
 
     KeyReleaseEventFunc mKeyReleaseEventCb;
+
+    KeyRepeatEventFunc mKeyRepeatEventCb;
 };
 
 
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_FRAMEBUFFER_H
+#define GXX_FRAMEBUFFER_H
+
+#include "bitmap.h"
+#include "color.h"
+
+#include <vector>
+
+
+namespace gxx
+{
+
+/**
+ * CPU rendered backbuffer of a window.
+ * The pixels are owned by the native backend (shared with the window system when possible)
+ * and stored in its native channel order, setPixel/getPixel/fill take Rgba and convert.
+ */
+class GX_API FrameBuffer
+{
+public:
+    struct PixelFormat
+    {
+        enum Enum : uint8_t
+        {
+            Rgba,
+            Bgra,
+        };
+    };
+
+    struct Rect
+    {
+        int32_t x = 0;
+        int32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    // Beyond this many separate dirty rects they are collapsed into their bounding box
+    static constexpr const uint32_t kMaxDirtyRects = 16;
+
+public:
+    virtual ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer &) = delete;
+
+    FrameBuffer &operator=(const FrameBuffer &) = delete;
+
+public:
+    uint32_t width() const;
+
+    uint32_t height() const;
+
+    uint64_t byteSize() const;
+
+    uint32_t pixelBytes() const;
+
+    uint32_t bytesPerLine() const;
+
+    uint32_t pixelIndex(uint32_t x, uint32_t y) const;
+
+    PixelFormat::Enum pixelFormat() const;
+
+    unsigned char *data();
+
+    const unsigned char *data() const;
+
+    /**
+     * Copy raw pixels already in pixelFormat() order, row by row
+     */
+    void setData(const unsigned char *data, uint64_t size);
+
+    void fill(Rgba pixel);
+
+    void setPixel(uint32_t x, uint32_t y, Rgba pixel);
+
+    Rgba getPixel(uint32_t x, uint32_t y) const;
+
+    /**
+     * The pixels in pixelFormat() order, sub-views can reference a region without copying it
+     */
+    BitmapView<uint32_t> view();
+
+    BitmapView<const uint32_t> view() const;
+
+    /**
+     * Copy pixels to (x, y), clipped to the framebuffer and converted to pixelFormat()
+     */
+    void draw(const BitmapView<const Rgba> &bitmap, int32_t x, int32_t y);
+
+    void draw(const Bitmap<Rgba> &bitmap, int32_t x, int32_t y);
+
+    /**
+     * Mark a region changed since the last present, only the dirty regions are uploaded by the next present.
+     * Overlapping and adjacent rects are merged, presenting without any dirty rect uploads the whole buffer.
+     */
+    void markDirty(int32_t x, int32_t y, uint32_t width, uint32_t height);
+
+    void markDirty();
+
+    const std::vector<Rect> &dirtyRects() const;
+
+    void clearDirty();
+
+protected:
+    explicit FrameBuffer(uint32_t width, uint32_t height, uint32_t bytesPerLine,
+                         PixelFormat::Enum format, unsigned char *data);
+
+    uint32_t toNative(Rgba pixel) const;
+
+    Rgba fromNative(uint32_t pixel) const;
+
+private:
+    uint32_t mWidth;
+    uint32_t mHeight;
+    uint32_t mBytesPerLine;
+    PixelFormat::Enum mFormat;
+    unsigned char *mData;
+
+    std::vector<Rect> mDirtyRects;
+};
+
+}
+
+#endif //GXX_FRAMEBUFFER_H
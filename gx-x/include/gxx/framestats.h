@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef GXX_FRAMESTATS_H
+#define GXX_FRAMESTATS_H
+
+#include <gx/gglobal.h>
+
+#include <functional>
+
+
+namespace gxx
+{
+
+struct FramePhase
+{
+    enum Enum
+    {
+        NativePump,     // Native window event pump
+        Events,         // Window and device event processing
+        Update,         // fixedUpdate() and update()
+
+        Count
+    };
+};
+
+/**
+ * Timing of a single frame, in seconds
+ */
+struct FrameTiming
+{
+    double total = 0;   // Wall clock time from this frame start to the next one
+    double phases[FramePhase::Count] = {};
+};
+
+struct FrameSummary
+{
+    uint32_t frames = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+    double max = 0;
+    FrameTiming average;
+};
+
+/**
+ * Rolling frame time statistics of a window
+ * Keeps the last kCapacity frames and reports frames over the hitch budget
+ */
+class GX_API FrameStats
+{
+public:
+    static constexpr const uint32_t kCapacity = 256;
+
+    using HitchCallback = std::function<void(const FrameTiming &)>;
+
+public:
+    void addFrame(const FrameTiming &timing);
+
+    void reset();
+
+    /**
+     * Number of frames in the ring buffer
+     */
+    uint32_t count() const;
+
+    /**
+     * @param index 0 is the oldest frame in the ring buffer
+     */
+    const FrameTiming &frame(uint32_t index) const;
+
+    const FrameTiming &lastFrame() const;
+
+    /**
+     * Percentiles and max of the total frame time, average time of each phase
+     */
+    FrameSummary summary() const;
+
+    /**
+     * @param budget    Frame time budget in seconds, 0 disables hitch detection
+     * @param callback  Called on the main thread with the timing of the frame over budget
+     */
+    void setHitchCallback(double budget, HitchCallback callback);
+
+    double hitchBudget() const;
+
+    uint64_t hitchCount() const;
+
+public:
+    /**
+     * Steady clock in nanoseconds
+     */
+    static int64_t now();
+
+private:
+    FrameTiming mFrames[kCapacity];
+    uint32_t mHead = 0;
+    uint32_t mCount = 0;
+
+    double mHitchBudget = 0;
+    HitchCallback mHitchCallback;
+    uint64_t mHitchCount = 0;
+};
+
+}
+
+#endif //GXX_FRAMESTATS_H
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_PIXELCONVERT_H
+#define GXX_PIXELCONVERT_H
+
+#include "color.h"
+
+
+namespace gxx
+{
+
+/**
+ * Conversions between the pixel types of color.h
+ *
+ * Each conversion has a scalar reference kernel and SIMD kernels (SSE2, AVX2, NEON) selected from the
+ * CPU features at the first call, all kernels produce identical results.
+ * Source and destination must not overlap, except conversions between 4 byte pixels which may run in place.
+ */
+class GX_API PixelConvert
+{
+public:
+    struct Kernel
+    {
+        enum Enum : uint8_t
+        {
+            Scalar,
+            SSE2,
+            AVX2,
+            NEON,
+        };
+    };
+
+public:
+    /**
+     * The best kernel set supported by this CPU
+     */
+    static Kernel::Enum bestKernel();
+
+    static Kernel::Enum kernel();
+
+    /**
+     * Select a kernel set, e.g. Scalar to compare with the reference results
+     *
+     * @return false if the kernel set is not supported by this build or CPU, the selection is unchanged
+     */
+    static bool setKernel(Kernel::Enum kernel);
+
+public:
+    /**
+     * Opaque alpha
+     */
+    static void rgbToRgba(const Rgb *src, Rgba *dst, uint64_t count);
+
+    static void rgbaToRgb(const Rgba *src, Rgb *dst, uint64_t count);
+
+    static void greyToRgba(const Grey *src, Rgba *dst, uint64_t count);
+
+    static void greyAlphaToRgba(const GreyAlpha *src, Rgba *dst, uint64_t count);
+
+    static void rgbaToBgra(const Rgba *src, Bgra *dst, uint64_t count);
+
+    static void bgraToRgba(const Bgra *src, Rgba *dst, uint64_t count);
+
+    /**
+     * c * a / 255 rounded to nearest
+     */
+    static void premultiply(const Rgba *src, Rgba *dst, uint64_t count);
+
+    /**
+     * c * 255 / a rounded to nearest, colour channels above alpha are clamped to it, a = 0 gives 0
+     */
+    static void unpremultiply(const Rgba *src, Rgba *dst, uint64_t count);
+
+    /**
+     * premultiply and rgbaToBgra in one pass, the layout of ARGB32 cursors and images on little endian hosts
+     */
+    static void premultiplyToBgra(const Rgba *src, Bgra *dst, uint64_t count);
+};
+
+}
+
+#endif //GXX_PIXELCONVERT_H
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_RESAMPLE_H
+#define GXX_RESAMPLE_H
+
+#include "bitmap.h"
+#include "bitmapview.h"
+
+#include <type_traits>
+
+#include <gx/gglobal.h>
+
+
+namespace gxx
+{
+
+/**
+ * Filtered scaling of 4 byte pixels with straight alpha in the last byte (Rgba, Bgra)
+ *
+ * Filtering is separable, a horizontal pass into a float buffer followed by a vertical pass,
+ * with colour weighted by alpha so transparent pixels do not bleed into their neighbours.
+ * Both passes run vectorized kernels of the set selected by PixelConvert and split large images
+ * into row bands on worker threads.
+ */
+class GX_API Resample
+{
+public:
+    template<typename PIXEL>
+    using SourceView = BitmapView<const typename std::remove_const<PIXEL>::type>;
+
+    struct Filter
+    {
+        enum Enum : uint8_t
+        {
+            Box,        //!< Area average, the fastest filter for downscaling
+            Bilinear,   //!< Triangle filter, widened when downscaling
+            Lanczos3,   //!< Sharpest, may ring near hard edges
+        };
+    };
+
+public:
+    /**
+     * Scale the whole source to the whole destination, the two must not overlap
+     *
+     * @param linearLight decode sRGB before filtering and encode afterwards,
+     *                    avoids darkened edges and mixed colours at a small cost
+     */
+    template<typename PIXEL>
+    static void resample(const BitmapView<PIXEL> &dst, const SourceView<PIXEL> &src,
+                         Filter::Enum filter = Filter::Bilinear, bool linearLight = false);
+
+    template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+    static BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>
+    resampled(const BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &src, uint32_t width, uint32_t height,
+              Filter::Enum filter = Filter::Bilinear, bool linearLight = false);
+
+private:
+    static void resampleRows(unsigned char *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstBytesPerLine,
+                             const unsigned char *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcBytesPerLine,
+                             Filter::Enum filter, bool linearLight);
+};
+
+
+template<typename PIXEL>
+void Resample::resample(const BitmapView<PIXEL> &dst, const SourceView<PIXEL> &src,
+                        Filter::Enum filter, bool linearLight)
+{
+    static_assert(sizeof(PIXEL) == 4 && !std::is_const<PIXEL>::value, "Resample needs writable 4 byte pixels");
+    if (dst.isEmpty() || src.isEmpty()) {
+        return;
+    }
+    resampleRows((unsigned char *) dst.data(), dst.width(), dst.height(), dst.bytesPerLine(),
+                 (const unsigned char *) src.data(), src.width(), src.height(), src.bytesPerLine(),
+                 filter, linearLight);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>
+Resample::resampled(const BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &src, uint32_t width, uint32_t height,
+                    Filter::Enum filter, bool linearLight)
+{
+    if (width == src.width() && height == src.height()) {
+        return src.share();
+    }
+    BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> result(width, height);
+    resample(result.view(), src.view(), filter, linearLight);
+    return result;
+}
+
+}
+
+#endif //GXX_RESAMPLE_H
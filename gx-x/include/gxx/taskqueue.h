@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_TASKQUEUE_H
+#define GXX_TASKQUEUE_H
+
+#include <gx/gglobal.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+namespace gxx
+{
+
+/**
+ * Type-erased callable stored inline, constructing or moving it never allocates.
+ * Callables larger than kStorageSize are rejected at compile time, capture large data by pointer.
+ */
+class InlineTask
+{
+public:
+    static constexpr const size_t kStorageSize = 48;
+
+public:
+    InlineTask() noexcept = default;
+
+    template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, InlineTask>::value>>
+    InlineTask(F &&f) noexcept
+    {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= kStorageSize, "Task capture is too large for inline storage");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Task capture is over aligned");
+        static_assert(std::is_nothrow_move_constructible<Fn>::value, "Task must be nothrow move constructible");
+
+        new(mStorage) Fn(std::forward<F>(f));
+        mOps = opsOf<Fn>();
+    }
+
+    InlineTask(InlineTask &&b) noexcept
+    {
+        moveFrom(b);
+    }
+
+    InlineTask &operator=(InlineTask &&b) noexcept
+    {
+        if (this != &b) {
+            reset();
+            moveFrom(b);
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask &) = delete;
+
+    InlineTask &operator=(const InlineTask &) = delete;
+
+    ~InlineTask()
+    {
+        reset();
+    }
+
+public:
+    explicit operator bool() const
+    {
+        return mOps != nullptr;
+    }
+
+    void operator()()
+    {
+        if (mOps) {
+            mOps->invoke(mStorage);
+        }
+    }
+
+    void reset()
+    {
+        if (mOps) {
+            mOps->destroy(mStorage);
+            mOps = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void *self);
+
+        void (*move)(void *dst, void *src);
+
+        void (*destroy)(void *self);
+    };
+
+    template<typename Fn>
+    static const Ops *opsOf()
+    {
+        static const Ops ops = {
+                [](void *self) { (*static_cast<Fn *>(self))(); },
+                [](void *dst, void *src) { new(dst) Fn(std::move(*static_cast<Fn *>(src))); },
+                [](void *self) { static_cast<Fn *>(self)->~Fn(); }
+        };
+        return &ops;
+    }
+
+    void moveFrom(InlineTask &b) noexcept
+    {
+        if (b.mOps) {
+            b.mOps->move(mStorage, b.mStorage);
+            mOps = b.mOps;
+            b.reset();
+        }
+    }
+
+private:
+    alignas(std::max_align_t) unsigned char mStorage[kStorageSize]{};
+    const Ops *mOps = nullptr;
+};
+
+
+/**
+ * Bounded lock-free multi-producer queue of InlineTask slots.
+ * All slots are allocated once at construction, push and pop never allocate.
+ * push may be called from any thread, pop is intended for a single consumer thread.
+ */
+class GX_API TaskQueue
+{
+public:
+    /**
+     * @param capacity Number of slots, rounded up to a power of two
+     */
+    explicit TaskQueue(uint32_t capacity = 1024);
+
+    ~TaskQueue();
+
+    TaskQueue(const TaskQueue &) = delete;
+
+    TaskQueue &operator=(const TaskQueue &) = delete;
+
+public:
+    /**
+     * @return false if the queue is full, the task is left untouched in that case
+     */
+    bool push(InlineTask &&task);
+
+    /**
+     * @return false if the queue is empty
+     */
+    bool pop(InlineTask &task);
+
+    uint32_t capacity() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        InlineTask task;
+    };
+
+    std::unique_ptr<Slot[]> mSlots;
+    size_t mMask;
+
+    alignas(64) std::atomic<size_t> mEnqueuePos{0};
+    alignas(64) std::atomic<size_t> mDequeuePos{0};
+};
+
+}
+
+#endif //GXX_TASKQUEUE_H
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_TILEDBITMAP_H
+#define GXX_TILEDBITMAP_H
+
+#include "bitmap.h"
+#include "bitmapview.h"
+
+#include <cstring>
+
+
+namespace gxx
+{
+
+/**
+ * Bitmap stored as square tiles of TILE_SIZE x TILE_SIZE pixels, tiles in row-major order,
+ * pixels row-major within a tile. Neighbours in both directions share a few cache lines,
+ * which suits rotation, transposition and column or 2D window access of large images.
+ *
+ * The pixel API matches BitmapBase, edge tiles are padded to full size.
+ * Each tile is available as a BitmapView so row kernels can run on it.
+ *
+ * @tparam TILE_SIZE  Power of two, 64 keeps a tile of 4 byte pixels within 16 KB
+ */
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE = 64>
+class TiledBitmapBase
+{
+    static_assert(TILE_SIZE >= 2 && (TILE_SIZE & (TILE_SIZE - 1)) == 0, "Tile size must be a power of two");
+
+private:
+    static constexpr const uint32_t kPixelSize = sizeof(PIXEL);
+    static constexpr const uint32_t kTileMask = TILE_SIZE - 1;
+    static constexpr const uint32_t kTilePixels = TILE_SIZE * TILE_SIZE;
+
+public:
+    static constexpr const uint32_t kTileSize = TILE_SIZE;
+
+public:
+    explicit TiledBitmapBase()
+            : mTiles(),
+              mWidth(0),
+              mHeight(0)
+    {}
+
+    explicit TiledBitmapBase(uint32_t width, uint32_t height);
+
+    /**
+     * Convert a row-major view
+     */
+    explicit TiledBitmapBase(const BitmapView<const PIXEL> &view);
+
+    TiledBitmapBase(const TiledBitmapBase &b) = default;
+
+    TiledBitmapBase(TiledBitmapBase &&b) noexcept;
+
+    TiledBitmapBase &operator=(const TiledBitmapBase &b) = default;
+
+    TiledBitmapBase &operator=(TiledBitmapBase &&b) noexcept;
+
+public:
+    void reset(uint32_t width, uint32_t height);
+
+    /**
+     * Resize without clearing the pixels inside the image, for bitmaps about to be overwritten entirely.
+     * The padding of edge tiles is still cleared.
+     */
+    void resetUninitialized(uint32_t width, uint32_t height);
+
+    uint32_t width() const;
+
+    uint32_t height() const;
+
+    uint32_t tilesX() const;
+
+    uint32_t tilesY() const;
+
+    /**
+     * Size of the tile buffer, edge padding included
+     */
+    uint64_t byteSize() const;
+
+    uint32_t pixelBytes() const;
+
+    /**
+     * Index of a pixel in the tile buffer counted in pixels
+     */
+    uint32_t pixelIndex(uint32_t x, uint32_t y) const;
+
+    unsigned char *data();
+
+    const unsigned char *data() const;
+
+    void fill(PIXEL pixel);
+
+    void setPixel(uint32_t x, uint32_t y, PIXEL pixel);
+
+    PIXEL getPixel(uint32_t x, uint32_t y) const;
+
+    /**
+     * The pixels of the tile (tx, ty) inside the image, rows are TILE_SIZE pixels apart
+     */
+    BitmapView<PIXEL> tile(uint32_t tx, uint32_t ty);
+
+    BitmapView<const PIXEL> tile(uint32_t tx, uint32_t ty) const;
+
+    /**
+     * Copy a row-major view into the tiles, the view is clipped to the bitmap
+     */
+    void copyFrom(const BitmapView<const PIXEL> &src);
+
+    /**
+     * Copy the tiles to a row-major view, clipped to the view
+     */
+    void copyTo(const BitmapView<PIXEL> &dst) const;
+
+    template<typename LinearAllocator = Allocator>
+    BitmapBase<LinearAllocator, PIXEL> toBitmap() const;
+
+    /**
+     * A bitmap sharing the tiles of this one without copying them (copy-on-write)
+     */
+    TiledBitmapBase share() const;
+
+    bool isShared() const;
+
+private:
+    /**
+     * One tile per row
+     */
+    BitmapBase<Allocator, PIXEL> mTiles;
+    uint32_t mWidth;
+    uint32_t mHeight;
+};
+
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::TiledBitmapBase(uint32_t width, uint32_t height)
+        : TiledBitmapBase()
+{
+    reset(width, height);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::TiledBitmapBase(const BitmapView<const PIXEL> &view)
+        : TiledBitmapBase()
+{
+    // Every pixel inside the image is overwritten
+    resetUninitialized(view.width(), view.height());
+    copyFrom(view);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::TiledBitmapBase(TiledBitmapBase &&b) noexcept
+        : mTiles(std::move(b.mTiles)),
+          mWidth(b.mWidth),
+          mHeight(b.mHeight)
+{
+    b.mWidth = 0;
+    b.mHeight = 0;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE> &
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::operator=(TiledBitmapBase &&b) noexcept
+{
+    if (this != &b) {
+        mTiles = std::move(b.mTiles);
+        mWidth = b.mWidth;
+        mHeight = b.mHeight;
+        b.mWidth = 0;
+        b.mHeight = 0;
+    }
+    return *this;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::reset(uint32_t width, uint32_t height)
+{
+    mWidth = width;
+    mHeight = height;
+    mTiles.reset(kTilePixels, tilesX() * tilesY());
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::resetUninitialized(uint32_t width, uint32_t height)
+{
+    mWidth = width;
+    mHeight = height;
+    mTiles.resetUninitialized(kTilePixels, tilesX() * tilesY());
+
+    // Padding columns of the right tiles, then padding rows of the bottom tiles
+    const uint32_t edgeWidth = mWidth & kTileMask;
+    const uint32_t edgeHeight = mHeight & kTileMask;
+    if (edgeWidth != 0) {
+        for (uint32_t ty = 0; ty < tilesY(); ty++) {
+            unsigned char *tile = data() + (uint64_t) (ty * tilesX() + tilesX() - 1) * kTilePixels * kPixelSize;
+            for (uint32_t y = 0; y < TILE_SIZE; y++) {
+                memset(tile + (y * TILE_SIZE + edgeWidth) * kPixelSize, 0, (TILE_SIZE - edgeWidth) * kPixelSize);
+            }
+        }
+    }
+    if (edgeHeight != 0) {
+        for (uint32_t tx = 0; tx < tilesX(); tx++) {
+            unsigned char *tile = data() + (uint64_t) ((tilesY() - 1) * tilesX() + tx) * kTilePixels * kPixelSize;
+            memset(tile + edgeHeight * TILE_SIZE * kPixelSize, 0, (TILE_SIZE - edgeHeight) * TILE_SIZE * kPixelSize);
+        }
+    }
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::width() const
+{
+    return mWidth;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::height() const
+{
+    return mHeight;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::tilesX() const
+{
+    return (mWidth + kTileMask) / TILE_SIZE;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::tilesY() const
+{
+    return (mHeight + kTileMask) / TILE_SIZE;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint64_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::byteSize() const
+{
+    return mTiles.byteSize();
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::pixelBytes() const
+{
+    return kPixelSize;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+uint32_t TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::pixelIndex(uint32_t x, uint32_t y) const
+{
+    const uint32_t tileIndex = (y / TILE_SIZE) * tilesX() + x / TILE_SIZE;
+    return tileIndex * kTilePixels + (y & kTileMask) * TILE_SIZE + (x & kTileMask);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+unsigned char *TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::data()
+{
+    return mTiles.data();
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+const unsigned char *TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::data() const
+{
+    return mTiles.data();
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::fill(PIXEL pixel)
+{
+    mTiles.fill(pixel);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::setPixel(uint32_t x, uint32_t y, PIXEL pixel)
+{
+    GX_ASSERT(x < mWidth);
+    GX_ASSERT(y < mHeight);
+
+    mTiles.setPixel((y & kTileMask) * TILE_SIZE + (x & kTileMask), (y / TILE_SIZE) * tilesX() + x / TILE_SIZE,
+                    pixel);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+PIXEL TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::getPixel(uint32_t x, uint32_t y) const
+{
+    GX_ASSERT(x < mWidth);
+    GX_ASSERT(y < mHeight);
+
+    return mTiles.getPixel((y & kTileMask) * TILE_SIZE + (x & kTileMask), (y / TILE_SIZE) * tilesX() + x / TILE_SIZE);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+BitmapView<PIXEL> TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::tile(uint32_t tx, uint32_t ty)
+{
+    GX_ASSERT(tx < tilesX());
+    GX_ASSERT(ty < tilesY());
+
+    return BitmapView<PIXEL>(data() + (uint64_t) (ty * tilesX() + tx) * kTilePixels * kPixelSize,
+                             std::min(TILE_SIZE, mWidth - tx * TILE_SIZE),
+                             std::min(TILE_SIZE, mHeight - ty * TILE_SIZE),
+                             TILE_SIZE * kPixelSize);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+BitmapView<const PIXEL> TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::tile(uint32_t tx, uint32_t ty) const
+{
+    GX_ASSERT(tx < tilesX());
+    GX_ASSERT(ty < tilesY());
+
+    return BitmapView<const PIXEL>(data() + (uint64_t) (ty * tilesX() + tx) * kTilePixels * kPixelSize,
+                                   std::min(TILE_SIZE, mWidth - tx * TILE_SIZE),
+                                   std::min(TILE_SIZE, mHeight - ty * TILE_SIZE),
+                                   TILE_SIZE * kPixelSize);
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::copyFrom(const BitmapView<const PIXEL> &src)
+{
+    // Tile by tile, each tile is written once while its source rows stream through
+    const uint32_t tx1 = (std::min(mWidth, src.width()) + kTileMask) / TILE_SIZE;
+    const uint32_t ty1 = (std::min(mHeight, src.height()) + kTileMask) / TILE_SIZE;
+    for (uint32_t ty = 0; ty < ty1; ty++) {
+        for (uint32_t tx = 0; tx < tx1; tx++) {
+            tile(tx, ty).copyFrom(src.subView(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE));
+        }
+    }
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+void TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::copyTo(const BitmapView<PIXEL> &dst) const
+{
+    const uint32_t tx1 = (std::min(mWidth, dst.width()) + kTileMask) / TILE_SIZE;
+    const uint32_t ty1 = (std::min(mHeight, dst.height()) + kTileMask) / TILE_SIZE;
+    for (uint32_t ty = 0; ty < ty1; ty++) {
+        for (uint32_t tx = 0; tx < tx1; tx++) {
+            dst.subView(tx * TILE_SIZE, ty * TILE_SIZE, TILE_SIZE, TILE_SIZE).copyFrom(tile(tx, ty));
+        }
+    }
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+template<typename LinearAllocator>
+BitmapBase<LinearAllocator, PIXEL> TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::toBitmap() const
+{
+    BitmapBase<LinearAllocator, PIXEL> bitmap;
+    bitmap.resetUninitialized(mWidth, mHeight);
+    copyTo(bitmap.view());
+    return bitmap;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE> TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::share() const
+{
+    TiledBitmapBase shared;
+    shared.mTiles = mTiles.share();
+    shared.mWidth = mWidth;
+    shared.mHeight = mHeight;
+    return shared;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+bool TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>::isShared() const
+{
+    return mTiles.isShared();
+}
+
+
+template<typename PIXEL>
+using TiledBitmap = TiledBitmapBase<gx::HeapPond, PIXEL>;
+
+}
+
+#endif //GXX_TILEDBITMAP_H
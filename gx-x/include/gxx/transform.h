@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_TRANSFORM_H
+#define GXX_TRANSFORM_H
+
+#include "bitmap.h"
+#include "bitmapview.h"
+#include "tiledbitmap.h"
+
+#include <algorithm>
+#include <type_traits>
+
+#include <gx/gglobal.h>
+
+
+namespace gxx
+{
+
+/**
+ * Flips, quarter turns and transposition of whole bitmaps
+ *
+ * Flips and the half turn walk source and destination rows in order. Operations that swap the axes read
+ * the source by columns and run in square blocks, so the source rows of a block stay in cache until the
+ * block is written. Tiled bitmaps are transformed tile by tile, a destination tile is written whole from
+ * at most four source tiles.
+ */
+class BitmapTransform
+{
+public:
+    template<typename PIXEL>
+    using SourceView = BitmapView<const typename std::remove_const<PIXEL>::type>;
+
+    struct Op
+    {
+        enum Enum : uint8_t
+        {
+            FlipHorizontal,
+            FlipVertical,
+            Rotate90,       //!< Clockwise
+            Rotate180,
+            Rotate270,      //!< Clockwise, a quarter turn counter-clockwise
+            Transpose,      //!< Mirror across the main diagonal
+        };
+    };
+
+public:
+    /**
+     * True if the result has the width and height of the source swapped
+     */
+    static bool swapsAxes(Op::Enum op)
+    {
+        return op == Op::Rotate90 || op == Op::Rotate270 || op == Op::Transpose;
+    }
+
+    /**
+     * Transform the whole source into the destination, which must have the resulting size and not overlap it
+     */
+    template<typename PIXEL>
+    static void apply(const BitmapView<PIXEL> &dst, const SourceView<PIXEL> &src, Op::Enum op);
+
+    template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+    static BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>
+    applied(const BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &src, Op::Enum op);
+
+    template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+    static TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>
+    applied(const TiledBitmapBase<Allocator, PIXEL, TILE_SIZE> &src, Op::Enum op);
+
+private:
+    static constexpr const uint32_t kBlockSize = 32;
+
+    struct Rect
+    {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /**
+     * Where the rect r of a width x height image lands after op
+     */
+    static Rect mapRect(Op::Enum op, uint32_t width, uint32_t height, const Rect &r)
+    {
+        switch (op) {
+            case Op::FlipHorizontal:
+                return {width - r.x - r.width, r.y, r.width, r.height};
+            case Op::FlipVertical:
+                return {r.x, height - r.y - r.height, r.width, r.height};
+            case Op::Rotate90:
+                return {height - r.y - r.height, r.x, r.height, r.width};
+            case Op::Rotate180:
+                return {width - r.x - r.width, height - r.y - r.height, r.width, r.height};
+            case Op::Rotate270:
+                return {r.y, width - r.x - r.width, r.height, r.width};
+            case Op::Transpose:
+            default:
+                return {r.y, r.x, r.height, r.width};
+        }
+    }
+
+    static Op::Enum inverse(Op::Enum op)
+    {
+        return op == Op::Rotate90 ? Op::Rotate270 : op == Op::Rotate270 ? Op::Rotate90 : op;
+    }
+};
+
+
+template<typename PIXEL>
+void BitmapTransform::apply(const BitmapView<PIXEL> &dst, const SourceView<PIXEL> &src, Op::Enum op)
+{
+    const uint32_t width = dst.width();
+    const uint32_t height = dst.height();
+    GX_ASSERT(width == (swapsAxes(op) ? src.height() : src.width()));
+    GX_ASSERT(height == (swapsAxes(op) ? src.width() : src.height()));
+    if (dst.isEmpty()) {
+        return;
+    }
+
+    switch (op) {
+        case Op::FlipHorizontal:
+            for (uint32_t y = 0; y < height; y++) {
+                std::reverse_copy(src.row(y), src.row(y) + width, dst.row(y));
+            }
+            return;
+        case Op::FlipVertical:
+            for (uint32_t y = 0; y < height; y++) {
+                memcpy(dst.row(y), src.row(height - 1 - y), (uint64_t) width * sizeof(PIXEL));
+            }
+            return;
+        case Op::Rotate180:
+            for (uint32_t y = 0; y < height; y++) {
+                const auto *srcRow = src.row(height - 1 - y);
+                std::reverse_copy(srcRow, srcRow + width, dst.row(y));
+            }
+            return;
+        default:
+            break;
+    }
+
+    // dst(x, y) = src(column + columnStep * y, row + rowStep * x), walking a source column per destination row
+    const int64_t firstRow = op == Op::Rotate90 ? src.height() - 1 : 0;
+    const int64_t firstColumn = op == Op::Rotate270 ? src.width() - 1 : 0;
+    const int64_t rowStep = (op == Op::Rotate90 ? -1 : 1) * (int64_t) src.bytesPerLine();
+    const int64_t columnStep = op == Op::Rotate270 ? -1 : 1;
+    const auto *base = (const unsigned char *) src.data();
+
+    for (uint32_t by = 0; by < height; by += kBlockSize) {
+        const uint32_t ye = std::min(by + kBlockSize, height);
+        for (uint32_t bx = 0; bx < width; bx += kBlockSize) {
+            const uint32_t xe = std::min(bx + kBlockSize, width);
+            for (uint32_t y = by; y < ye; y++) {
+                auto *d = dst.row(y);
+                const unsigned char *s = base + firstRow * src.bytesPerLine() + bx * rowStep +
+                                         (firstColumn + columnStep * y) * (int64_t) sizeof(PIXEL);
+                for (uint32_t x = bx; x < xe; x++, s += rowStep) {
+                    d[x] = *(const PIXEL *) s;
+                }
+            }
+        }
+    }
+}
+
+template<typename Allocator, typename PIXEL, uint32_t ROW_ALIGNMENT>
+BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT>
+BitmapTransform::applied(const BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> &src, Op::Enum op)
+{
+    BitmapBase<Allocator, PIXEL, ROW_ALIGNMENT> result;
+    if (swapsAxes(op)) {
+        result.resetUninitialized(src.height(), src.width());
+    } else {
+        result.resetUninitialized(src.width(), src.height());
+    }
+    apply(result.view(), src.view(), op);
+    return result;
+}
+
+template<typename Allocator, typename PIXEL, uint32_t TILE_SIZE>
+TiledBitmapBase<Allocator, PIXEL, TILE_SIZE>
+BitmapTransform::applied(const TiledBitmapBase<Allocator, PIXEL, TILE_SIZE> &src, Op::Enum op)
+{
+    TiledBitmapBase<Allocator, PIXEL, TILE_SIZE> result;
+    if (swapsAxes(op)) {
+        result.resetUninitialized(src.height(), src.width());
+    } else {
+        result.resetUninitialized(src.width(), src.height());
+    }
+
+    const Op::Enum back = inverse(op);
+    for (uint32_t ty = 0; ty < result.tilesY(); ty++) {
+        for (uint32_t tx = 0; tx < result.tilesX(); tx++) {
+            const BitmapView<PIXEL> dstTile = result.tile(tx, ty);
+            const Rect dstRect = {tx * TILE_SIZE, ty * TILE_SIZE, dstTile.width(), dstTile.height()};
+            const Rect srcRect = mapRect(back, result.width(), result.height(), dstRect);
+
+            // The source rect is tile sized but not tile aligned, it spans up to 2 x 2 source tiles
+            for (uint32_t sty = srcRect.y / TILE_SIZE; sty <= (srcRect.y + srcRect.height - 1) / TILE_SIZE; sty++) {
+                for (uint32_t stx = srcRect.x / TILE_SIZE; stx <= (srcRect.x + srcRect.width - 1) / TILE_SIZE; stx++) {
+                    const uint32_t x0 = std::max(srcRect.x, stx * TILE_SIZE);
+                    const uint32_t y0 = std::max(srcRect.y, sty * TILE_SIZE);
+                    const uint32_t x1 = std::min(srcRect.x + srcRect.width, (stx + 1) * TILE_SIZE);
+                    const uint32_t y1 = std::min(srcRect.y + srcRect.height, (sty + 1) * TILE_SIZE);
+                    const Rect part = {x0, y0, x1 - x0, y1 - y0};
+                    const Rect dstPart = mapRect(op, src.width(), src.height(), part);
+
+                    apply(dstTile.subView(dstPart.x - dstRect.x, dstPart.y - dstRect.y, dstPart.width, dstPart.height),
+                          src.tile(stx, sty).subView(x0 - stx * TILE_SIZE, y0 - sty * TILE_SIZE,
+                                                     part.width, part.height),
+                          op);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+}
+
+#endif //GXX_TRANSFORM_H
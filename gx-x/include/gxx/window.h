@@ -28,6 +28,8 @@
 
 #include <gxx/gui.h>
 #include <gxx/guicontext.h>
+#include <gxx/framestats.h>
+#include <gxx/framebuffer.h>
 
 #include <memory>
 #include <string>
@@ -115,6 +117,58 @@ public:
 
     void getCursorPosition(int32_t &x, int32_t &y) const;
 
+    /**
+     * 启用固定步长模拟
+     * 每帧在update之前以固定步长调用零次或多次fixedUpdate，单帧最多调用maxSteps次，
+     * 超出的时间将被丢弃以避免模拟耗时超过帧时间导致的雪崩
+     *
+     * @param step      模拟步长（秒），为0时关闭
+     * @param maxSteps  单帧最多追赶的步数
+     */
+    void setFixedTimeStep(double step, uint32_t maxSteps = 5);
+
+    double fixedTimeStep() const;
+
+    /**
+     * 最后一次fixedUpdate之后剩余的不足一个步长的时间比例，取值[0, 1)
+     * 在update中使用它对上一次与当前的模拟状态进行插值
+     */
+    double fixedStepAlpha() const;
+
+    /**
+     * 鼠标移动事件合并，默认开启
+     * 开启时同一帧内连续排队的移动事件只派发最后的位置（CursorMode::Disabled下保留累计的相对位移），
+     * 需要完整采样（如手写笔迹）时关闭
+     */
+    void setMotionCompression(bool enable);
+
+    bool motionCompression() const;
+
+    /**
+     * 最近帧的耗时统计，包含native事件泵、事件处理与update各阶段的耗时
+     */
+    const FrameStats &frameStats() const;
+
+    /**
+     * 设置卡顿回调，帧耗时超过budget时在主线程调用
+     *
+     * @param budget    帧耗时预算（秒），为0时关闭
+     * @param callback
+     */
+    void setFrameHitchCallback(double budget, FrameStats::HitchCallback callback);
+
+    /**
+     * 软件渲染的后备缓冲，尺寸与窗口一致，窗口尺寸变化后下次调用时重新创建（内容不保留）
+     * 平台不支持时返回nullptr
+     */
+    FrameBuffer *frameBuffer();
+
+    /**
+     * 将后备缓冲提交到窗口，上一次提交尚未被窗口系统读取完成时返回false，此时不应改写后备缓冲
+     * 窗口被遮挡后重新露出的区域由平台在事件处理时用最近一次提交的帧重绘，无需再次提交
+     */
+    bool presentFrameBuffer();
+
 public: // GUIContext functions
     Application *getApplication() const override;
 
@@ -123,6 +177,14 @@ protected:
 
     virtual bool update(double delta);
 
+    /**
+     * Fixed timestep simulation, only called after setFixedTimeStep
+     *
+     * @param step  Simulation step in seconds
+     * @return false to exit the window
+     */
+    virtual bool fixedUpdate(double step);
+
     virtual void resetSize(int32_t w, int32_t h);
 
     virtual void onDestroy();
@@ -146,6 +208,11 @@ protected:
 
     virtual void keyReleaseEvent(Key::Enum key, uint8_t modifier);
 
+    /**
+     * 按住按键时的自动重复，默认按keyPressEvent处理
+     */
+    virtual void keyRepeatEvent(Key::Enum key, uint8_t modifier);
+
     virtual void mouseMoveEvent(int32_t x, int32_t y);
 
     virtual void mousePressEvent(MouseButton::Enum button);
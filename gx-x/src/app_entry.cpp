@@ -23,10 +23,13 @@
 #include "gxx/app_entry.h"
 
 #include <gxx/app_native.h>
+#include <gxx/application.h>
 #include <gxx/window.h>
 
 #include "gx/debug.h"
 
+#include <algorithm>
+
 
 using namespace gx;
 
@@ -43,15 +46,7 @@ AppContext::AppContext()
 {
     mEventMana = new EventMana();
     mEventMana->addEventHandler(AppNativeEvents::Exit, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetWindowSize, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetWindowPos, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetWindowTitle, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetWindowState, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetWindowFlags, this);
     mEventMana->addEventHandler(AppNativeEvents::ShowInfoDialog, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetCursor, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetCursorMode, this);
-    mEventMana->addEventHandler(AppNativeEvents::SetCursorPos, this);
 }
 
 AppContext::~AppContext()
@@ -68,31 +63,36 @@ void AppContext::postExitWindow(WindowContext *window)
 
 void AppContext::postSetWindowSize(WindowContext *window, uint32_t w, uint32_t h)
 {
-    mEventMana->postEvent(new ANSetWinSizeEvent(window, w, h));
+    PendingNativeCommands &pending = pendingCommands(window, PendingNativeCommands::Size);
+    pending.width = w;
+    pending.height = h;
     this->postNativeEvent();
 }
 
 void AppContext::postSetWindowPos(WindowContext *window, int32_t x, int32_t y)
 {
-    mEventMana->postEvent(new ANSetWinPosEvent(window, x, y));
+    PendingNativeCommands &pending = pendingCommands(window, PendingNativeCommands::Pos);
+    pending.x = x;
+    pending.y = y;
     this->postNativeEvent();
 }
 
 void AppContext::postSetWindowTitle(WindowContext *window, const std::string &title)
 {
-    mEventMana->postEvent(new ANSetWinTitleEvent(window, title));
+    PendingNativeCommands &pending = pendingCommands(window, PendingNativeCommands::Title);
+    pending.title = title;
     this->postNativeEvent();
 }
 
 void AppContext::postSetWindowState(WindowContext *window, WindowState::Enum state)
 {
-    mEventMana->postEvent(new ANSetWinStateEvent(window, state));
+    pendingCommands(window, PendingNativeCommands::State).state = state;
     this->postNativeEvent();
 }
 
 void AppContext::postSetWindowFlags(WindowContext *window, WindowFlags flags)
 {
-    mEventMana->postEvent(new ANSetWinFlagsEvent(window, flags));
+    pendingCommands(window, PendingNativeCommands::Flags).windowFlags = flags;
     this->postNativeEvent();
 }
 
@@ -104,24 +104,128 @@ void AppContext::postShowInfoDialog(gxx::WindowContext *window, const std::strin
 
 void AppContext::postSetCursor(WindowContext *window, const Cursor &cursor)
 {
-    mEventMana->postEvent(new ANSetCursorEvent(window, cursor));
+    PendingNativeCommands &pending = pendingCommands(window, PendingNativeCommands::Cursor);
+    pending.cursor = cursor;
     this->postNativeEvent();
 }
 
 void AppContext::postSetCursorMode(WindowContext *window, CursorMode::Enum mode)
 {
-    mEventMana->postEvent(new ANSetCursorModeEvent(window, mode));
+    pendingCommands(window, PendingNativeCommands::CursorMode).cursorMode = mode;
     this->postNativeEvent();
 }
 
 void AppContext::postSetCursorPos(WindowContext *window, int32_t x, int32_t y)
 {
-    mEventMana->postEvent(new ANSetCursorPosEvent(window, x, y));
+    PendingNativeCommands &pending = pendingCommands(window, PendingNativeCommands::CursorPos);
+    pending.cursorX = x;
+    pending.cursorY = y;
     this->postNativeEvent();
 }
 
+AppContext::PendingNativeCommands &AppContext::pendingCommands(WindowContext *window,
+                                                               PendingNativeCommands::Kind kind)
+{
+    PendingNativeCommands &pending = mPendingCommands[window];
+    uint8_t *const end = pending.order + pending.orderCount;
+    uint8_t *const found = std::find(pending.order, end, (uint8_t) kind);
+    if (found != end) {
+        // The older value never reaches the native window, the newer one is applied after everything before it
+        std::copy(found + 1, end, found);
+        pending.orderCount--;
+        mSavedNativeCommands++;
+    }
+    pending.order[pending.orderCount++] = kind;
+    return pending;
+}
+
+void AppContext::flushNativeCommands()
+{
+    for (auto &it : mPendingCommands) {
+        WindowHandle *wh = dynamic_cast<WindowHandle *>(it.first);
+        NWindow *nw;
+        if (!wh || !(nw = wh->mNativeWindow)) {
+            continue;
+        }
+        const PendingNativeCommands &pending = it.second;
+        for (uint8_t i = 0; i < pending.orderCount; i++) {
+            switch (pending.order[i]) {
+                case PendingNativeCommands::Size:
+                    nw->setWindowSize(pending.width, pending.height);
+                    break;
+                case PendingNativeCommands::Pos:
+                    nw->setWindowPos(pending.x, pending.y);
+                    break;
+                case PendingNativeCommands::Title:
+                    nw->setWindowTitle(pending.title);
+                    break;
+                case PendingNativeCommands::State:
+                    nw->setWindowState(pending.state);
+                    break;
+                case PendingNativeCommands::Flags:
+                    nw->setWindowFlags(pending.windowFlags);
+                    break;
+                case PendingNativeCommands::Cursor:
+                    nw->setCursor(pending.cursor);
+                    break;
+                case PendingNativeCommands::CursorMode:
+                    nw->setCursorMode(pending.cursorMode);
+                    break;
+                case PendingNativeCommands::CursorPos:
+                    nw->setCursorPosition(pending.cursorX, pending.cursorY);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    mPendingCommands.clear();
+
+    mNative->flush();
+}
+
+void AppContext::setCharInputEnabled(uint32_t windowId, bool enabled)
+{
+    for (WindowHandle *wh : mWindows) {
+        if (wh->getWindowId() == windowId) {
+            if (wh->mNativeWindow) {
+                wh->mNativeWindow->setCharInputEnabled(enabled);
+            }
+            return;
+        }
+    }
+}
+
+void AppContext::onDeviceHandlerRegistered(BaseDeviceHandler *deviceHandler)
+{
+    if (deviceHandler->deviceType() != DeviceType::CharInput) {
+        return;
+    }
+    if (++mCharInputHandlers[deviceHandler->deviceId()] == 1) {
+        setCharInputEnabled(deviceHandler->deviceId(), true);
+    }
+}
+
+void AppContext::onDeviceHandlerUnregistered(BaseDeviceHandler *deviceHandler)
+{
+    if (deviceHandler->deviceType() != DeviceType::CharInput) {
+        return;
+    }
+    auto it = mCharInputHandlers.find(deviceHandler->deviceId());
+    if (it == mCharInputHandlers.end()) {
+        return;
+    }
+    if (--it->second == 0) {
+        mCharInputHandlers.erase(it);
+        setCharInputEnabled(deviceHandler->deviceId(), false);
+    }
+}
+
 void AppContext::destroyWindow(gxx::WindowHandle *wh)
 {
+    mPendingCommands.erase(wh);
+    // The handlers are destroyed with the window, after its native window is gone
+    mCharInputHandlers.erase(wh->getWindowId());
     wh->destroy();
     nativeDestroyW(wh);
     delete wh->mWindow;
@@ -129,7 +233,7 @@ void AppContext::destroyWindow(gxx::WindowHandle *wh)
 
 NWindow *AppContext::createNWindow(WindowHandle *wh)
 {
-    return gxx::createNativeWindow();
+    return mNative->createWindow();
 }
 
 bool AppContext::nativeFrameW(gxx::WindowHandle *wh)
@@ -152,18 +256,38 @@ void AppContext::nativeDestroyW(WindowHandle *wh)
     }
 }
 
+const NativeBackend &platformNativeBackend()
+{
+    static const NativeBackend backend = {
+            createNativeWindow,
+            nativeInit,
+            nativeTerminate,
+            nativeDeviceSupport,
+            nativeGetConnectedGamepadStateInfos,
+            nativeGetDesktopSize,
+            nativeWakeup,
+            nativePollEvents,
+            nativeFlush,
+            nativeGetFrameStats,
+    };
+    return backend;
+}
+
 /** ========= ========= **/
 int AppContext::init(Application *app)
 {
     mScheduler = GTimerScheduler::create("MainScheduler");
     GTimerScheduler::makeGlobal(mScheduler);
-    return nativeInit(this);
+    mNative = Application::isHeadless() ? &headlessNativeBackend() : &platformNativeBackend();
+    return mNative->init(this);
 }
 
 int AppContext::run(Application *app)
 {
     mScheduler->start();
     while (!mWindows.empty() || !mDelayedTasks.empty()) {
+        runMainThreadTasks();
+
         while (!mDelayedTasks.empty()) {
             auto task = mDelayedTasks.front();
             mDelayedTasks.pop();
@@ -174,13 +298,21 @@ int AppContext::run(Application *app)
 
         mScheduler->loop();
 
+        // [0] 所有native window共享的事件泵，耗时计入每个窗口的NativePump阶段
+        const int64_t pollStart = FrameStats::now();
+        mNative->pollEvents();
+        const int64_t pollTime = FrameStats::now() - pollStart;
+
         auto it = mWindows.begin();
         while (it != mWindows.end()) {
             WindowHandle *wh = *it;
+            const int64_t pumpStart = FrameStats::now();
+            wh->beginFrameTiming(pumpStart);
             // [1] native window的事件处理
             if (!nativeFrameW(wh)) {
                 wh->postExitEvent();
             }
+            wh->setPhaseTime(FramePhase::NativePump, pumpStart - pollTime, FrameStats::now());
             // [2] window的事件处理与绘制
             wh->frame();
             // [3] window到native window的事件处理
@@ -192,12 +324,14 @@ int AppContext::run(Application *app)
                 it++;
             }
         }
+        // [4] 合并后的native窗口命令，每帧只提交一次
+        flushNativeCommands();
     }
 
     mScheduler->stop();
     mScheduler = nullptr;
 
-    return nativeTerminate(this);
+    return mNative->terminate(this);
 }
 
 void AppContext::addWindow(Window *window)
@@ -231,12 +365,42 @@ void AppContext::addWindow(Window *window)
         }
         wh->mNativeWindow = nw;
         mWindows.push_back(wh);
+
+        // Handlers registered before the native window existed
+        if (mCharInputHandlers.count(wh->getWindowId()) > 0) {
+            nw->setCharInputEnabled(true);
+        }
     });
 }
 
+bool AppContext::postMainThreadTask(InlineTask &&task)
+{
+    if (!mMainThreadTasks.push(std::move(task))) {
+        return false;
+    }
+    // Only the first task after a drain needs to wake the loop
+    if (!mWakeupPending.exchange(true, std::memory_order_acq_rel)) {
+        mNative->wakeup();
+    }
+    return true;
+}
+
+void AppContext::runMainThreadTasks()
+{
+    mWakeupPending.store(false, std::memory_order_release);
+
+    // Bounded so that tasks re-posting themselves cannot starve the windows
+    uint32_t count = mMainThreadTasks.capacity();
+    InlineTask task;
+    while (count-- > 0 && mMainThreadTasks.pop(task)) {
+        task();
+        task.reset();
+    }
+}
+
 void AppContext::getDesktopSize(uint32_t &w, uint32_t &h)
 {
-    nativeGetDesktopSize(w, h);
+    mNative->getDesktopSize(w, h);
 }
 
 void AppContext::closeAll()
@@ -258,46 +422,6 @@ void AppContext::handleANEvent(ANBaseEvent *event)
             nw->exit();
         }
             break;
-        case AppNativeEvents::SetWindowSize: {
-            const auto *e = dynamic_cast<const ANSetWinSizeEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setWindowSize(e->width, e->height);
-        }
-            break;
-        case AppNativeEvents::SetWindowPos: {
-            const auto *e = dynamic_cast<const ANSetWinPosEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setWindowPos(e->x, e->y);
-        }
-            break;
-        case AppNativeEvents::SetWindowTitle: {
-            const auto *e = dynamic_cast<const ANSetWinTitleEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setWindowTitle(e->title);
-        }
-            break;
-        case AppNativeEvents::SetWindowState: {
-            const auto *e = dynamic_cast<const ANSetWinStateEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setWindowState(e->state);
-        }
-            break;
-        case AppNativeEvents::SetWindowFlags: {
-            const auto *e = dynamic_cast<const ANSetWinFlagsEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setWindowFlags(e->flags);
-        }
-            break;
         case AppNativeEvents::ShowInfoDialog: {
             const auto *e = dynamic_cast<const ANShowInfoDialogEvent *>(event);
             if (!e) {
@@ -306,30 +430,6 @@ void AppContext::handleANEvent(ANBaseEvent *event)
             nw->showInfoDialog(e->title, e->message);
         }
             break;
-        case AppNativeEvents::SetCursor: {
-            const auto *e = dynamic_cast<const ANSetCursorEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setCursor(e->cursor);
-        }
-            break;
-        case AppNativeEvents::SetCursorMode: {
-            const auto *e = dynamic_cast<const ANSetCursorModeEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setCursorMode(e->mode);
-        }
-            break;
-        case AppNativeEvents::SetCursorPos: {
-            const auto *e = dynamic_cast<const ANSetCursorPosEvent *>(event);
-            if (!e) {
-                break;
-            }
-            nw->setCursorPosition(e->x, e->y);
-        }
-            break;
     }
 }
 
@@ -340,12 +440,22 @@ void AppContext::postNativeEvent()
 
 bool AppContext::deviceSupport(DeviceType::Enum type)
 {
-    return nativeDeviceSupport(type);
+    return mNative->deviceSupport(type);
 }
 
 std::vector<GamepadStateInfo> AppContext::getConnectedGamepadStateInfos()
 {
-    return nativeGetConnectedGamepadStateInfos();
+    return mNative->getConnectedGamepadStateInfos();
+}
+
+uint64_t AppContext::savedNativeCommandCount() const
+{
+    return mSavedNativeCommands;
+}
+
+NativeFrameStats AppContext::nativeFrameStats() const
+{
+    return mNative->getFrameStats();
 }
 
 }
\ No newline at end of file
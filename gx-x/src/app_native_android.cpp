@@ -38,6 +38,8 @@ using namespace gx;
 namespace gxx
 {
 
+static ALooper *sMainLooper = nullptr;
+
 class NAndroidWindow : public NWindow
 {
 public:
@@ -418,6 +420,7 @@ NWindow *createNativeWindow()
 
 int nativeInit(AppContext *appCtx)
 {
+    sMainLooper = ALooper_forThread();
     Application *app = Application::application();
     return app->appArg()->argd == nullptr ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -452,6 +455,26 @@ void nativeGetDesktopSize(uint32_t &w, uint32_t &h)
 
 }
 
+void nativeWakeup()
+{
+    if (sMainLooper) {
+        ALooper_wake(sMainLooper);
+    }
+}
+
+void nativePollEvents()
+{
+}
+
+void nativeFlush()
+{
+}
+
+NativeFrameStats nativeGetFrameStats()
+{
+    return {};
+}
+
 }
 
 #endif // ENTRY_CONFIG_USE_NATIVE && GX_PLATFORM_ANDROID
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/app_native.h"
+
+#include "gxx/app_entry.h"
+#include "gxx/framebuffer.h"
+
+#include <gx/debug.h>
+
+#include <memory>
+
+
+namespace gxx
+{
+
+struct HeadlessGlobal
+{
+    uint32_t desktopWidth = 1920;
+    uint32_t desktopHeight = 1080;
+
+    NativeFrameStats frameStats;
+    NativeFrameStats lastFrameStats;
+};
+
+static HeadlessGlobal sHeadless{};
+
+/**
+ * Offscreen surface in client memory, laid out like Bitmap<Rgba>
+ */
+class HeadlessFrameBuffer : public FrameBuffer
+{
+public:
+    explicit HeadlessFrameBuffer(uint32_t width, uint32_t height)
+            : HeadlessFrameBuffer(std::make_unique<Bitmap<Rgba>>(width, height))
+    {}
+
+private:
+    explicit HeadlessFrameBuffer(std::unique_ptr<Bitmap<Rgba>> bitmap)
+            : FrameBuffer(bitmap->width(), bitmap->height(), bitmap->bytesPerLine(), PixelFormat::Rgba, bitmap->data()),
+              mBitmap(std::move(bitmap))
+    {}
+
+private:
+    std::unique_ptr<Bitmap<Rgba>> mBitmap;
+};
+
+class HeadlessWindow : public NWindow
+{
+public:
+    bool init(AppContext *appCtx, WindowHandle *wh) override
+    {
+        mAppContext = appCtx;
+        mWh = wh;
+
+        mX = wh->getX();
+        mY = wh->getY();
+        mWidth = wh->getWindowWidth();
+        mHeight = wh->getWindowHeight();
+        mTitle = wh->getWindowTitle();
+        mState = wh->getWindowState();
+        mFlags = wh->getWindowFlags();
+
+        wh->setPlatformData(WindowHandle::PlatformData());
+        mInited = true;
+
+        wh->init();
+        wh->postWindowFocusChange(true);
+        return true;
+    }
+
+    bool isInited() override
+    {
+        return mInited;
+    }
+
+    bool frame() override
+    {
+        return !mExit;
+    }
+
+    void destroy() override
+    {
+        mFrameBuffer = nullptr;
+        mInited = false;
+    }
+
+public:
+    void exit() override
+    {
+        mExit = true;
+    }
+
+    void setWindowSize(uint32_t w, uint32_t h) override
+    {
+        if (w == mWidth && h == mHeight) {
+            return;
+        }
+        mWidth = w;
+        mHeight = h;
+        mWh->postWindowSizeEvent(w, h);
+    }
+
+    void setWindowPos(int32_t x, int32_t y) override
+    {
+        if (x == mX && y == mY) {
+            return;
+        }
+        mX = x;
+        mY = y;
+        mWh->postWindowPosEvent(x, y);
+    }
+
+    void setWindowTitle(const std::string &title) override
+    {
+        mTitle = title;
+    }
+
+    void setWindowState(WindowState::Enum state) override
+    {
+        mState = state;
+    }
+
+    void setWindowFlags(WindowFlags flags) override
+    {
+        mFlags = flags;
+    }
+
+    void showInfoDialog(const std::string &title, const std::string &msg) override
+    {
+        Log("%s: %s", title.c_str(), msg.c_str());
+    }
+
+    void setCursor(const Cursor &cursor) override
+    {
+    }
+
+    void setCursorMode(CursorMode::Enum mode) override
+    {
+        mCursorMode = mode;
+    }
+
+    void setCursorPosition(int32_t x, int32_t y) override
+    {
+        mCursorX = x;
+        mCursorY = y;
+    }
+
+    void getCursorPosition(int32_t &x, int32_t &y) override
+    {
+        x = mCursorX;
+        y = mCursorY;
+    }
+
+    FrameBuffer *getFrameBuffer() override
+    {
+        if (mFrameBuffer && (mFrameBuffer->width() != mWidth || mFrameBuffer->height() != mHeight)) {
+            mFrameBuffer = nullptr;
+        }
+        if (!mFrameBuffer && mWidth > 0 && mHeight > 0) {
+            mFrameBuffer = std::make_unique<HeadlessFrameBuffer>(mWidth, mHeight);
+        }
+        return mFrameBuffer.get();
+    }
+
+    bool presentFrameBuffer() override
+    {
+        if (!mFrameBuffer) {
+            return false;
+        }
+        const auto &rects = mFrameBuffer->dirtyRects();
+        if (rects.empty()) {
+            sHeadless.frameStats.uploadedBytes += mFrameBuffer->byteSize();
+        } else {
+            for (const auto &rect : rects) {
+                sHeadless.frameStats.uploadedBytes += (uint64_t) rect.width * rect.height * mFrameBuffer->pixelBytes();
+            }
+        }
+        mFrameBuffer->clearDirty();
+        return true;
+    }
+
+private:
+    AppContext *mAppContext = nullptr;
+    WindowHandle *mWh = nullptr;
+
+    bool mInited = false;
+    bool mExit = false;
+
+    int32_t mX = 0;
+    int32_t mY = 0;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    std::string mTitle;
+    WindowState::Enum mState = WindowState::Normal;
+    WindowFlags mFlags = 0;
+
+    CursorMode::Enum mCursorMode = CursorMode::Normal;
+    int32_t mCursorX = 0;
+    int32_t mCursorY = 0;
+
+    std::unique_ptr<HeadlessFrameBuffer> mFrameBuffer;
+};
+
+
+static NWindow *headlessCreateWindow()
+{
+    return new HeadlessWindow();
+}
+
+static int headlessInit(AppContext *appCtx)
+{
+    Log("Running headless, no window system is used");
+    return 0;
+}
+
+static int headlessTerminate(AppContext *appCtx)
+{
+    return EXIT_SUCCESS;
+}
+
+static bool headlessDeviceSupport(DeviceType::Enum type)
+{
+    switch (type) {
+        case DeviceType::Keyboard:
+        case DeviceType::Mouse:
+        case DeviceType::CharInput:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static std::vector<GamepadStateInfo> headlessGetConnectedGamepadStateInfos()
+{
+    return {};
+}
+
+static void headlessGetDesktopSize(uint32_t &w, uint32_t &h)
+{
+    w = sHeadless.desktopWidth;
+    h = sHeadless.desktopHeight;
+}
+
+static void headlessWakeup()
+{
+    // The loop never waits for events
+}
+
+static void headlessPollEvents()
+{
+}
+
+static void headlessFlush()
+{
+    sHeadless.lastFrameStats = sHeadless.frameStats;
+    sHeadless.frameStats = {};
+}
+
+static NativeFrameStats headlessGetFrameStats()
+{
+    return sHeadless.lastFrameStats;
+}
+
+const NativeBackend &headlessNativeBackend()
+{
+    static const NativeBackend backend = {
+            headlessCreateWindow,
+            headlessInit,
+            headlessTerminate,
+            headlessDeviceSupport,
+            headlessGetConnectedGamepadStateInfos,
+            headlessGetDesktopSize,
+            headlessWakeup,
+            headlessPollEvents,
+            headlessFlush,
+            headlessGetFrameStats,
+    };
+    return backend;
+}
+
+}
@@ -1006,6 +1006,35 @@ void nativeGetDesktopSize(uint32_t &w, uint32_t &h)
     h = (uint32_t)screenRect.size.height;
 }
 
+void nativeWakeup()
+{
+    @autoreleasepool {
+        NSEvent *event = [NSEvent otherEventWithType:NSEventTypeApplicationDefined
+                                            location:NSMakePoint(0, 0)
+                                       modifierFlags:0
+                                           timestamp:0
+                                        windowNumber:0
+                                             context:nil
+                                             subtype:0
+                                               data1:0
+                                               data2:0];
+        [NSApp postEvent:event atStart:YES];
+    }
+}
+
+void nativePollEvents()
+{
+}
+
+void nativeFlush()
+{
+}
+
+NativeFrameStats nativeGetFrameStats()
+{
+    return {};
+}
+
 static void initStaic()
 {
     __translateKey[27] = Key::Esc;
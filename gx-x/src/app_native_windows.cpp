@@ -25,6 +25,7 @@
 #if ENTRY_CONFIG_USE_NATIVE && GX_PLATFORM_WINDOWS
 
 #include <gxx/app_entry.h>
+#include <gxx/pixelconvert.h>
 
 #define OEMRESOURCE
 
@@ -70,6 +71,8 @@ static Key::Enum sTranslateKey[256];
 
 static NGamepadMgr *sGamepadMgr = nullptr;
 
+static DWORD sMainThreadId = 0;
+
 static void initStatic();
 
 typedef DWORD (WINAPI *PFN_XInputGetCapabilities)(DWORD, DWORD, XINPUT_CAPABILITIES *);
@@ -1068,7 +1071,6 @@ void NCursor::createCustomCursor(const CursorBitmap &bitmap, int32_t hotX, int32
 
 HICON NCursor::createIcon(const CursorBitmap &bitmap, int hotX, int hotY)
 {
-    int i;
     HDC dc;
     HICON handle;
     HBITMAP color, mask;
@@ -1108,14 +1110,7 @@ HICON NCursor::createIcon(const CursorBitmap &bitmap, int hotX, int hotY)
         return nullptr;
     }
 
-    for (i = 0; i < bitmap.width() * bitmap.height(); i++) {
-        target[0] = source[2];
-        target[1] = source[1];
-        target[2] = source[0];
-        target[3] = source[3];
-        target += 4;
-        source += 4;
-    }
+    PixelConvert::rgbaToBgra((const Rgba *) source, (Bgra *) target, (uint64_t) bitmap.width() * bitmap.height());
 
     ZeroMemory(&ii, sizeof(ii));
     ii.fIcon = false;
@@ -1173,6 +1168,7 @@ NWindow *createNativeWindow()
 
 int nativeInit(AppContext *appCtx)
 {
+    sMainThreadId = GetCurrentThreadId();
     SetDllDirectoryA(".");
     initStatic();
     return 0;
@@ -1218,6 +1214,27 @@ void nativeGetDesktopSize(uint32_t &w, uint32_t &h)
     h = rc.bottom - rc.top;
 }
 
+void nativeWakeup()
+{
+    // PeekMessageW(nullptr, ...) also drains thread messages, WM_NULL is simply discarded
+    if (sMainThreadId != 0) {
+        PostThreadMessageW(sMainThreadId, WM_NULL, 0, 0);
+    }
+}
+
+void nativePollEvents()
+{
+}
+
+void nativeFlush()
+{
+}
+
+NativeFrameStats nativeGetFrameStats()
+{
+    return {};
+}
+
 /** ==== const static functions ==== **/
 static void initStatic()
 {
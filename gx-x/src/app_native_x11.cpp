@@ -22,18 +22,24 @@
 
 #include "gxx/app_native.h"
 
-#if ENTRY_CONFIG_USE_NATIVE && (GX_PLATFORM_BSD || GX_PLATFORM_LINUX || GX_PLATFORM_RPI)
+#if ENTRY_CONFIG_USE_NATIVE && !GXX_USE_XCB && (GX_PLATFORM_BSD || GX_PLATFORM_LINUX || GX_PLATFORM_RPI)
 
 #include "gxx/app_entry.h"
+#include "gxx/framebuffer.h"
+#include "gxx/pixelconvert.h"
 
-#define XK_MISCELLANY
-#define XK_LATIN1
-#include <X11/keysymdef.h>
+#include "x11_keysym.h"
+#include "native_cursor_cache.h"
 #include <X11/Xlib.h> // will include X11 which #defines None... Don't mess with order of includes.
 #include <X11/Xutil.h>
 #include <X11/Xcursor/Xcursor.h>
 #include <X11/cursorfont.h>
 #include <X11/Xatom.h>
+#include <X11/XKBlib.h>
+#include <X11/extensions/XShm.h>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -41,6 +47,9 @@
 
 #include <assert.h>
 
+#include <bitset>
+#include <unordered_map>
+
 #include <gx/debug.h>
 
 #ifdef None
@@ -72,24 +81,73 @@ struct X11Global
     ::Window root = 0;
     XIM im = nullptr;
 
-    NX11Window *focusWindow;
+    // XKB extension state, the keycode map falls back to the core keymap without it
+    bool xkb = false;
+    int xkbEventBase = 0;
+    int xkbGroup = 0;
+    // Held keys repeat as presses only, without the synthetic release before each of them
+    bool detectableAutoRepeat = false;
+
+    // MIT-SHM, cleared when attaching a segment fails (e.g. the server is remote)
+    bool shm = false;
+    int shmCompletionEvent = 0;
+
+    // Owner of each native window, used to dispatch the events of the shared pump
+    std::unordered_map<::Window, NX11Window *> windows;
+
+    // Target of the wakeup messages sent by nativeWakeup
+    ::Window wakeupWindow = 0;
 
+    // Interned once in nativeInit, XInternAtom is a synchronous round trip
     Atom UTF8_STRING = 0;
     Atom NET_WM_NAME = 0;
-    Atom NET_WMmIcON_NAME = 0;
+    Atom NET_WM_ICON_NAME = 0;
     Atom WM_DELETE_WINDOW = 0;
+    Atom GXX_WAKEUP = 0;
+    Atom NET_WM_STATE = 0;
+    Atom NET_WM_STATE_MAXIMIZED_VERT = 0;
+    Atom NET_WM_STATE_MAXIMIZED_HORZ = 0;
+    Atom NET_WM_STATE_HIDDEN = 0;
+    Atom NET_WM_STATE_FULLSCREEN = 0;
+
+    // Counters of the current frame and of the last completed one
+    NativeFrameStats frameStats;
+    NativeFrameStats lastFrameStats;
 };
 
-static uint8_t sTranslateKey[512];
+/**
+ * Key and modifier of every keycode for the active keyboard layout.
+ * Built from the server keymap at startup and rebuilt only when the mapping or the active group changes,
+ * so translating a key event is a single array load.
+ */
+static KeycodeEntry sKeycodeMap[256];
 
-static void initTranslateKey(uint16_t xk, Key::Enum key);
+static void buildKeycodeMap();
 
-static void initStatic();
+static void handleXkbEvent(const XEvent &event);
 
 static unsigned int decodeUTF8(const char** s);
 
 static X11Global sX11App{};
 
+/**
+ * Every remaining request that waits for a reply of the server must be counted here
+ */
+static inline void countRoundTrip()
+{
+    sX11App.frameStats.roundTrips++;
+}
+
+/**
+ * Requests are buffered by Xlib and written once per frame by nativeFlush.
+ * Call this only for requests whose latency matters, such as pointer warps.
+ */
+static inline void flushImmediately()
+{
+    XFlush(sX11App.display);
+    sX11App.frameStats.flushes++;
+}
+
 static long EVENT_MASK = StructureNotifyMask | KeyPressMask | KeyReleaseMask |
                          PointerMotionMask | ButtonPressMask | ButtonReleaseMask |
                          ExposureMask | FocusChangeMask | VisibilityChangeMask |
@@ -98,6 +156,55 @@ static long EVENT_MASK = StructureNotifyMask | KeyPressMask | KeyReleaseMask |
 
 class NX11Window;
 
+/**
+ * Window backbuffer in a SysV shared memory segment attached to the server,
+ * or in client memory sent with XPutImage when MIT-SHM is unavailable
+ */
+class NX11FrameBuffer : public FrameBuffer
+{
+public:
+    static NX11FrameBuffer *create(uint32_t width, uint32_t height);
+
+    ~NX11FrameBuffer() override;
+
+public:
+    /**
+     * Upload the rects to a server side front pixmap and copy them from there to the window.
+     * With MIT-SHM the server reads the segment asynchronously, a completion event for shmSeg()
+     * is sent once the last rect is read, returns whether such an event is pending.
+     */
+    bool present(::Window window, GC gc, const std::vector<Rect> &rects);
+
+    /**
+     * Copy a rect of the last presented frame to the window, nothing before the first present
+     */
+    void repaint(::Window window, GC gc, const Rect &rect) const;
+
+    bool isShm() const
+    {
+        return mShm;
+    }
+
+    ShmSeg shmSeg() const
+    {
+        return mShmInfo.shmseg;
+    }
+
+private:
+    explicit NX11FrameBuffer(XImage *image, const XShmSegmentInfo &shmInfo, bool shm, PixelFormat::Enum format);
+
+    static XImage *createShmImage(uint32_t width, uint32_t height, XShmSegmentInfo &shmInfo);
+
+    bool clip(const Rect &rect, Rect &clipped) const;
+
+private:
+    XImage *mImage;
+    XShmSegmentInfo mShmInfo;
+    bool mShm;
+    // Holds the last presented frame while the application draws the next one into mImage
+    Pixmap mFront = 0;
+};
+
 class NCursor
 {
 public:
@@ -114,19 +221,20 @@ public:
 
     static bool cursorInContentArea(NX11Window *window);
 
-    static ::Cursor createCursor(const CursorBitmap &bitmap, int hotX, int hotY);
+    static ::Cursor createNativeCursor(const Cursor &cursor);
 
-    static void destroyCursor(::Cursor cursor);
+    static ::Cursor createShapeCursor(Cursor::CursorShape shape);
 
-private:
-    void createShapeCursor(Cursor::CursorShape shape);
+    static ::Cursor createCursor(const CursorBitmap &bitmap, int hotX, int hotY);
 
-    void createCustomCursor(const CursorBitmap &bitmap, int32_t hotX, int32_t hotY);
+    static void destroyCursor(::Cursor cursor);
 
 private:
     ::Cursor mCursor = 0;
 };
 
+static NativeCursorCache<::Cursor> sCursorCache(NCursor::createNativeCursor, NCursor::destroyCursor);
+
 class NX11Window : public NWindow
 {
 public:
@@ -159,6 +267,8 @@ public:
         XChangeWindowAttributes(sX11App.display, mNativeWindow, CWBackPixel, &attr);
 
 
+        sX11App.windows[mNativeWindow] = this;
+
         XSetWMProtocols(sX11App.display, mNativeWindow, &sX11App.WM_DELETE_WINDOW, 1);
 
         const char *applicationName = "gxx";
@@ -172,11 +282,7 @@ public:
         XSetClassHint(sX11App.display, mNativeWindow, hint);
         XFree(hint);
 
-        if (sX11App.im) {
-            mIc = XCreateIC(sX11App.im, XNInputStyle, XIMPreeditNothing | XIMStatusNothing, XNClientWindow, mNativeWindow,
-                            XNFocusWindow, mNativeWindow, NULL
-            );
-        }
+        // The input context is created by setCharInputEnabled once the window has a CharInput handler
 
         x11SetDisplayWindow(mWh, sX11App.display, mNativeWindow);
 
@@ -187,8 +293,7 @@ public:
         setWindowFlags(wh->getWindowFlags());
         setWindowState(wh->getWindowState());
 
-        CursorBitmap bitmap(16, 16);
-        mHiddenCursor = NCursor::createCursor(bitmap, 0, 0);
+        mHiddenCursor = sCursorCache.acquire(Cursor(CursorBitmap(16, 16), 0, 0));
 
         wh->init();
         return true;
@@ -199,24 +304,71 @@ public:
         return mNativeWindow;
     }
 
-    bool frame() override
+    void setCharInputEnabled(bool enabled) override
     {
-        if (mExit) {
-            return false;
+        if (!mNativeWindow || !sX11App.im || enabled == (mIc != nullptr)) {
+            return;
+        }
+        if (enabled) {
+            // Xlib queries the input method server while creating the context
+            countRoundTrip();
+            mIc = XCreateIC(sX11App.im, XNInputStyle, XIMPreeditNothing | XIMStatusNothing, XNClientWindow, mNativeWindow,
+                            XNFocusWindow, mNativeWindow, NULL
+            );
+            if (mIc && mFocused) {
+                XSetICFocus(mIc);
+            }
+        } else {
+            XDestroyIC(mIc);
+            mIc = nullptr;
         }
+    }
 
-        Display *display = sX11App.display;
+    FrameBuffer *getFrameBuffer() override
+    {
+        if (mFrameBuffer && (mFrameBuffer->width() != (uint32_t) mWidth || mFrameBuffer->height() != (uint32_t) mHeight)) {
+            // A put still in flight is ordered before the detach, the server finishes reading first
+            delete mFrameBuffer;
+            mFrameBuffer = nullptr;
+            mPresentPending = false;
+        }
+        if (!mFrameBuffer && mWidth > 0 && mHeight > 0) {
+            mFrameBuffer = NX11FrameBuffer::create(mWidth, mHeight);
+        }
+        return mFrameBuffer;
+    }
 
-        XPending(display);
-        XEvent event;
-        while(XCheckWindowEvent(display, mNativeWindow, EVENT_MASK, &event)) {
-            processEvent(&event);
+    bool presentFrameBuffer() override
+    {
+        if (!mFrameBuffer || mPresentPending) {
+            return false;
         }
+        if (!mGc) {
+            // Copies from the front pixmap never need GraphicsExpose/NoExpose events
+            XGCValues values;
+            values.graphics_exposures = False;
+            mGc = XCreateGC(sX11App.display, mNativeWindow, GCGraphicsExposures, &values);
+        }
+        std::vector<FrameBuffer::Rect> rects = mFrameBuffer->dirtyRects();
+        if (rects.empty()) {
+            FrameBuffer::Rect all;
+            all.width = mFrameBuffer->width();
+            all.height = mFrameBuffer->height();
+            rects.push_back(all);
+        }
+        mPresentPending = mFrameBuffer->present(mNativeWindow, mGc, rects);
+        mFrameBuffer->clearDirty();
+        return true;
+    }
 
-        while (XCheckTypedEvent(display, ClientMessage, &event)) {
-            processEvent(&event);
+    bool frame() override
+    {
+        if (mExit) {
+            return false;
         }
 
+        // Events are read once per loop by nativePollEvents and dispatched to the owning window
+
         if (mCursorMode == CursorMode::Disabled) {
             int centerX = (int) mWidth / 2;
             int centerY = (int) mHeight / 2;
@@ -226,20 +378,25 @@ public:
                 mLastMouseY = centerY;
 
                 XWarpPointer(sX11App.display, NoneN, mNativeWindow, 0, 0, 0, 0, centerX, centerY);
-                XFlush(sX11App.display);
+                flushImmediately();
             }
         }
 
-
-//        XFlush(display);
-
         return !mExit;
     }
 
     void destroy() override
     {
+        if (mFrameBuffer) {
+            delete mFrameBuffer;
+            mFrameBuffer = nullptr;
+        }
+        if (mGc) {
+            XFreeGC(sX11App.display, mGc);
+            mGc = nullptr;
+        }
         if (mHiddenCursor) {
-            NCursor::destroyCursor(mHiddenCursor);
+            sCursorCache.release(mHiddenCursor);
             mHiddenCursor = 0;
         }
         if (mIc) {
@@ -247,11 +404,11 @@ public:
             mIc = nullptr;
         }
         if (mNativeWindow) {
+            sX11App.windows.erase(mNativeWindow);
             XUnmapWindow(sX11App.display, mNativeWindow);
             XDestroyWindow(sX11App.display, mNativeWindow);
             mNativeWindow = 0;
         }
-        XFlush(sX11App.display);
     }
 
 public:
@@ -263,7 +420,6 @@ public:
     void setWindowSize(uint32_t w, uint32_t h) override
     {
         XResizeWindow(sX11App.display, mNativeWindow, mWidth = w, mHeight = h);
-        XFlush(sX11App.display);
         mWh->postWindowSizeEvent(w, h);
     }
 
@@ -276,6 +432,7 @@ public:
             long supplied;
             XSizeHints* hints = XAllocSizeHints();
 
+            countRoundTrip();
             if (XGetWMNormalHints(sX11App.display, mNativeWindow, hints, &supplied))
             {
                 hints->flags |= PPosition;
@@ -288,7 +445,6 @@ public:
         }
 
         XMoveWindow(sX11App.display, mNativeWindow, mX = x, mY = y);
-        XFlush(sX11App.display);
     }
 
     void setWindowTitle(const std::string &title) override
@@ -315,11 +471,9 @@ public:
                         (unsigned char *) title.c_str(), strlen(title.c_str()));
 
         XChangeProperty(sX11App.display, mNativeWindow,
-                        sX11App.NET_WMmIcON_NAME, sX11App.UTF8_STRING, 8,
+                        sX11App.NET_WM_ICON_NAME, sX11App.UTF8_STRING, 8,
                         PropModeReplace,
                         (unsigned char *) title.c_str(), strlen(title.c_str()));
-
-        XFlush(sX11App.display);
     }
 
     void setWindowState(WindowState::Enum state) override
@@ -364,15 +518,16 @@ public:
 
     bool isWindowVisible()
     {
-        XWindowAttributes wa;
-        XGetWindowAttributes(sX11App.display, mNativeWindow, &wa);
-        return wa.map_state == IsViewable;
+        // Tracked from MapNotify/UnmapNotify instead of querying the window attributes
+        return mMapped;
     }
 
     void setCursor(const Cursor &cursor) override
     {
+        // Acquire before releasing the current one, switching back and forth reuses the cached handles
+        auto *nCursor = new NCursor(cursor);
         destroyCursor();
-        mCursor = new NCursor(cursor);
+        mCursor = nCursor;
         mCursor->setToCursor(this);
     }
 
@@ -396,8 +551,9 @@ public:
 
             // move cursor to window center
             XWarpPointer(sX11App.display, NoneN, mNativeWindow, 0, 0, 0, 0, mWidth / 2, mHeight / 2);
-            XFlush(sX11App.display);
 
+            // XGrabPointer waits for its reply, which also flushes the warp above
+            countRoundTrip();
             XGrabPointer(sX11App.display, mNativeWindow, True,
                          ButtonPressMask | ButtonReleaseMask | PointerMotionMask,
                          GrabModeAsync, GrabModeAsync,
@@ -420,7 +576,7 @@ public:
 
         XWarpPointer(sX11App.display, NoneN, mNativeWindow,
                      0,0,0,0, (int) x, (int) y);
-        XFlush(sX11App.display);
+        flushImmediately();
     }
 
     void getCursorPosition(int32_t &x, int32_t &y) override
@@ -429,17 +585,9 @@ public:
             x = mVirtualCursorPosX;
             y = mVirtualCursorPosY;
         } else {
-            ::Window root, child;
-            int rootX, rootY, childX, childY;
-            unsigned int mask;
-
-            XQueryPointer(sX11App.display, mNativeWindow,
-                          &root, &child,
-                          &rootX, &rootY, &childX, &childY,
-                          &mask);
-
-            x = childX;
-            y = childY;
+            // Last position reported by the pointer events of this window, no XQueryPointer round trip
+            x = mMouseX;
+            y = mMouseY;
         }
     }
 
@@ -453,16 +601,50 @@ public:
     }
 
 private:
-    void processEvent(XEvent *event)
+    /**
+     * @param filtered  The event was consumed by the input method
+     */
+    void processEvent(XEvent *event, bool filtered)
     {
-        bool filtered = false;
-        if (sX11App.im) {
-            filtered = XFilterEvent(event, NoneN);
+        if (sX11App.shm && event->type == sX11App.shmCompletionEvent) {
+            const auto *completion = reinterpret_cast<const XShmCompletionEvent *>(event);
+            if (mFrameBuffer && completion->shmseg == mFrameBuffer->shmSeg()) {
+                mPresentPending = false;
+            }
+            return;
         }
 
         switch (event->type)
         {
             case Expose:
+            {
+                // Repainted from the last presented frame, the backbuffer may hold a half drawn one
+                if (mFrameBuffer && mGc) {
+                    const XExposeEvent &xexpose = event->xexpose;
+                    FrameBuffer::Rect rect;
+                    rect.x = xexpose.x;
+                    rect.y = xexpose.y;
+                    rect.width = xexpose.width;
+                    rect.height = xexpose.height;
+                    mFrameBuffer->repaint(mNativeWindow, mGc, rect);
+                }
+            }
+                break;
+
+            case MapNotify:
+                mMapped = true;
+                break;
+
+            case UnmapNotify:
+                mMapped = false;
+                break;
+
+            case EnterNotify:
+            case LeaveNotify:
+                if (mCursorMode != CursorMode::Disabled) {
+                    mMouseX = event->xcrossing.x;
+                    mMouseY = event->xcrossing.y;
+                }
                 break;
 
             case ClientMessage:
@@ -470,9 +652,8 @@ private:
 //                    Log("ClientMessage");
                     const Atom protocol = event->xclient.data.l[0];
                     if (protocol != NoneN) {
-                        if (protocol == sX11App.WM_DELETE_WINDOW && sX11App.focusWindow) {
-                            sX11App.focusWindow->mWh->postExitEvent();
-                            sX11App.focusWindow = nullptr;
+                        if (protocol == sX11App.WM_DELETE_WINDOW) {
+                            mWh->postExitEvent();
                         }
                     }
                 }
@@ -503,20 +684,7 @@ private:
                             , event->type == ButtonPress ? KeyAction::Press : KeyAction::Release);
                 }
                 if (xbutton.x != mMouseX || xbutton.y != mMouseY) {
-                    mMouseX = xbutton.x;
-                    mMouseY = xbutton.y;
-
-                    if (mCursorMode == CursorMode::Disabled) {
-                        const int dx = mMouseX - mLastMouseX;
-                        const int dy = mMouseY - mLastMouseY;
-
-                        inputCursorPos(mVirtualCursorPosX + dx, mVirtualCursorPosY + dy);
-                    } else {
-                        inputCursorPos(mMouseX, mMouseY);
-                    }
-
-                    mLastMouseX = mMouseX;
-                    mLastMouseY = mMouseY;
+                    inputMotion(xbutton.x, xbutton.y, true);
                 }
                 if (mouseScrollX != 0 || mouseScrollY != 0) {
                     mAppContext->postMouseScrollEvent(mWh->getWindowId(), mouseScrollX, mouseScrollY);
@@ -527,21 +695,7 @@ private:
             case MotionNotify:
             {
                 const XMotionEvent& xmotion = event->xmotion;
-
-                mMouseX = xmotion.x;
-                mMouseY = xmotion.y;
-
-                if (mCursorMode == CursorMode::Disabled) {
-                    const int dx = mMouseX - mLastMouseX;
-                    const int dy = mMouseY - mLastMouseY;
-
-                    inputCursorPos(mVirtualCursorPosX + dx, mVirtualCursorPosY + dy);
-                } else {
-                    inputCursorPos(mMouseX, mMouseY);
-                }
-
-                mLastMouseX = mMouseX;
-                mLastMouseY = mMouseY;
+                inputMotion(xmotion.x, xmotion.y, true);
             }
                 break;
 
@@ -549,31 +703,31 @@ private:
             case KeyRelease:
             {
                 XKeyEvent& xkey = event->xkey;
-                KeySym keysym = XLookupKeysym(&xkey, 0);
-                switch (keysym)
-                {
-                    case XK_Meta_L:    setModifier(Modifier::LeftMeta,   KeyPress == event->type); break;
-                    case XK_Meta_R:    setModifier(Modifier::RightMeta,  KeyPress == event->type); break;
-                    case XK_Control_L: setModifier(Modifier::LeftCtrl,   KeyPress == event->type); break;
-                    case XK_Control_R: setModifier(Modifier::RightCtrl,  KeyPress == event->type); break;
-                    case XK_Shift_L:   setModifier(Modifier::LeftShift,  KeyPress == event->type); break;
-                    case XK_Shift_R:   setModifier(Modifier::RightShift, KeyPress == event->type); break;
-                    case XK_Alt_L:     setModifier(Modifier::LeftAlt,    KeyPress == event->type); break;
-                    case XK_Alt_R:     setModifier(Modifier::RightAlt,   KeyPress == event->type); break;
+                const uint8_t keycode = xkey.keycode & 0xff;
+                if (KeyRelease == event->type && isAutoRepeatRelease(xkey)) {
+                    // The press that follows is reported as a repeat
+                    break;
+                }
+                const KeyAction::Enum pressAction = mKeyDown[keycode] ? KeyAction::Repeat : KeyAction::Press;
+                mKeyDown[keycode] = KeyPress == event->type;
 
+                const KeycodeEntry &entry = sKeycodeMap[keycode];
+                switch (entry.modifier)
+                {
                     default:
+                        setModifier(entry.modifier, KeyPress == event->type);
+                        break;
+
+                    case Modifier::None:
                     {
-                        Key::Enum key = fromXk(keysym);
+                        Key::Enum key = entry.key;
                         if (KeyPress == event->type)
                         {
-                            if (mLastKeyTime < event->xkey.time) {
-                                if (Key::None != key) {
-                                    mAppContext->postKeyEvent(mWh->getWindowId(), key, mModifiers,KeyAction::Press);
-                                }
-                                mLastKeyTime = event->xkey.time;
+                            if (Key::None != key) {
+                                mAppContext->postKeyEvent(mWh->getWindowId(), key, mModifiers, pressAction);
                             }
 
-                            if (!filtered)
+                            if (mIc && !filtered)
                             {
                                 int count;
                                 Status status;
@@ -643,8 +797,7 @@ private:
                 Log("FocusIn %s", mWh->getWindowTitle().c_str());
 
                 mWh->postWindowFocusChange(true);
-
-                sX11App.focusWindow = this;
+                mFocused = true;
 
                 if (mIc) {
                     XSetICFocus(mIc);
@@ -659,7 +812,11 @@ private:
                 }
                 Log("FocusOut %s", mWh->getWindowTitle().c_str());
 
+                // Releases of keys held while unfocused are not delivered to this window
+                mKeyDown.reset();
+
                 mWh->postWindowFocusChange(false);
+                mFocused = false;
 
                 if (mIc) {
                     XUnsetICFocus(mIc);
@@ -669,33 +826,54 @@ private:
         }
     }
 
-    void inputCursorPos(int32_t x, int32_t y)
+    /**
+     * @param post  false while a run of motion events is being compressed, the position is
+     *              still tracked so the relative delta of CursorMode::Disabled accumulates
+     */
+    void inputMotion(int x, int y, bool post)
+    {
+        mMouseX = x;
+        mMouseY = y;
+
+        if (mCursorMode == CursorMode::Disabled) {
+            const int dx = mMouseX - mLastMouseX;
+            const int dy = mMouseY - mLastMouseY;
+
+            inputCursorPos(mVirtualCursorPosX + dx, mVirtualCursorPosY + dy, post);
+        } else {
+            inputCursorPos(mMouseX, mMouseY, post);
+        }
+
+        mLastMouseX = mMouseX;
+        mLastMouseY = mMouseY;
+    }
+
+    void inputCursorPos(int32_t x, int32_t y, bool post = true)
     {
-        if (mVirtualCursorPosX == x && mVirtualCursorPosY == y)
+        if (mVirtualCursorPosX == x && mVirtualCursorPosY == y && !mMotionPending)
             return;
 
         mVirtualCursorPosX = x;
         mVirtualCursorPosY = y;
 
-        mAppContext->postMouseMoveEvent(mWh->getWindowId(), x, y);
+        if (post) {
+            mAppContext->postMouseMoveEvent(mWh->getWindowId(), x, y);
+        }
+        mMotionPending = !post;
     }
 
     void maximizedWindow(bool maximized)
     {
-        Atom wmState = XInternAtom(sX11App.display, "_NET_WM_STATE", false);
-        Atom wmVMaximizedState = XInternAtom(sX11App.display, "_NET_WM_STATE_MAXIMIZED_VERT", false);
-        Atom wmHMaximizedState = XInternAtom(sX11App.display, "_NET_WM_STATE_MAXIMIZED_HORZ", false);
-
         XEvent xev;
         memset(&xev, 0, sizeof(xev));
         xev.xclient.type = ClientMessage;
         xev.xclient.display = sX11App.display;
         xev.xclient.window = mNativeWindow;
-        xev.xclient.message_type = wmState;
+        xev.xclient.message_type = sX11App.NET_WM_STATE;
         xev.xclient.format = 32;
         xev.xclient.data.l[0] = maximized;
-        xev.xclient.data.l[1] = wmVMaximizedState;
-        xev.xclient.data.l[2] = wmHMaximizedState;
+        xev.xclient.data.l[1] = sX11App.NET_WM_STATE_MAXIMIZED_VERT;
+        xev.xclient.data.l[2] = sX11App.NET_WM_STATE_MAXIMIZED_HORZ;
         xev.xclient.data.l[3] = 1;
 
         XSendEvent(sX11App.display,
@@ -703,23 +881,19 @@ private:
                    false,
                    SubstructureRedirectMask | SubstructureNotifyMask,
                    &xev);
-        XFlush(sX11App.display);
     }
 
     void minimizedWindow(bool minimized)
     {
-        Atom wmState = XInternAtom(sX11App.display, "_NET_WM_STATE", false);
-        Atom wmHiddenState = XInternAtom(sX11App.display, "_NET_WM_STATE_HIDDEN", false);
-
         XEvent xev;
         memset(&xev, 0, sizeof(xev));
         xev.xclient.type = ClientMessage;
         xev.xclient.display = sX11App.display;
         xev.xclient.window = mNativeWindow;
-        xev.xclient.message_type = wmState;
+        xev.xclient.message_type = sX11App.NET_WM_STATE;
         xev.xclient.format = 32;
         xev.xclient.data.l[0] = minimized;
-        xev.xclient.data.l[1] = wmHiddenState;
+        xev.xclient.data.l[1] = sX11App.NET_WM_STATE_HIDDEN;
         xev.xclient.data.l[2] = 0;
         xev.xclient.data.l[3] = 1;
 
@@ -730,23 +904,19 @@ private:
                    &xev
         );
         XIconifyWindow(sX11App.display, mNativeWindow, sX11App.screen);
-        XFlush(sX11App.display);
     }
 
     void fullScreen(bool fullScreen)
     {
-        Atom wmState = XInternAtom(sX11App.display, "_NET_WM_STATE", false);
-        Atom wmfullscreenState = XInternAtom(sX11App.display, "_NET_WM_STATE_FULLSCREEN", false);
-
         XEvent xev;
         memset(&xev, 0, sizeof(xev));
         xev.xclient.type = ClientMessage;
         xev.xclient.display = sX11App.display;
         xev.xclient.window = mNativeWindow;
-        xev.xclient.message_type = wmState;
+        xev.xclient.message_type = sX11App.NET_WM_STATE;
         xev.xclient.format = 32;
         xev.xclient.data.l[0] = fullScreen;
-        xev.xclient.data.l[1] = wmfullscreenState;
+        xev.xclient.data.l[1] = sX11App.NET_WM_STATE_FULLSCREEN;
         xev.xclient.data.l[2] = 0;
         xev.xclient.data.l[3] = 1;
 
@@ -756,7 +926,6 @@ private:
                    SubstructureRedirectMask | SubstructureNotifyMask,
                    &xev
         );
-        XFlush(sX11App.display);
     }
 
 private:
@@ -769,31 +938,47 @@ private:
         wh->setPlatformData(pd);
     }
 
+    /**
+     * Without detectable auto-repeat the server sends a Release/Press pair with the same timestamp
+     * for every repeat of a held key, the release of such a pair is recognised by peeking the queue
+     */
+    static bool isAutoRepeatRelease(const XKeyEvent &xkey)
+    {
+        if (sX11App.detectableAutoRepeat || XQLength(sX11App.display) == 0) {
+            return false;
+        }
+        XEvent next;
+        XPeekEvent(sX11App.display, &next);
+        return next.type == KeyPress &&
+               next.xkey.window == xkey.window &&
+               next.xkey.keycode == xkey.keycode &&
+               next.xkey.time == xkey.time;
+    }
+
     void setModifier(Modifier::Enum modifier, bool set)
     {
         mModifiers &= ~modifier;
         mModifiers |= set ? modifier : 0;
     }
 
-    static Key::Enum fromXk(uint16_t xk)
-    {
-        xk += 256;
-        return 512 > xk ? (Key::Enum)sTranslateKey[xk] : Key::None;
-    }
 
 private:
     friend class NCursor;
 
+    friend void nativePollEvents();
+
     AppContext *mAppContext = nullptr;
     WindowHandle *mWh = nullptr;
 
     ::Window mNativeWindow = 0;
     XIC mIc = nullptr;
+    bool mFocused = false;
 
     uint8_t mModifiers = 0;
     int mMouseX = 0;
     int mMouseY = 0;
-    ::Time mLastKeyTime = 0;
+    std::bitset<256> mKeyDown;
+    bool mMapped = false;
 
     int mX = 0;
     int mY = 0;
@@ -806,29 +991,197 @@ private:
     NCursor *mCursor = nullptr;
     int32_t mLastMouseX = 0, mLastMouseY = 0;
     int32_t mVirtualCursorPosX = 0, mVirtualCursorPosY = 0;
+    bool mMotionPending = false;
     int32_t mRestoreCursorPosX = 0, mRestoreCursorPosY = 0;
 
     ::Cursor mHiddenCursor = 0;
+
+    NX11FrameBuffer *mFrameBuffer = nullptr;
+    GC mGc = nullptr;
+    bool mPresentPending = false;
 };
 
 
-NCursor::NCursor(const Cursor &cursor)
+static bool sShmAttachFailed = false;
+
+static int shmAttachErrorHandler(Display *display, XErrorEvent *event)
 {
-    switch (cursor.getCursorStyle()) {
-        case Cursor::System: {
-            createShapeCursor(cursor.getCursorShape());
+    GX_UNUSED(display);
+    GX_UNUSED(event);
+    sShmAttachFailed = true;
+    return 0;
+}
+
+NX11FrameBuffer *NX11FrameBuffer::create(uint32_t width, uint32_t height)
+{
+    Visual *visual = sX11App.visual;
+    if (visual->c_class != TrueColor || (sX11App.depth != 24 && sX11App.depth != 32)) {
+        Log("X11: no framebuffer for a visual of depth %d", sX11App.depth);
+        return nullptr;
+    }
+    PixelFormat::Enum format;
+    const bool lsbFirst = ImageByteOrder(sX11App.display) == LSBFirst;
+    // Only byte orders that match Bgra or Rgba in memory, MSBFirst 0xff0000 red would be X,R,G,B
+    if (visual->red_mask == 0xff0000 && visual->green_mask == 0xff00 && visual->blue_mask == 0xff && lsbFirst) {
+        format = PixelFormat::Bgra;
+    } else if (visual->red_mask == 0xff && visual->green_mask == 0xff00 && visual->blue_mask == 0xff0000 && lsbFirst) {
+        format = PixelFormat::Rgba;
+    } else {
+        Log("X11: no framebuffer for the visual channel masks");
+        return nullptr;
+    }
+
+    XShmSegmentInfo shmInfo;
+    memset(&shmInfo, 0, sizeof(shmInfo));
+    if (sX11App.shm) {
+        XImage *image = createShmImage(width, height, shmInfo);
+        if (image) {
+            return new NX11FrameBuffer(image, shmInfo, true, format);
         }
-            break;
-        case Cursor::Custom: {
-            createCustomCursor(cursor.getBitmap(), cursor.getHotX(), cursor.getHotY());
+    }
+
+    // Fallback, every present copies the pixels through the connection
+    XImage *image = XCreateImage(sX11App.display, visual, sX11App.depth, ZPixmap, 0, nullptr,
+                                 width, height, 32, 0);
+    if (!image) {
+        return nullptr;
+    }
+    image->data = (char *) calloc((size_t) image->bytes_per_line * height, 1);
+    if (!image->data) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+    return new NX11FrameBuffer(image, shmInfo, false, format);
+}
+
+XImage *NX11FrameBuffer::createShmImage(uint32_t width, uint32_t height, XShmSegmentInfo &shmInfo)
+{
+    XImage *image = XShmCreateImage(sX11App.display, sX11App.visual, sX11App.depth, ZPixmap, nullptr, &shmInfo,
+                                    width, height);
+    if (!image) {
+        return nullptr;
+    }
+    shmInfo.shmid = shmget(IPC_PRIVATE, (size_t) image->bytes_per_line * image->height, IPC_CREAT | 0600);
+    if (shmInfo.shmid < 0) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+    shmInfo.shmaddr = (char *) shmat(shmInfo.shmid, nullptr, 0);
+    if (shmInfo.shmaddr == (char *) -1) {
+        shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+        XDestroyImage(image);
+        return nullptr;
+    }
+    image->data = shmInfo.shmaddr;
+    shmInfo.readOnly = False;
+
+    // Attaching fails asynchronously when the server cannot map the segment, wait for the outcome once
+    sShmAttachFailed = false;
+    XErrorHandler oldHandler = XSetErrorHandler(shmAttachErrorHandler);
+    XShmAttach(sX11App.display, &shmInfo);
+    countRoundTrip();
+    XSync(sX11App.display, False);
+    XSetErrorHandler(oldHandler);
+
+    // The segment is released once both sides have detached
+    shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+
+    if (sShmAttachFailed) {
+        Log("X11: MIT-SHM attach failed, falling back to XPutImage");
+        sX11App.shm = false;
+        image->data = nullptr;
+        XDestroyImage(image);
+        shmdt(shmInfo.shmaddr);
+        return nullptr;
+    }
+    return image;
+}
+
+NX11FrameBuffer::NX11FrameBuffer(XImage *image, const XShmSegmentInfo &shmInfo, bool shm, PixelFormat::Enum format)
+        : FrameBuffer(image->width, image->height, image->bytes_per_line, format, (unsigned char *) image->data),
+          mImage(image),
+          mShmInfo(shmInfo),
+          mShm(shm)
+{
+}
+
+NX11FrameBuffer::~NX11FrameBuffer()
+{
+    if (mFront) {
+        XFreePixmap(sX11App.display, mFront);
+    }
+    if (mShm) {
+        XShmDetach(sX11App.display, &mShmInfo);
+        mImage->data = nullptr;
+        XDestroyImage(mImage);
+        shmdt(mShmInfo.shmaddr);
+    } else {
+        // Frees the pixels as well
+        XDestroyImage(mImage);
+    }
+}
+
+bool NX11FrameBuffer::clip(const Rect &rect, Rect &clipped) const
+{
+    const int64_t x0 = std::max(rect.x, 0);
+    const int64_t y0 = std::max(rect.y, 0);
+    const int64_t x1 = std::min<int64_t>((int64_t) rect.x + rect.width, mImage->width);
+    const int64_t y1 = std::min<int64_t>((int64_t) rect.y + rect.height, mImage->height);
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    clipped.x = (int32_t) x0;
+    clipped.y = (int32_t) y0;
+    clipped.width = (uint32_t) (x1 - x0);
+    clipped.height = (uint32_t) (y1 - y0);
+    return true;
+}
+
+bool NX11FrameBuffer::present(::Window window, GC gc, const std::vector<Rect> &rects)
+{
+    if (!mFront) {
+        mFront = XCreatePixmap(sX11App.display, window, mImage->width, mImage->height, sX11App.depth);
+    }
+    std::vector<Rect> clipped;
+    clipped.reserve(rects.size());
+    for (const Rect &rect : rects) {
+        Rect r;
+        if (clip(rect, r)) {
+            clipped.push_back(r);
         }
-            break;
+    }
+    for (size_t i = 0; i < clipped.size(); i++) {
+        const Rect &r = clipped[i];
+        // Requests complete in order, the completion of the last put covers the previous ones
+        if (mShm) {
+            XShmPutImage(sX11App.display, mFront, gc, mImage, r.x, r.y, r.x, r.y, r.width, r.height,
+                         i + 1 == clipped.size());
+        } else {
+            XPutImage(sX11App.display, mFront, gc, mImage, r.x, r.y, r.x, r.y, r.width, r.height);
+        }
+        XCopyArea(sX11App.display, mFront, window, gc, r.x, r.y, r.width, r.height, r.x, r.y);
+        sX11App.frameStats.uploadedBytes += (uint64_t) r.width * r.height * pixelBytes();
+    }
+    return mShm && !clipped.empty();
+}
+
+void NX11FrameBuffer::repaint(::Window window, GC gc, const Rect &rect) const
+{
+    Rect r;
+    if (mFront && clip(rect, r)) {
+        XCopyArea(sX11App.display, mFront, window, gc, r.x, r.y, r.width, r.height, r.x, r.y);
     }
 }
 
+
+NCursor::NCursor(const Cursor &cursor)
+        : mCursor(sCursorCache.acquire(cursor))
+{
+}
+
 NCursor::~NCursor()
 {
-    destroyCursor(mCursor);
+    sCursorCache.release(mCursor);
 }
 
 void NCursor::setToCursor(NX11Window *window)
@@ -848,7 +1201,6 @@ void NCursor::updateCursorImage(NX11Window *window)
     } else {
         XDefineCursor(sX11App.display, window->mNativeWindow, window->mHiddenCursor);
     }
-    XFlush(sX11App.display);
 }
 
 bool NCursor::cursorInContentArea(NX11Window *window)
@@ -856,7 +1208,18 @@ bool NCursor::cursorInContentArea(NX11Window *window)
     return true;
 }
 
-void NCursor::createShapeCursor(Cursor::CursorShape shape)
+::Cursor NCursor::createNativeCursor(const Cursor &cursor)
+{
+    switch (cursor.getCursorStyle()) {
+        case Cursor::System:
+            return createShapeCursor(cursor.getCursorShape());
+        case Cursor::Custom:
+            return createCursor(cursor.getBitmap(), cursor.getHotX(), cursor.getHotY());
+    }
+    return NoneN;
+}
+
+::Cursor NCursor::createShapeCursor(Cursor::CursorShape shape)
 {
     int id;
     switch (shape) {
@@ -881,12 +1244,7 @@ void NCursor::createShapeCursor(Cursor::CursorShape shape)
             break;
     }
 
-    mCursor = XCreateFontCursor(sX11App.display, id);
-}
-
-void NCursor::createCustomCursor(const CursorBitmap &bitmap, int32_t hotX, int32_t hotY)
-{
-    mCursor = createCursor(bitmap, hotX, hotY);
+    return XCreateFontCursor(sX11App.display, id);
 }
 
 ::Cursor NCursor::createCursor(const CursorBitmap &bitmap, int hotX, int hotY)
@@ -900,18 +1258,14 @@ void NCursor::createCustomCursor(const CursorBitmap &bitmap, int32_t hotX, int32
     native->xhot = hotX;
     native->yhot = hotY;
 
-    const unsigned char* source = bitmap.data();
-    XcursorPixel* target = native->pixels;
-
-    for (int i = 0;  i < bitmap.width() * bitmap.height();  i++, target++, source += 4)
-    {
-        unsigned int alpha = source[3];
-
-        *target = (alpha << 24) |
-                  ((unsigned char) ((source[0] * alpha) / 255) << 16) |
-                  ((unsigned char) ((source[1] * alpha) / 255) <<  8) |
-                  ((unsigned char) ((source[2] * alpha) / 255) <<  0);
+    // XcursorPixel is a host order 0xAARRGGBB, laid out as B, G, R, A on little endian hosts
+    const uint64_t count = (uint64_t) bitmap.width() * bitmap.height();
+    PixelConvert::premultiplyToBgra((const Rgba *) bitmap.data(), (Bgra *) native->pixels, count);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (uint64_t i = 0; i < count; i++) {
+        native->pixels[i] = __builtin_bswap32(native->pixels[i]);
     }
+#endif
 
     cursor = XcursorImageLoadCursor(sX11App.display, native);
     XcursorImageDestroy(native);
@@ -948,24 +1302,172 @@ int nativeInit(AppContext *appCtx)
 
     sX11App.im = XOpenIM(sX11App.display, 0, NULL, NULL);
 
-    sX11App.UTF8_STRING = XInternAtom(sX11App.display, "UTF8_STRING", False);
+    // Intern every atom in a single round trip
+    char *atomNames[] = {
+            (char *) "UTF8_STRING",
+            (char *) "_NET_WM_NAME",
+            (char *) "_NET_WM_ICON_NAME",
+            (char *) "WM_DELETE_WINDOW",
+            (char *) "_GXX_WAKEUP",
+            (char *) "_NET_WM_STATE",
+            (char *) "_NET_WM_STATE_MAXIMIZED_VERT",
+            (char *) "_NET_WM_STATE_MAXIMIZED_HORZ",
+            (char *) "_NET_WM_STATE_HIDDEN",
+            (char *) "_NET_WM_STATE_FULLSCREEN",
+    };
+    Atom atoms[ARRAY_LEN(atomNames)];
+    XInternAtoms(sX11App.display, atomNames, ARRAY_LEN(atomNames), False, atoms);
+
+    sX11App.UTF8_STRING = atoms[0];
+    sX11App.NET_WM_NAME = atoms[1];
+    sX11App.NET_WM_ICON_NAME = atoms[2];
+    sX11App.WM_DELETE_WINDOW = atoms[3];
+    sX11App.GXX_WAKEUP = atoms[4];
+    sX11App.NET_WM_STATE = atoms[5];
+    sX11App.NET_WM_STATE_MAXIMIZED_VERT = atoms[6];
+    sX11App.NET_WM_STATE_MAXIMIZED_HORZ = atoms[7];
+    sX11App.NET_WM_STATE_HIDDEN = atoms[8];
+    sX11App.NET_WM_STATE_FULLSCREEN = atoms[9];
+
+    sX11App.wakeupWindow = XCreateWindow(sX11App.display, sX11App.root,
+                                         0, 0, 1, 1, 0,
+                                         0, InputOnly, CopyFromParent,
+                                         0, nullptr);
+
+    int xkbOpcode, xkbErrorBase;
+    int xkbMajor = XkbMajorVersion, xkbMinor = XkbMinorVersion;
+    sX11App.xkb = XkbQueryExtension(sX11App.display, &xkbOpcode, &sX11App.xkbEventBase, &xkbErrorBase,
+                                    &xkbMajor, &xkbMinor);
+    if (sX11App.xkb) {
+        Bool supported = False;
+        XkbSetDetectableAutoRepeat(sX11App.display, True, &supported);
+        sX11App.detectableAutoRepeat = supported;
+
+        XkbSelectEvents(sX11App.display, XkbUseCoreKbd,
+                        XkbNewKeyboardNotifyMask | XkbMapNotifyMask,
+                        XkbNewKeyboardNotifyMask | XkbMapNotifyMask);
+        XkbSelectEventDetails(sX11App.display, XkbUseCoreKbd, XkbStateNotify,
+                              XkbGroupStateMask, XkbGroupStateMask);
+
+        XkbStateRec state;
+        if (XkbGetState(sX11App.display, XkbUseCoreKbd, &state) == Success) {
+            sX11App.xkbGroup = state.group;
+        }
+    }
+    buildKeycodeMap();
 
-    sX11App.NET_WM_NAME = XInternAtom(sX11App.display, "_NET_WM_NAME", False);
-    sX11App.NET_WMmIcON_NAME = XInternAtom(sX11App.display, "_NET_WMmIcON_NAME", False);
-    sX11App.WM_DELETE_WINDOW = XInternAtom(sX11App.display, "WM_DELETE_WINDOW", False);
+    if (XShmQueryExtension(sX11App.display)) {
+        sX11App.shm = true;
+        sX11App.shmCompletionEvent = XShmGetEventBase(sX11App.display) + ShmCompletion;
+    }
 
-    initStatic();
     return 0;
 }
 
 int nativeTerminate(AppContext *appCtx)
 {
     if (sX11App.display) {
+        sCursorCache.clear();
+        if (sX11App.wakeupWindow) {
+            XDestroyWindow(sX11App.display, sX11App.wakeupWindow);
+            sX11App.wakeupWindow = 0;
+        }
         XCloseDisplay(sX11App.display);
     }
     return EXIT_SUCCESS;
 }
 
+void nativeWakeup()
+{
+    if (!sX11App.display || !sX11App.wakeupWindow) {
+        return;
+    }
+    // Safe from any thread, XInitThreads is called in nativeInit
+    XEvent event;
+    memset(&event, 0, sizeof(event));
+    event.xclient.type = ClientMessage;
+    event.xclient.window = sX11App.wakeupWindow;
+    event.xclient.message_type = sX11App.GXX_WAKEUP;
+    event.xclient.format = 32;
+
+    XSendEvent(sX11App.display, sX11App.wakeupWindow, False, 0, &event);
+    XFlush(sX11App.display);
+}
+
+void nativePollEvents()
+{
+    Display *display = sX11App.display;
+    if (!display) {
+        return;
+    }
+
+    // Read the connection once, then drain the local queue without further I/O.
+    // Unlike XPending, QueuedAfterReading does not flush the output buffer, that is left to nativeFlush
+    XEventsQueued(display, QueuedAfterReading);
+    while (XQLength(display) > 0) {
+        XEvent event;
+        XNextEvent(display, &event);
+
+        // Keyboard mapping changes are global, they are not addressed to a window
+        if (sX11App.xkb && event.type == sX11App.xkbEventBase) {
+            handleXkbEvent(event);
+            continue;
+        }
+        if (event.type == MappingNotify) {
+            if (event.xmapping.request == MappingKeyboard) {
+                XRefreshKeyboardMapping(&event.xmapping);
+                if (!sX11App.xkb) {
+                    buildKeycodeMap();
+                }
+            }
+            continue;
+        }
+
+        auto it = sX11App.windows.find(event.xany.window);
+        if (it == sX11App.windows.end()) {
+            // Events of the input method's own windows
+            if (sX11App.im) {
+                XFilterEvent(&event, NoneN);
+            }
+            continue;
+        }
+        NX11Window *window = it->second;
+
+        // Only windows with text input have an input context, the others skip IM filtering
+        const bool filtered = window->mIc && XFilterEvent(&event, NoneN);
+
+        // Collapse a run of queued motion events of the same window to the last one
+        if (event.type == MotionNotify && window->mWh->isMotionCompression() && XQLength(display) > 0) {
+            XEvent next;
+            XPeekEvent(display, &next);
+            if (next.type == MotionNotify && next.xany.window == event.xany.window) {
+                window->inputMotion(event.xmotion.x, event.xmotion.y, false);
+                sX11App.frameStats.compressedMotions++;
+                continue;
+            }
+        }
+        window->processEvent(&event, filtered);
+    }
+}
+
+void nativeFlush()
+{
+    // The only regular flush of the frame, all requests issued since the last one are written together
+    if (sX11App.display) {
+        XFlush(sX11App.display);
+        sX11App.frameStats.flushes++;
+    }
+
+    // Read through AppContext::nativeFrameStats(), logging here would cost a write on every frame
+    sX11App.lastFrameStats = sX11App.frameStats;
+    sX11App.frameStats = {};
+}
+
+NativeFrameStats nativeGetFrameStats()
+{
+    return sX11App.lastFrameStats;
+}
+
 bool nativeDeviceSupport(DeviceType::Enum type)
 {
     switch (type) {
@@ -979,13 +1481,6 @@ bool nativeDeviceSupport(DeviceType::Enum type)
     }
 }
 
-static void initTranslateKey(uint16_t xk, Key::Enum key)
-{
-    xk += 256;
-    assert(xk < ARRAY_LEN(sTranslateKey));
-    sTranslateKey[xk&0x1ff] = (uint8_t)key;
-}
-
 std::vector<GamepadStateInfo> nativeGetConnectedGamepadStateInfos()
 {
     return {};
@@ -1000,94 +1495,81 @@ void nativeGetDesktopSize(uint32_t &w, uint32_t &h)
 }
 
 
-static void initStatic()
+
+static void setKeycodeEntry(int keycode, KeySym base, KeySym shifted)
+{
+    if (keycode < 0 || keycode >= (int) ARRAY_LEN(sKeycodeMap)) {
+        return;
+    }
+    sKeycodeMap[keycode] = x11KeycodeEntry(base, shifted);
+}
+
+static void buildKeycodeMap()
+{
+    memset(sKeycodeMap, 0, sizeof(sKeycodeMap));
+
+    if (sX11App.xkb) {
+        countRoundTrip();
+        // XkbKeyGroupWidth reads the key types, they come in the same reply as the symbols
+        XkbDescPtr desc = XkbGetMap(sX11App.display, XkbKeyTypesMask | XkbKeySymsMask, XkbUseCoreKbd);
+        if (desc && desc->map && desc->map->types) {
+            for (int keycode = desc->min_key_code; keycode <= desc->max_key_code; keycode++) {
+                const int groups = XkbKeyNumGroups(desc, keycode);
+                if (groups == 0) {
+                    continue;
+                }
+                const int group = sX11App.xkbGroup < groups ? sX11App.xkbGroup : 0;
+                const int width = XkbKeyGroupWidth(desc, keycode, group);
+
+                setKeycodeEntry(keycode,
+                                width > 0 ? XkbKeySymEntry(desc, keycode, 0, group) : NoSymbol,
+                                width > 1 ? XkbKeySymEntry(desc, keycode, 1, group) : NoSymbol);
+            }
+            XkbFreeKeyboard(desc, 0, True);
+            return;
+        }
+        if (desc) {
+            XkbFreeKeyboard(desc, 0, True);
+        }
+    }
+
+    // Core keymap, used without XKB
+    int minKeycode, maxKeycode, symsPerKeycode;
+    XDisplayKeycodes(sX11App.display, &minKeycode, &maxKeycode);
+
+    countRoundTrip();
+    KeySym *syms = XGetKeyboardMapping(sX11App.display, (KeyCode) minKeycode, maxKeycode - minKeycode + 1,
+                                       &symsPerKeycode);
+    if (!syms) {
+        return;
+    }
+    for (int keycode = minKeycode; keycode <= maxKeycode; keycode++) {
+        const KeySym *keySyms = syms + (keycode - minKeycode) * symsPerKeycode;
+        setKeycodeEntry(keycode,
+                        symsPerKeycode > 0 ? keySyms[0] : NoSymbol,
+                        symsPerKeycode > 1 ? keySyms[1] : NoSymbol);
+    }
+    XFree(syms);
+}
+
+static void handleXkbEvent(const XEvent &event)
 {
-    memset(sTranslateKey, 0, sizeof(sTranslateKey));
-    initTranslateKey(XK_Escape,       Key::Esc);
-    initTranslateKey(XK_Return,       Key::Return);
-    initTranslateKey(XK_Tab,          Key::Tab);
-    initTranslateKey(XK_BackSpace,    Key::Backspace);
-    initTranslateKey(XK_space,        Key::Space);
-    initTranslateKey(XK_Up,           Key::Up);
-    initTranslateKey(XK_Down,         Key::Down);
-    initTranslateKey(XK_Left,         Key::Left);
-    initTranslateKey(XK_Right,        Key::Right);
-    initTranslateKey(XK_Insert,       Key::Insert);
-    initTranslateKey(XK_Delete,       Key::Delete);
-    initTranslateKey(XK_Home,         Key::Home);
-    initTranslateKey(XK_KP_End,       Key::End);
-    initTranslateKey(XK_Page_Up,      Key::PageUp);
-    initTranslateKey(XK_Page_Down,    Key::PageDown);
-    initTranslateKey(XK_Print,        Key::Print);
-    initTranslateKey(XK_equal,        Key::Plus);
-    initTranslateKey(XK_minus,        Key::Minus);
-    initTranslateKey(XK_bracketleft,  Key::LeftBracket);
-    initTranslateKey(XK_bracketright, Key::RightBracket);
-    initTranslateKey(XK_semicolon,    Key::Semicolon);
-    initTranslateKey(XK_apostrophe,   Key::Quote);
-    initTranslateKey(XK_comma,        Key::Comma);
-    initTranslateKey(XK_period,       Key::Period);
-    initTranslateKey(XK_slash,        Key::Slash);
-    initTranslateKey(XK_backslash,    Key::Backslash);
-    initTranslateKey(XK_grave,        Key::Tilde);
-    initTranslateKey(XK_F1,           Key::F1);
-    initTranslateKey(XK_F2,           Key::F2);
-    initTranslateKey(XK_F3,           Key::F3);
-    initTranslateKey(XK_F4,           Key::F4);
-    initTranslateKey(XK_F5,           Key::F5);
-    initTranslateKey(XK_F6,           Key::F6);
-    initTranslateKey(XK_F7,           Key::F7);
-    initTranslateKey(XK_F8,           Key::F8);
-    initTranslateKey(XK_F9,           Key::F9);
-    initTranslateKey(XK_F10,          Key::F10);
-    initTranslateKey(XK_F11,          Key::F11);
-    initTranslateKey(XK_F12,          Key::F12);
-    initTranslateKey(XK_KP_Insert,    Key::NumPad0);
-    initTranslateKey(XK_KP_End,       Key::NumPad1);
-    initTranslateKey(XK_KP_Down,      Key::NumPad2);
-    initTranslateKey(XK_KP_Page_Down, Key::NumPad3);
-    initTranslateKey(XK_KP_Left,      Key::NumPad4);
-    initTranslateKey(XK_KP_Begin,     Key::NumPad5);
-    initTranslateKey(XK_KP_Right,     Key::NumPad6);
-    initTranslateKey(XK_KP_Home,      Key::NumPad7);
-    initTranslateKey(XK_KP_Up,        Key::NumPad8);
-    initTranslateKey(XK_KP_Page_Up,   Key::NumPad9);
-    initTranslateKey('0',             Key::Key0);
-    initTranslateKey('1',             Key::Key1);
-    initTranslateKey('2',             Key::Key2);
-    initTranslateKey('3',             Key::Key3);
-    initTranslateKey('4',             Key::Key4);
-    initTranslateKey('5',             Key::Key5);
-    initTranslateKey('6',             Key::Key6);
-    initTranslateKey('7',             Key::Key7);
-    initTranslateKey('8',             Key::Key8);
-    initTranslateKey('9',             Key::Key9);
-    initTranslateKey('a',             Key::KeyA);
-    initTranslateKey('b',             Key::KeyB);
-    initTranslateKey('c',             Key::KeyC);
-    initTranslateKey('d',             Key::KeyD);
-    initTranslateKey('e',             Key::KeyE);
-    initTranslateKey('f',             Key::KeyF);
-    initTranslateKey('g',             Key::KeyG);
-    initTranslateKey('h',             Key::KeyH);
-    initTranslateKey('i',             Key::KeyI);
-    initTranslateKey('j',             Key::KeyJ);
-    initTranslateKey('k',             Key::KeyK);
-    initTranslateKey('l',             Key::KeyL);
-    initTranslateKey('m',             Key::KeyM);
-    initTranslateKey('n',             Key::KeyN);
-    initTranslateKey('o',             Key::KeyO);
-    initTranslateKey('p',             Key::KeyP);
-    initTranslateKey('q',             Key::KeyQ);
-    initTranslateKey('r',             Key::KeyR);
-    initTranslateKey('s',             Key::KeyS);
-    initTranslateKey('t',             Key::KeyT);
-    initTranslateKey('u',             Key::KeyU);
-    initTranslateKey('v',             Key::KeyV);
-    initTranslateKey('w',             Key::KeyW);
-    initTranslateKey('x',             Key::KeyX);
-    initTranslateKey('y',             Key::KeyY);
-    initTranslateKey('z',             Key::KeyZ);
+    const auto &xkbEvent = reinterpret_cast<const XkbEvent &>(event);
+    switch (xkbEvent.any.xkb_type) {
+        case XkbNewKeyboardNotify:
+        case XkbMapNotify:
+            buildKeycodeMap();
+            break;
+        case XkbStateNotify:
+            // Switching the layout changes the active group, not the keymap
+            if (xkbEvent.state.group != sX11App.xkbGroup) {
+                sX11App.xkbGroup = xkbEvent.state.group;
+                buildKeycodeMap();
+            }
+            break;
+        default:
+            break;
+    }
 }
 
 static unsigned int decodeUTF8(const char** s)
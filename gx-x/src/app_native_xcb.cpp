@@ -0,0 +1,1626 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/app_native.h"
+
+#if ENTRY_CONFIG_USE_NATIVE && GXX_USE_XCB && (GX_PLATFORM_BSD || GX_PLATFORM_LINUX || GX_PLATFORM_RPI)
+
+#include "gxx/app_entry.h"
+#include "gxx/framebuffer.h"
+#include "gxx/pixelconvert.h"
+
+#include "x11_keysym.h"
+#include "native_cursor_cache.h"
+#include <X11/cursorfont.h>
+
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+#include <xcb/shm.h>
+#include <xcb/render.h>
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+#include <gx/debug.h>
+
+
+using namespace gx;
+
+namespace gxx
+{
+
+class NXcbWindow;
+
+struct XcbGlobal
+{
+    xcb_connection_t *connection = nullptr;
+    xcb_screen_t *screen = nullptr;
+    // Set once the connection has failed, nothing can be read or sent after that
+    bool connectionBroken = false;
+
+    // Owner of each native window, used to dispatch the events of the shared pump
+    std::unordered_map<xcb_window_t, NXcbWindow *> windows;
+
+    // Target of the wakeup messages sent by nativeWakeup
+    xcb_window_t wakeupWindow = 0;
+
+    // Interned once in nativeInit, all requests are sent before the first reply is read
+    xcb_atom_t UTF8_STRING = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_NAME = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_ICON_NAME = XCB_ATOM_NONE;
+    xcb_atom_t WM_PROTOCOLS = XCB_ATOM_NONE;
+    xcb_atom_t WM_DELETE_WINDOW = XCB_ATOM_NONE;
+    xcb_atom_t WM_CHANGE_STATE = XCB_ATOM_NONE;
+    xcb_atom_t GXX_WAKEUP = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_STATE = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_STATE_MAXIMIZED_VERT = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_STATE_MAXIMIZED_HORZ = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_STATE_HIDDEN = XCB_ATOM_NONE;
+    xcb_atom_t NET_WM_STATE_FULLSCREEN = XCB_ATOM_NONE;
+    xcb_atom_t MOTIF_WM_HINTS = XCB_ATOM_NONE;
+
+    // Core keymap, requested asynchronously and read when the first key event needs it
+    bool keymapPending = false;
+    xcb_get_keyboard_mapping_cookie_t keymapCookie{};
+    std::vector<xcb_keysym_t> keysyms;
+    uint8_t keysymsPerKeycode = 0;
+    KeycodeEntry keycodeMap[256]{};
+
+    // MIT-SHM, cleared when attaching a segment fails (e.g. the server is remote)
+    bool shm = false;
+    uint8_t shmCompletionEvent = 0;
+
+    // RENDER, used for ARGB cursors, the picture formats are read on the first custom cursor
+    bool render = false;
+    bool renderFormatsPending = false;
+    xcb_render_query_pict_formats_cookie_t renderFormatsCookie{};
+    xcb_render_pictformat_t argbFormat = 0;
+
+    xcb_font_t cursorFont = 0;
+    uint32_t maxRequestBytes = 0;
+
+    // Counters of the current frame and of the last completed one
+    NativeFrameStats frameStats;
+    NativeFrameStats lastFrameStats;
+};
+
+static XcbGlobal sXcbApp{};
+
+static const uint32_t EVENT_MASK = XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_KEY_PRESS |
+                                   XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_POINTER_MOTION |
+                                   XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE |
+                                   XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_FOCUS_CHANGE |
+                                   XCB_EVENT_MASK_VISIBILITY_CHANGE | XCB_EVENT_MASK_ENTER_WINDOW |
+                                   XCB_EVENT_MASK_LEAVE_WINDOW | XCB_EVENT_MASK_PROPERTY_CHANGE;
+
+/**
+ * Every request whose reply is waited for must be counted here
+ */
+static inline void countRoundTrip()
+{
+    sXcbApp.frameStats.roundTrips++;
+}
+
+/**
+ * Requests are buffered by XCB and written once per frame by nativeFlush.
+ * Call this only for requests whose latency matters, such as pointer warps.
+ */
+static inline void flushImmediately()
+{
+    xcb_flush(sXcbApp.connection);
+    sXcbApp.frameStats.flushes++;
+}
+
+static void requestKeymap();
+
+static const KeycodeEntry &keycodeEntry(xcb_keycode_t keycode);
+
+static xcb_keysym_t keysymOf(xcb_keycode_t keycode, uint32_t level);
+
+static void encodeUTF8(uint32_t codepoint, std::string &out);
+
+
+/**
+ * Window backbuffer in a SysV shared memory segment attached to the server,
+ * or in client memory sent with PutImage requests when MIT-SHM is unavailable
+ */
+class NXcbFrameBuffer : public FrameBuffer
+{
+public:
+    static NXcbFrameBuffer *create(uint32_t width, uint32_t height);
+
+    ~NXcbFrameBuffer() override;
+
+public:
+    /**
+     * Upload the rects to a server side front pixmap and copy them from there to the window.
+     * With MIT-SHM the server reads the segment asynchronously, a completion event for shmSeg()
+     * is sent once the last rect is read, returns whether such an event is pending.
+     */
+    bool present(xcb_window_t window, xcb_gcontext_t gc, const std::vector<Rect> &rects);
+
+    /**
+     * Copy a rect of the last presented frame to the window, nothing before the first present
+     */
+    void repaint(xcb_window_t window, xcb_gcontext_t gc, const Rect &rect) const;
+
+    bool isShm() const
+    {
+        return mShmSeg != 0;
+    }
+
+    xcb_shm_seg_t shmSeg() const
+    {
+        return mShmSeg;
+    }
+
+private:
+    explicit NXcbFrameBuffer(uint32_t width, uint32_t height, PixelFormat::Enum format,
+                             unsigned char *data, xcb_shm_seg_t shmSeg);
+
+    static unsigned char *attachShm(uint64_t size, xcb_shm_seg_t &shmSeg);
+
+    bool clip(const Rect &rect, Rect &clipped) const;
+
+    void put(xcb_drawable_t drawable, xcb_gcontext_t gc, const Rect &rect, bool sendEvent);
+
+private:
+    unsigned char *mPixels;
+    xcb_shm_seg_t mShmSeg;
+    std::vector<uint8_t> mUpload;
+    // Holds the last presented frame while the application draws the next one into mPixels
+    xcb_pixmap_t mFront = XCB_NONE;
+};
+
+
+class NXcbCursor
+{
+public:
+    explicit NXcbCursor() = default;
+
+    explicit NXcbCursor(const Cursor &cursor);
+
+    ~NXcbCursor();
+
+public:
+    xcb_cursor_t cursor() const
+    {
+        return mCursor;
+    }
+
+    static xcb_cursor_t createNativeCursor(const Cursor &cursor);
+
+    static xcb_cursor_t createShapeCursor(Cursor::CursorShape shape);
+
+    static xcb_cursor_t createCursor(const CursorBitmap &bitmap, int hotX, int hotY);
+
+    static xcb_cursor_t createHiddenCursor();
+
+    static void destroyCursor(xcb_cursor_t cursor);
+
+private:
+    xcb_cursor_t mCursor = 0;
+};
+
+static NativeCursorCache<xcb_cursor_t> sCursorCache(NXcbCursor::createNativeCursor, NXcbCursor::destroyCursor);
+
+
+class NXcbWindow : public NWindow
+{
+public:
+    ~NXcbWindow() override
+    = default;
+
+    bool init(AppContext *appCtx, WindowHandle *wh) override
+    {
+        mAppContext = appCtx;
+        mWh = wh;
+
+        xcb_connection_t *c = sXcbApp.connection;
+        xcb_screen_t *screen = sXcbApp.screen;
+
+        // Creation, protocols, class and mapping are pipelined, none of them waits for a reply
+        mWindow = xcb_generate_id(c);
+        const uint32_t values[] = {screen->black_pixel, 0, EVENT_MASK};
+        xcb_create_window(c, XCB_COPY_FROM_PARENT, mWindow, screen->root,
+                          (int16_t) wh->getX(), (int16_t) wh->getY(),
+                          (uint16_t) wh->getWindowWidth(), (uint16_t) wh->getWindowHeight(), 0,
+                          XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual,
+                          XCB_CW_BACK_PIXEL | XCB_CW_BORDER_PIXEL | XCB_CW_EVENT_MASK, values);
+
+        sXcbApp.windows[mWindow] = this;
+
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, sXcbApp.WM_PROTOCOLS, XCB_ATOM_ATOM, 32,
+                            1, &sXcbApp.WM_DELETE_WINDOW);
+
+        // WM_CLASS is the instance and class names, both null terminated
+        static const char applicationClass[] = "gxx\0GXX";
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, 8,
+                            sizeof(applicationClass), applicationClass);
+
+        xcb_map_window(c, mWindow);
+
+        setPlatformData(mWh, c, mWindow);
+
+        setWindowTitle(wh->getWindowTitle());
+        setWindowPos(wh->getX(), wh->getY());
+        setWindowSize(wh->getWindowWidth(), wh->getWindowHeight());
+
+        setWindowFlags(wh->getWindowFlags());
+        setWindowState(wh->getWindowState());
+
+        mHiddenCursor = sCursorCache.acquire(Cursor(CursorBitmap(16, 16), 0, 0));
+
+        wh->init();
+        return true;
+    }
+
+    bool isInited() override
+    {
+        return mWindow;
+    }
+
+    bool frame() override
+    {
+        if (mExit) {
+            return false;
+        }
+
+        // Events are read once per loop by nativePollEvents and dispatched to the owning window
+
+        if (mCursorMode == CursorMode::Disabled) {
+            int centerX = (int) mWidth / 2;
+            int centerY = (int) mHeight / 2;
+
+            if (centerX != mLastMouseX || centerY != mLastMouseY) {
+                mLastMouseX = centerX;
+                mLastMouseY = centerY;
+
+                xcb_warp_pointer(sXcbApp.connection, XCB_NONE, mWindow, 0, 0, 0, 0,
+                                 (int16_t) centerX, (int16_t) centerY);
+                flushImmediately();
+            }
+        }
+
+        return !mExit;
+    }
+
+    void destroy() override
+    {
+        xcb_connection_t *c = sXcbApp.connection;
+        if (mFrameBuffer) {
+            delete mFrameBuffer;
+            mFrameBuffer = nullptr;
+        }
+        if (mGc) {
+            xcb_free_gc(c, mGc);
+            mGc = 0;
+        }
+        if (mHiddenCursor) {
+            sCursorCache.release(mHiddenCursor);
+            mHiddenCursor = 0;
+        }
+        destroyCursor();
+        if (mWindow) {
+            sXcbApp.windows.erase(mWindow);
+            xcb_unmap_window(c, mWindow);
+            xcb_destroy_window(c, mWindow);
+            mWindow = 0;
+        }
+    }
+
+public:
+    void exit() override
+    {
+        mExit = true;
+    }
+
+    void setWindowSize(uint32_t w, uint32_t h) override
+    {
+        const uint32_t values[] = {mWidth = w, mHeight = h};
+        xcb_configure_window(sXcbApp.connection, mWindow,
+                             XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+        if (!(mFlags & WindowFlag::Resizable)) {
+            // The size limits follow the size set by the application
+            writeNormalHints();
+        }
+        mWh->postWindowSizeEvent(w, h);
+    }
+
+    void setWindowPos(int x, int y) override
+    {
+        // HACK: Explicitly setting PPosition to any value causes some WMs, notably
+        //       Compiz and Metacity, to honor the position of unmapped windows.
+        if (!mMapped) {
+            mPositionHint = true;
+            writeNormalHints();
+        }
+
+        const uint32_t values[] = {(uint32_t) (mX = x), (uint32_t) (mY = y)};
+        xcb_configure_window(sXcbApp.connection, mWindow, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, values);
+    }
+
+    void setWindowTitle(const std::string &title) override
+    {
+        xcb_connection_t *c = sXcbApp.connection;
+        const auto length = (uint32_t) title.size();
+
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, XCB_ATOM_WM_NAME, sXcbApp.UTF8_STRING, 8,
+                            length, title.c_str());
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, XCB_ATOM_WM_ICON_NAME, sXcbApp.UTF8_STRING, 8,
+                            length, title.c_str());
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, sXcbApp.NET_WM_NAME, sXcbApp.UTF8_STRING, 8,
+                            length, title.c_str());
+        xcb_change_property(c, XCB_PROP_MODE_REPLACE, mWindow, sXcbApp.NET_WM_ICON_NAME, sXcbApp.UTF8_STRING, 8,
+                            length, title.c_str());
+    }
+
+    void setWindowState(WindowState::Enum state) override
+    {
+        switch (state) {
+            case WindowState::Normal: {
+                maximizedWindow(false);
+                fullScreen(false);
+            }
+                break;
+            case WindowState::Minimized: {
+                minimizedWindow(true);
+            }
+                break;
+            case WindowState::Maximized: {
+                fullScreen(false);
+                maximizedWindow(true);
+            }
+                break;
+            case WindowState::FullScreen: {
+                maximizedWindow(false);
+                fullScreen(true);
+            }
+                break;
+        }
+    }
+
+    void setWindowFlags(WindowFlags flags) override
+    {
+        mFlags = flags;
+        writeNormalHints();
+
+        if (sXcbApp.MOTIF_WM_HINTS != XCB_ATOM_NONE) {
+            // flags, functions, decorations, input mode, status
+            uint32_t hints[5] = {};
+            hints[0] = 1 << 1;  // MWM_HINTS_DECORATIONS
+            hints[2] = (flags & WindowFlag::ShowBorder) ? 1 : 0;  // MWM_DECOR_ALL or none
+            xcb_change_property(sXcbApp.connection, XCB_PROP_MODE_REPLACE, mWindow,
+                                sXcbApp.MOTIF_WM_HINTS, sXcbApp.MOTIF_WM_HINTS, 32,
+                                ARRAY_LEN(hints), hints);
+        }
+    }
+
+    void showInfoDialog(const std::string &title, const std::string &msg) override
+    {
+    }
+
+    void setCursor(const Cursor &cursor) override
+    {
+        // Acquire before releasing the current one, switching back and forth reuses the cached handles
+        auto *nCursor = new NXcbCursor(cursor);
+        destroyCursor();
+        mCursor = nCursor;
+        updateCursorImage();
+    }
+
+    void setCursorMode(CursorMode::Enum mode) override
+    {
+        if (mode == mCursorMode) {
+            return;
+        }
+        getCursorPosition(mVirtualCursorPosX, mVirtualCursorPosY);
+
+        CursorMode::Enum oldMode = mCursorMode;
+        mCursorMode = mode;
+
+        updateCursorImage();
+
+        xcb_connection_t *c = sXcbApp.connection;
+        if (mode == CursorMode::Disabled) {
+            getCursorPosition(mRestoreCursorPosX, mRestoreCursorPosY);
+
+            // move cursor to window center
+            xcb_warp_pointer(c, XCB_NONE, mWindow, 0, 0, 0, 0, (int16_t) (mWidth / 2), (int16_t) (mHeight / 2));
+
+            // The grab status is not needed, its reply is dropped instead of waited for
+            xcb_grab_pointer_cookie_t cookie = xcb_grab_pointer(
+                    c, 1, mWindow,
+                    XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_POINTER_MOTION,
+                    XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+                    mWindow, mHiddenCursor, XCB_CURRENT_TIME);
+            xcb_discard_reply(c, cookie.sequence);
+        } else if (oldMode == CursorMode::Disabled) {
+            xcb_ungrab_pointer(c, XCB_CURRENT_TIME);
+            setCursorPosition(mRestoreCursorPosX, mRestoreCursorPosY);
+        }
+    }
+
+    void setCursorPosition(int32_t x, int32_t y) override
+    {
+        if (mCursorMode == CursorMode::Disabled) {
+            return;
+        }
+        mMouseX = x;
+        mMouseY = y;
+
+        xcb_warp_pointer(sXcbApp.connection, XCB_NONE, mWindow, 0, 0, 0, 0, (int16_t) x, (int16_t) y);
+        flushImmediately();
+    }
+
+    void getCursorPosition(int32_t &x, int32_t &y) override
+    {
+        if (mCursorMode == CursorMode::Disabled) {
+            x = mVirtualCursorPosX;
+            y = mVirtualCursorPosY;
+        } else {
+            // Last position reported by the pointer events of this window
+            x = mMouseX;
+            y = mMouseY;
+        }
+    }
+
+    void setCharInputEnabled(bool enabled) override
+    {
+        mCharInput = enabled;
+    }
+
+    FrameBuffer *getFrameBuffer() override
+    {
+        if (mFrameBuffer && (mFrameBuffer->width() != mWidth || mFrameBuffer->height() != mHeight)) {
+            // A put still in flight is ordered before the detach, the server finishes reading first
+            delete mFrameBuffer;
+            mFrameBuffer = nullptr;
+            mPresentPending = false;
+        }
+        if (!mFrameBuffer && mWidth > 0 && mHeight > 0) {
+            mFrameBuffer = NXcbFrameBuffer::create(mWidth, mHeight);
+        }
+        return mFrameBuffer;
+    }
+
+    bool presentFrameBuffer() override
+    {
+        if (!mFrameBuffer || mPresentPending) {
+            return false;
+        }
+        if (!mGc) {
+            // Copies from the front pixmap never need GraphicsExpose/NoExpose events
+            const uint32_t graphicsExposures = 0;
+            mGc = xcb_generate_id(sXcbApp.connection);
+            xcb_create_gc(sXcbApp.connection, mGc, mWindow, XCB_GC_GRAPHICS_EXPOSURES, &graphicsExposures);
+        }
+        std::vector<FrameBuffer::Rect> rects = mFrameBuffer->dirtyRects();
+        if (rects.empty()) {
+            FrameBuffer::Rect all;
+            all.width = mFrameBuffer->width();
+            all.height = mFrameBuffer->height();
+            rects.push_back(all);
+        }
+        mPresentPending = mFrameBuffer->present(mWindow, mGc, rects);
+        mFrameBuffer->clearDirty();
+        return true;
+    }
+
+    void destroyCursor()
+    {
+        if (mCursor != nullptr) {
+            const uint32_t none = XCB_NONE;
+            xcb_change_window_attributes(sXcbApp.connection, mWindow, XCB_CW_CURSOR, &none);
+            delete mCursor;
+            mCursor = nullptr;
+        }
+    }
+
+private:
+    /**
+     * @param next  The event queued after this one, or nullptr, used to look ahead without reading the socket
+     */
+    void processEvent(const xcb_generic_event_t *event, const xcb_generic_event_t *next)
+    {
+        const uint8_t type = event->response_type & ~0x80;
+
+        if (sXcbApp.shm && type == sXcbApp.shmCompletionEvent) {
+            const auto *completion = reinterpret_cast<const xcb_shm_completion_event_t *>(event);
+            if (mFrameBuffer && completion->shmseg == mFrameBuffer->shmSeg()) {
+                mPresentPending = false;
+            }
+            return;
+        }
+
+        switch (type)
+        {
+            case XCB_EXPOSE:
+            {
+                // Repainted from the last presented frame, the backbuffer may hold a half drawn one
+                if (mFrameBuffer && mGc) {
+                    const auto *expose = reinterpret_cast<const xcb_expose_event_t *>(event);
+                    FrameBuffer::Rect rect;
+                    rect.x = expose->x;
+                    rect.y = expose->y;
+                    rect.width = expose->width;
+                    rect.height = expose->height;
+                    mFrameBuffer->repaint(mWindow, mGc, rect);
+                }
+            }
+                break;
+
+            case XCB_MAP_NOTIFY:
+                mMapped = true;
+                break;
+
+            case XCB_UNMAP_NOTIFY:
+                mMapped = false;
+                break;
+
+            case XCB_ENTER_NOTIFY:
+            case XCB_LEAVE_NOTIFY:
+            {
+                const auto *crossing = reinterpret_cast<const xcb_enter_notify_event_t *>(event);
+                if (mCursorMode != CursorMode::Disabled) {
+                    mMouseX = crossing->event_x;
+                    mMouseY = crossing->event_y;
+                }
+            }
+                break;
+
+            case XCB_CLIENT_MESSAGE:
+            {
+                const auto *message = reinterpret_cast<const xcb_client_message_event_t *>(event);
+                if (message->type == sXcbApp.WM_PROTOCOLS &&
+                    message->data.data32[0] == sXcbApp.WM_DELETE_WINDOW) {
+                    mWh->postExitEvent();
+                }
+            }
+                break;
+
+            case XCB_BUTTON_PRESS:
+            case XCB_BUTTON_RELEASE:
+            {
+                const auto *button = reinterpret_cast<const xcb_button_press_event_t *>(event);
+                MouseButton::Enum mb = MouseButton::None;
+                float mouseScrollX = 0;
+                float mouseScrollY = 0;
+                switch (button->detail)
+                {
+                    case 1: mb = MouseButton::Left;   break;
+                    case 2: mb = MouseButton::Middle; break;
+                    case 3: mb = MouseButton::Right;  break;
+                    case 4: mouseScrollY = 1.0f; break;
+                    case 5: mouseScrollY = -1.0f; break;
+                    case 6: mouseScrollX = 1.0f; break;
+                    case 7: mouseScrollX = -1.0f; break;
+                }
+
+                if (MouseButton::None != mb) {
+                    mAppContext->postMouseButtonEvent(mWh->getWindowId()
+                            , mb
+                            , type == XCB_BUTTON_PRESS ? KeyAction::Press : KeyAction::Release);
+                }
+                if (button->event_x != mMouseX || button->event_y != mMouseY) {
+                    inputMotion(button->event_x, button->event_y, true);
+                }
+                if (mouseScrollX != 0 || mouseScrollY != 0) {
+                    mAppContext->postMouseScrollEvent(mWh->getWindowId(), mouseScrollX, mouseScrollY);
+                }
+            }
+                break;
+
+            case XCB_MOTION_NOTIFY:
+            {
+                const auto *motion = reinterpret_cast<const xcb_motion_notify_event_t *>(event);
+
+                // Collapse a run of queued motion events of the same window to the last one
+                bool compressed = false;
+                if (next && mWh->isMotionCompression() && (next->response_type & ~0x80) == XCB_MOTION_NOTIFY) {
+                    compressed = reinterpret_cast<const xcb_motion_notify_event_t *>(next)->event == mWindow;
+                }
+                inputMotion(motion->event_x, motion->event_y, !compressed);
+                if (compressed) {
+                    sXcbApp.frameStats.compressedMotions++;
+                }
+            }
+                break;
+
+            case XCB_KEY_PRESS:
+            case XCB_KEY_RELEASE:
+            {
+                const auto *key = reinterpret_cast<const xcb_key_press_event_t *>(event);
+                const xcb_keycode_t keycode = key->detail;
+                if (XCB_KEY_RELEASE == type && isAutoRepeatRelease(key, next)) {
+                    // The press that follows is reported as a repeat
+                    break;
+                }
+                const KeyAction::Enum pressAction = mKeyDown[keycode] ? KeyAction::Repeat : KeyAction::Press;
+                mKeyDown[keycode] = XCB_KEY_PRESS == type;
+
+                const KeycodeEntry &entry = keycodeEntry(keycode);
+                if (entry.modifier != Modifier::None) {
+                    setModifier(entry.modifier, XCB_KEY_PRESS == type);
+                    break;
+                }
+                if (XCB_KEY_PRESS == type) {
+                    if (Key::None != entry.key) {
+                        mAppContext->postKeyEvent(mWh->getWindowId(), entry.key, mModifiers, pressAction);
+                    }
+                    if (mCharInput) {
+                        inputChar(keycode, key->state);
+                    }
+                } else if (Key::None != entry.key) {
+                    mAppContext->postKeyEvent(mWh->getWindowId(), entry.key, mModifiers, KeyAction::Release);
+                }
+            }
+                break;
+
+            case XCB_CONFIGURE_NOTIFY:
+            {
+                const auto *configure = reinterpret_cast<const xcb_configure_notify_event_t *>(event);
+                if (mX != configure->x || mY != configure->y) {
+                    mX = configure->x;
+                    mY = configure->y;
+                    mWh->postWindowPosEvent(mX, mY);
+                }
+                if (mWidth != configure->width || mHeight != configure->height) {
+                    mWidth = configure->width;
+                    mHeight = configure->height;
+                    mWh->postWindowSizeEvent(mWidth, mHeight);
+                }
+            }
+                break;
+
+            case XCB_FOCUS_IN:
+            case XCB_FOCUS_OUT:
+            {
+                const auto *focus = reinterpret_cast<const xcb_focus_in_event_t *>(event);
+                if (focus->mode == XCB_NOTIFY_MODE_GRAB || focus->mode == XCB_NOTIFY_MODE_UNGRAB) {
+                    return;
+                }
+                mWh->postWindowFocusChange(XCB_FOCUS_IN == type);
+                if (XCB_FOCUS_OUT == type) {
+                    // Releases of keys held while unfocused are not delivered to this window
+                    mKeyDown.reset();
+                }
+            }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    /**
+     * @param post  false while a run of motion events is being compressed, the position is
+     *              still tracked so the relative delta of CursorMode::Disabled accumulates
+     */
+    void inputMotion(int x, int y, bool post)
+    {
+        mMouseX = x;
+        mMouseY = y;
+
+        if (mCursorMode == CursorMode::Disabled) {
+            const int dx = mMouseX - mLastMouseX;
+            const int dy = mMouseY - mLastMouseY;
+
+            inputCursorPos(mVirtualCursorPosX + dx, mVirtualCursorPosY + dy, post);
+        } else {
+            inputCursorPos(mMouseX, mMouseY, post);
+        }
+
+        mLastMouseX = mMouseX;
+        mLastMouseY = mMouseY;
+    }
+
+    void inputCursorPos(int32_t x, int32_t y, bool post)
+    {
+        if (mVirtualCursorPosX == x && mVirtualCursorPosY == y && !mMotionPending)
+            return;
+
+        mVirtualCursorPosX = x;
+        mVirtualCursorPosY = y;
+
+        if (post) {
+            mAppContext->postMouseMoveEvent(mWh->getWindowId(), x, y);
+        }
+        mMotionPending = !post;
+    }
+
+    /**
+     * Text of a key press from the core keymap, there is no input method on this backend
+     */
+    void inputChar(xcb_keycode_t keycode, uint16_t state)
+    {
+        if (state & (XCB_MOD_MASK_CONTROL | XCB_MOD_MASK_1)) {
+            return;
+        }
+        const xcb_keysym_t base = keysymOf(keycode, 0);
+        const xcb_keysym_t shifted = keysymOf(keycode, 1);
+
+        bool shift = (state & XCB_MOD_MASK_SHIFT) != 0;
+        if (shifted >= XK_KP_Space && shifted <= XK_KP_9) {
+            // Mod2 is NumLock on practically every keymap
+            shift = shift != ((state & XCB_MOD_MASK_2) != 0);
+        } else if ((state & XCB_MOD_MASK_LOCK) && base >= XK_a && base <= XK_z) {
+            shift = !shift;
+        }
+
+        const xcb_keysym_t keysym = shift && shifted != XCB_NO_SYMBOL ? shifted : base;
+        const uint32_t codepoint = x11KeysymToCodepoint(keysym);
+        if (codepoint < 0x20 || codepoint == 0x7f) {
+            return;
+        }
+        std::string text;
+        encodeUTF8(codepoint, text);
+        mAppContext->postCharInputEvent(mWh->getWindowId(), text);
+    }
+
+    /**
+     * The server sends a Release/Press pair with the same timestamp for every repeat of a held key,
+     * the release of such a pair is recognised from the queued event after it
+     */
+    bool isAutoRepeatRelease(const xcb_key_release_event_t *release, const xcb_generic_event_t *next) const
+    {
+        if (!next || (next->response_type & ~0x80) != XCB_KEY_PRESS) {
+            return false;
+        }
+        const auto *press = reinterpret_cast<const xcb_key_press_event_t *>(next);
+        return press->event == release->event &&
+               press->detail == release->detail &&
+               press->time == release->time;
+    }
+
+    void maximizedWindow(bool maximized)
+    {
+        sendWmState(maximized, sXcbApp.NET_WM_STATE_MAXIMIZED_VERT, sXcbApp.NET_WM_STATE_MAXIMIZED_HORZ);
+    }
+
+    void minimizedWindow(bool minimized)
+    {
+        sendWmState(minimized, sXcbApp.NET_WM_STATE_HIDDEN, XCB_ATOM_NONE);
+
+        if (minimized) {
+            // Same request as XIconifyWindow
+            xcb_client_message_event_t event;
+            memset(&event, 0, sizeof(event));
+            event.response_type = XCB_CLIENT_MESSAGE;
+            event.format = 32;
+            event.window = mWindow;
+            event.type = sXcbApp.WM_CHANGE_STATE;
+            event.data.data32[0] = 3;   // IconicState
+            sendToRoot(event);
+        }
+    }
+
+    /**
+     * WM_NORMAL_HINTS is only written by us, so it is rebuilt from the tracked state without reading it first.
+     * A window that is not resizable gets its current size as both the minimum and the maximum.
+     */
+    void writeNormalHints()
+    {
+        uint32_t hints[18] = {};
+        if (mPositionHint) {
+            hints[0] |= 1 << 2;  // PPosition
+        }
+        if (!(mFlags & WindowFlag::Resizable)) {
+            hints[0] |= (1 << 4) | (1 << 5);  // PMinSize | PMaxSize
+            hints[5] = hints[7] = mWidth;
+            hints[6] = hints[8] = mHeight;
+        }
+        xcb_change_property(sXcbApp.connection, XCB_PROP_MODE_REPLACE, mWindow,
+                            XCB_ATOM_WM_NORMAL_HINTS, XCB_ATOM_WM_SIZE_HINTS, 32,
+                            ARRAY_LEN(hints), hints);
+    }
+
+    void fullScreen(bool fullScreen)
+    {
+        sendWmState(fullScreen, sXcbApp.NET_WM_STATE_FULLSCREEN, XCB_ATOM_NONE);
+    }
+
+    void sendWmState(bool set, xcb_atom_t first, xcb_atom_t second)
+    {
+        xcb_client_message_event_t event;
+        memset(&event, 0, sizeof(event));
+        event.response_type = XCB_CLIENT_MESSAGE;
+        event.format = 32;
+        event.window = mWindow;
+        event.type = sXcbApp.NET_WM_STATE;
+        event.data.data32[0] = set;
+        event.data.data32[1] = first;
+        event.data.data32[2] = second;
+        event.data.data32[3] = 1;
+        sendToRoot(event);
+    }
+
+    static void sendToRoot(const xcb_client_message_event_t &event)
+    {
+        xcb_send_event(sXcbApp.connection, 0, sXcbApp.screen->root,
+                       XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY,
+                       reinterpret_cast<const char *>(&event));
+    }
+
+    void updateCursorImage()
+    {
+        xcb_cursor_t cursor = XCB_NONE;
+        if (mCursorMode != CursorMode::Normal) {
+            cursor = mHiddenCursor;
+        } else if (mCursor) {
+            cursor = mCursor->cursor();
+        }
+        xcb_change_window_attributes(sXcbApp.connection, mWindow, XCB_CW_CURSOR, &cursor);
+    }
+
+    static inline void setPlatformData(WindowHandle *wh, xcb_connection_t *connection, xcb_window_t window)
+    {
+        WindowHandle::PlatformData pd;
+        pd.nativeDisplayType = connection;
+        pd.nativeWindowHandle = (void *) (uintptr_t) window;
+        pd.context = nullptr;
+        wh->setPlatformData(pd);
+    }
+
+    void setModifier(Modifier::Enum modifier, bool set)
+    {
+        mModifiers &= ~modifier;
+        mModifiers |= set ? modifier : 0;
+    }
+
+private:
+    friend void nativePollEvents();
+
+    AppContext *mAppContext = nullptr;
+    WindowHandle *mWh = nullptr;
+
+    xcb_window_t mWindow = 0;
+    bool mCharInput = false;
+
+    uint8_t mModifiers = 0;
+    int mMouseX = 0;
+    int mMouseY = 0;
+    std::bitset<256> mKeyDown;
+    bool mMapped = false;
+
+    int mX = 0;
+    int mY = 0;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+
+    WindowFlags mFlags = WindowFlag::ShowBorder | WindowFlag::Resizable;
+    bool mPositionHint = false;
+
+    bool mExit = false;
+
+    CursorMode::Enum mCursorMode = CursorMode::Normal;
+    NXcbCursor *mCursor = nullptr;
+    int32_t mLastMouseX = 0, mLastMouseY = 0;
+    int32_t mVirtualCursorPosX = 0, mVirtualCursorPosY = 0;
+    bool mMotionPending = false;
+    int32_t mRestoreCursorPosX = 0, mRestoreCursorPosY = 0;
+
+    xcb_cursor_t mHiddenCursor = 0;
+
+    NXcbFrameBuffer *mFrameBuffer = nullptr;
+    xcb_gcontext_t mGc = 0;
+    bool mPresentPending = false;
+};
+
+
+/** ==== NXcbFrameBuffer ==== **/
+
+NXcbFrameBuffer *NXcbFrameBuffer::create(uint32_t width, uint32_t height)
+{
+    xcb_screen_t *screen = sXcbApp.screen;
+    const xcb_setup_t *setup = xcb_get_setup(sXcbApp.connection);
+
+    // Everything needed is in the connection setup, no request is made
+    xcb_visualtype_t *visual = nullptr;
+    for (auto depths = xcb_screen_allowed_depths_iterator(screen); depths.rem && !visual; xcb_depth_next(&depths)) {
+        for (auto visuals = xcb_depth_visuals_iterator(depths.data); visuals.rem; xcb_visualtype_next(&visuals)) {
+            if (visuals.data->visual_id == screen->root_visual) {
+                visual = visuals.data;
+                break;
+            }
+        }
+    }
+    uint8_t bitsPerPixel = 0;
+    for (auto formats = xcb_setup_pixmap_formats_iterator(setup); formats.rem; xcb_format_next(&formats)) {
+        if (formats.data->depth == screen->root_depth) {
+            bitsPerPixel = formats.data->bits_per_pixel;
+            break;
+        }
+    }
+    if (!visual || visual->_class != XCB_VISUAL_CLASS_TRUE_COLOR || bitsPerPixel != 32) {
+        Log("XCB: no framebuffer for a visual of depth %d", screen->root_depth);
+        return nullptr;
+    }
+
+    PixelFormat::Enum format;
+    const bool lsbFirst = setup->image_byte_order == XCB_IMAGE_ORDER_LSB_FIRST;
+    // Only byte orders that match Bgra or Rgba in memory, MSBFirst 0xff0000 red would be X,R,G,B
+    if (visual->red_mask == 0xff0000 && visual->green_mask == 0xff00 && visual->blue_mask == 0xff && lsbFirst) {
+        format = PixelFormat::Bgra;
+    } else if (visual->red_mask == 0xff && visual->green_mask == 0xff00 && visual->blue_mask == 0xff0000 && lsbFirst) {
+        format = PixelFormat::Rgba;
+    } else {
+        Log("XCB: no framebuffer for the visual channel masks");
+        return nullptr;
+    }
+
+    const uint64_t size = (uint64_t) width * height * sizeof(uint32_t);
+    xcb_shm_seg_t shmSeg = 0;
+    unsigned char *data = nullptr;
+    if (sXcbApp.shm) {
+        data = attachShm(size, shmSeg);
+    }
+    if (!data) {
+        // Fallback, every present copies the pixels through the connection
+        data = (unsigned char *) calloc(size, 1);
+        if (!data) {
+            return nullptr;
+        }
+    }
+    return new NXcbFrameBuffer(width, height, format, data, shmSeg);
+}
+
+unsigned char *NXcbFrameBuffer::attachShm(uint64_t size, xcb_shm_seg_t &shmSeg)
+{
+    xcb_connection_t *c = sXcbApp.connection;
+
+    const int shmId = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shmId < 0) {
+        return nullptr;
+    }
+    auto *data = (unsigned char *) shmat(shmId, nullptr, 0);
+    if (data == (unsigned char *) -1) {
+        shmctl(shmId, IPC_RMID, nullptr);
+        return nullptr;
+    }
+
+    // Attaching fails when the server cannot map the segment, wait for the outcome once
+    shmSeg = xcb_generate_id(c);
+    xcb_void_cookie_t cookie = xcb_shm_attach_checked(c, shmSeg, shmId, 0);
+    countRoundTrip();
+    xcb_generic_error_t *error = xcb_request_check(c, cookie);
+
+    // The segment is released once both sides have detached
+    shmctl(shmId, IPC_RMID, nullptr);
+
+    if (error) {
+        Log("XCB: MIT-SHM attach failed, falling back to PutImage");
+        free(error);
+        sXcbApp.shm = false;
+        shmSeg = 0;
+        shmdt(data);
+        return nullptr;
+    }
+    return data;
+}
+
+NXcbFrameBuffer::NXcbFrameBuffer(uint32_t width, uint32_t height, PixelFormat::Enum format,
+                                 unsigned char *data, xcb_shm_seg_t shmSeg)
+        : FrameBuffer(width, height, width * sizeof(uint32_t), format, data),
+          mPixels(data),
+          mShmSeg(shmSeg)
+{
+}
+
+NXcbFrameBuffer::~NXcbFrameBuffer()
+{
+    if (mFront != XCB_NONE) {
+        xcb_free_pixmap(sXcbApp.connection, mFront);
+    }
+    if (mShmSeg) {
+        xcb_shm_detach(sXcbApp.connection, mShmSeg);
+        shmdt(mPixels);
+    } else {
+        free(mPixels);
+    }
+}
+
+bool NXcbFrameBuffer::clip(const Rect &rect, Rect &clipped) const
+{
+    const int64_t x0 = std::max(rect.x, 0);
+    const int64_t y0 = std::max(rect.y, 0);
+    const int64_t x1 = std::min<int64_t>((int64_t) rect.x + rect.width, width());
+    const int64_t y1 = std::min<int64_t>((int64_t) rect.y + rect.height, height());
+    if (x0 >= x1 || y0 >= y1) {
+        return false;
+    }
+    clipped.x = (int32_t) x0;
+    clipped.y = (int32_t) y0;
+    clipped.width = (uint32_t) (x1 - x0);
+    clipped.height = (uint32_t) (y1 - y0);
+    return true;
+}
+
+bool NXcbFrameBuffer::present(xcb_window_t window, xcb_gcontext_t gc, const std::vector<Rect> &rects)
+{
+    xcb_connection_t *c = sXcbApp.connection;
+
+    if (mFront == XCB_NONE) {
+        mFront = xcb_generate_id(c);
+        xcb_create_pixmap(c, sXcbApp.screen->root_depth, mFront, window, (uint16_t) width(), (uint16_t) height());
+    }
+    std::vector<Rect> clipped;
+    clipped.reserve(rects.size());
+    for (const Rect &rect : rects) {
+        Rect r;
+        if (clip(rect, r)) {
+            clipped.push_back(r);
+        }
+    }
+    for (size_t i = 0; i < clipped.size(); i++) {
+        const Rect &r = clipped[i];
+        // Requests complete in order, the completion of the last put covers the previous ones
+        put(mFront, gc, r, i + 1 == clipped.size());
+        xcb_copy_area(c, mFront, window, gc, (int16_t) r.x, (int16_t) r.y, (int16_t) r.x, (int16_t) r.y,
+                      (uint16_t) r.width, (uint16_t) r.height);
+    }
+    return mShmSeg != 0 && !clipped.empty();
+}
+
+void NXcbFrameBuffer::repaint(xcb_window_t window, xcb_gcontext_t gc, const Rect &rect) const
+{
+    Rect r;
+    if (mFront != XCB_NONE && clip(rect, r)) {
+        xcb_copy_area(sXcbApp.connection, mFront, window, gc, (int16_t) r.x, (int16_t) r.y,
+                      (int16_t) r.x, (int16_t) r.y, (uint16_t) r.width, (uint16_t) r.height);
+    }
+}
+
+void NXcbFrameBuffer::put(xcb_drawable_t drawable, xcb_gcontext_t gc, const Rect &rect, bool sendEvent)
+{
+    xcb_connection_t *c = sXcbApp.connection;
+
+    const int64_t x0 = rect.x;
+    const int64_t y0 = rect.y;
+    const int64_t y1 = (int64_t) rect.y + rect.height;
+    const auto w = (uint16_t) rect.width;
+    const auto h = (uint16_t) rect.height;
+    const uint8_t depth = sXcbApp.screen->root_depth;
+    sXcbApp.frameStats.uploadedBytes += (uint64_t) w * h * pixelBytes();
+
+    if (mShmSeg) {
+        xcb_shm_put_image(c, drawable, gc, (uint16_t) width(), (uint16_t) height(),
+                          (uint16_t) x0, (uint16_t) y0, w, h, (int16_t) x0, (int16_t) y0,
+                          depth, XCB_IMAGE_FORMAT_Z_PIXMAP, sendEvent, mShmSeg, 0);
+        return;
+    }
+
+    // PutImage carries the pixels, split the rect in bands that fit in one request
+    const uint32_t rowBytes = w * pixelBytes();
+    const uint32_t maxRows = std::max<uint32_t>(1, (sXcbApp.maxRequestBytes - 64) / rowBytes);
+    for (int64_t y = y0; y < y1; y += maxRows) {
+        const auto rows = (uint16_t) std::min<int64_t>(maxRows, y1 - y);
+        const uint8_t *src = data() + y * bytesPerLine() + x0 * pixelBytes();
+        if (w != width()) {
+            // Rows of a narrower rect are not contiguous in the framebuffer
+            mUpload.resize((size_t) rowBytes * rows);
+            for (uint16_t i = 0; i < rows; i++) {
+                memcpy(mUpload.data() + (size_t) i * rowBytes, src + (size_t) i * bytesPerLine(), rowBytes);
+            }
+            src = mUpload.data();
+        }
+        xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, drawable, gc, w, rows, (int16_t) x0, (int16_t) y,
+                      0, depth, rowBytes * rows, src);
+    }
+}
+
+
+/** ==== NXcbCursor ==== **/
+
+NXcbCursor::NXcbCursor(const Cursor &cursor)
+        : mCursor(sCursorCache.acquire(cursor))
+{
+}
+
+NXcbCursor::~NXcbCursor()
+{
+    sCursorCache.release(mCursor);
+}
+
+xcb_cursor_t NXcbCursor::createNativeCursor(const Cursor &cursor)
+{
+    switch (cursor.getCursorStyle()) {
+        case Cursor::System:
+            return createShapeCursor(cursor.getCursorShape());
+        case Cursor::Custom:
+            return createCursor(cursor.getBitmap(), cursor.getHotX(), cursor.getHotY());
+    }
+    return XCB_NONE;
+}
+
+xcb_cursor_t NXcbCursor::createShapeCursor(Cursor::CursorShape shape)
+{
+    uint16_t id;
+    switch (shape) {
+        default:
+        case Cursor::Arrow:
+            id = XC_left_ptr;
+            break;
+        case Cursor::IBeam:
+            id = XC_xterm;
+            break;
+        case Cursor::Cross:
+            id = XC_crosshair;
+            break;
+        case Cursor::Hand:
+            id = XC_hand2;
+            break;
+        case Cursor::SizeVer:
+            id = XC_sb_v_double_arrow;
+            break;
+        case Cursor::SizeHor:
+            id = XC_sb_h_double_arrow;
+            break;
+    }
+
+    xcb_connection_t *c = sXcbApp.connection;
+    if (!sXcbApp.cursorFont) {
+        static const char fontName[] = "cursor";
+        sXcbApp.cursorFont = xcb_generate_id(c);
+        xcb_open_font(c, sXcbApp.cursorFont, sizeof(fontName) - 1, fontName);
+    }
+    xcb_cursor_t cursor = xcb_generate_id(c);
+    xcb_create_glyph_cursor(c, cursor, sXcbApp.cursorFont, sXcbApp.cursorFont, id, id + 1,
+                            0, 0, 0, 0xffff, 0xffff, 0xffff);
+    return cursor;
+}
+
+xcb_cursor_t NXcbCursor::createCursor(const CursorBitmap &bitmap, int hotX, int hotY)
+{
+    xcb_connection_t *c = sXcbApp.connection;
+
+    if (sXcbApp.renderFormatsPending) {
+        sXcbApp.renderFormatsPending = false;
+        countRoundTrip();
+        xcb_render_query_pict_formats_reply_t *reply =
+                xcb_render_query_pict_formats_reply(c, sXcbApp.renderFormatsCookie, nullptr);
+        if (reply) {
+            for (auto it = xcb_render_query_pict_formats_formats_iterator(reply); it.rem;
+                 xcb_render_pictforminfo_next(&it)) {
+                const xcb_render_pictforminfo_t *info = it.data;
+                if (info->type == XCB_RENDER_PICT_TYPE_DIRECT && info->depth == 32 &&
+                    info->direct.alpha_shift == 24 && info->direct.alpha_mask == 0xff &&
+                    info->direct.red_shift == 16 && info->direct.red_mask == 0xff &&
+                    info->direct.green_shift == 8 && info->direct.green_mask == 0xff &&
+                    info->direct.blue_shift == 0 && info->direct.blue_mask == 0xff) {
+                    sXcbApp.argbFormat = info->id;
+                    break;
+                }
+            }
+            free(reply);
+        }
+    }
+    if (!sXcbApp.render || !sXcbApp.argbFormat) {
+        // A fully transparent bitmap (the hidden cursor) still works with a core cursor
+        const auto *pixels = (const Rgba *) bitmap.data();
+        if (std::none_of(pixels, pixels + (uint64_t) bitmap.width() * bitmap.height(),
+                         [](const Rgba &pixel) { return pixel.a != 0; })) {
+            return createHiddenCursor();
+        }
+        Log("XCB: RENDER is unavailable, custom cursors fall back to the arrow");
+        return createShapeCursor(Cursor::Arrow);
+    }
+
+    const uint16_t width = bitmap.width();
+    const uint16_t height = bitmap.height();
+
+    // ARGB32 with premultiplied alpha, in the byte order of the server (B, G, R, A in LSB first order)
+    const uint64_t count = (uint64_t) width * height;
+    std::vector<Bgra> pixels(count);
+    PixelConvert::premultiplyToBgra((const Rgba *) bitmap.data(), pixels.data(), count);
+    if (xcb_get_setup(c)->image_byte_order != XCB_IMAGE_ORDER_LSB_FIRST) {
+        for (Bgra &pixel : pixels) {
+            std::reverse(pixel.v, pixel.v + 4);
+        }
+    }
+
+    // Pixmap, picture and cursor are created in one pipelined batch
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, pixmap, sXcbApp.screen->root, width, height);
+
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, pixmap, 0, nullptr);
+    xcb_put_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, pixmap, gc, width, height, 0, 0, 0, 32,
+                  (uint32_t) (count * sizeof(Bgra)), pixels.data()->v);
+    xcb_free_gc(c, gc);
+
+    xcb_render_picture_t picture = xcb_generate_id(c);
+    xcb_render_create_picture(c, picture, pixmap, sXcbApp.argbFormat, 0, nullptr);
+
+    xcb_cursor_t cursor = xcb_generate_id(c);
+    xcb_render_create_cursor(c, cursor, picture, (uint16_t) hotX, (uint16_t) hotY);
+
+    xcb_render_free_picture(c, picture);
+    xcb_free_pixmap(c, pixmap);
+    return cursor;
+}
+
+xcb_cursor_t NXcbCursor::createHiddenCursor()
+{
+    xcb_connection_t *c = sXcbApp.connection;
+
+    // A 1x1 cursor whose mask is cleared
+    xcb_pixmap_t pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 1, pixmap, sXcbApp.screen->root, 1, 1);
+
+    xcb_gcontext_t gc = xcb_generate_id(c);
+    const uint32_t foreground = 0;
+    xcb_create_gc(c, gc, pixmap, XCB_GC_FOREGROUND, &foreground);
+    const xcb_rectangle_t rect = {0, 0, 1, 1};
+    xcb_poly_fill_rectangle(c, pixmap, gc, 1, &rect);
+    xcb_free_gc(c, gc);
+
+    xcb_cursor_t cursor = xcb_generate_id(c);
+    xcb_create_cursor(c, cursor, pixmap, pixmap, 0, 0, 0, 0, 0, 0, 0, 0);
+    xcb_free_pixmap(c, pixmap);
+    return cursor;
+}
+
+void NXcbCursor::destroyCursor(xcb_cursor_t cursor)
+{
+    if (cursor) {
+        xcb_free_cursor(sXcbApp.connection, cursor);
+    }
+}
+
+
+/** ==== keymap ==== **/
+
+static void requestKeymap()
+{
+    const xcb_setup_t *setup = xcb_get_setup(sXcbApp.connection);
+    sXcbApp.keymapCookie = xcb_get_keyboard_mapping(sXcbApp.connection, setup->min_keycode,
+                                                    setup->max_keycode - setup->min_keycode + 1);
+    sXcbApp.keymapPending = true;
+}
+
+/**
+ * Collect the requested keymap, the reply has usually arrived long before the first key event
+ */
+static void resolveKeymap()
+{
+    if (!sXcbApp.keymapPending) {
+        return;
+    }
+    sXcbApp.keymapPending = false;
+
+    xcb_connection_t *c = sXcbApp.connection;
+    countRoundTrip();
+    xcb_get_keyboard_mapping_reply_t *reply = xcb_get_keyboard_mapping_reply(c, sXcbApp.keymapCookie, nullptr);
+    if (!reply) {
+        return;
+    }
+    const xcb_keysym_t *keysyms = xcb_get_keyboard_mapping_keysyms(reply);
+    const int length = xcb_get_keyboard_mapping_keysyms_length(reply);
+    sXcbApp.keysyms.assign(keysyms, keysyms + length);
+    sXcbApp.keysymsPerKeycode = reply->keysyms_per_keycode;
+    free(reply);
+
+    memset(sXcbApp.keycodeMap, 0, sizeof(sXcbApp.keycodeMap));
+    const xcb_keycode_t minKeycode = xcb_get_setup(c)->min_keycode;
+    const int keycodes = sXcbApp.keysymsPerKeycode ? length / sXcbApp.keysymsPerKeycode : 0;
+    for (int i = 0; i < keycodes && minKeycode + i < (int) ARRAY_LEN(sXcbApp.keycodeMap); i++) {
+        sXcbApp.keycodeMap[minKeycode + i] = x11KeycodeEntry(keysymOf(minKeycode + i, 0),
+                                                             keysymOf(minKeycode + i, 1));
+    }
+}
+
+static const KeycodeEntry &keycodeEntry(xcb_keycode_t keycode)
+{
+    resolveKeymap();
+    return sXcbApp.keycodeMap[keycode];
+}
+
+static xcb_keysym_t keysymOf(xcb_keycode_t keycode, uint32_t level)
+{
+    const xcb_keycode_t minKeycode = xcb_get_setup(sXcbApp.connection)->min_keycode;
+    if (keycode < minKeycode || level >= sXcbApp.keysymsPerKeycode) {
+        return XCB_NO_SYMBOL;
+    }
+    const size_t index = (size_t) (keycode - minKeycode) * sXcbApp.keysymsPerKeycode + level;
+    return index < sXcbApp.keysyms.size() ? sXcbApp.keysyms[index] : XCB_NO_SYMBOL;
+}
+
+static void encodeUTF8(uint32_t codepoint, std::string &out)
+{
+    if (codepoint < 0x80) {
+        out += (char) codepoint;
+    } else if (codepoint < 0x800) {
+        out += (char) (0xc0 | (codepoint >> 6));
+        out += (char) (0x80 | (codepoint & 0x3f));
+    } else if (codepoint < 0x10000) {
+        out += (char) (0xe0 | (codepoint >> 12));
+        out += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        out += (char) (0x80 | (codepoint & 0x3f));
+    } else {
+        out += (char) (0xf0 | (codepoint >> 18));
+        out += (char) (0x80 | ((codepoint >> 12) & 0x3f));
+        out += (char) (0x80 | ((codepoint >> 6) & 0x3f));
+        out += (char) (0x80 | (codepoint & 0x3f));
+    }
+}
+
+static xcb_window_t eventWindow(const xcb_generic_event_t *event)
+{
+    switch (event->response_type & ~0x80) {
+        case XCB_KEY_PRESS:
+        case XCB_KEY_RELEASE:
+        case XCB_BUTTON_PRESS:
+        case XCB_BUTTON_RELEASE:
+        case XCB_MOTION_NOTIFY:
+            return reinterpret_cast<const xcb_key_press_event_t *>(event)->event;
+        case XCB_ENTER_NOTIFY:
+        case XCB_LEAVE_NOTIFY:
+            return reinterpret_cast<const xcb_enter_notify_event_t *>(event)->event;
+        case XCB_FOCUS_IN:
+        case XCB_FOCUS_OUT:
+            return reinterpret_cast<const xcb_focus_in_event_t *>(event)->event;
+        case XCB_EXPOSE:
+            return reinterpret_cast<const xcb_expose_event_t *>(event)->window;
+        case XCB_CONFIGURE_NOTIFY:
+            return reinterpret_cast<const xcb_configure_notify_event_t *>(event)->window;
+        case XCB_MAP_NOTIFY:
+            return reinterpret_cast<const xcb_map_notify_event_t *>(event)->window;
+        case XCB_UNMAP_NOTIFY:
+            return reinterpret_cast<const xcb_unmap_notify_event_t *>(event)->window;
+        case XCB_CLIENT_MESSAGE:
+            return reinterpret_cast<const xcb_client_message_event_t *>(event)->window;
+        default:
+            if (sXcbApp.shm && (event->response_type & ~0x80) == sXcbApp.shmCompletionEvent) {
+                return reinterpret_cast<const xcb_shm_completion_event_t *>(event)->drawable;
+            }
+            return XCB_NONE;
+    }
+}
+
+
+/** ==== native functions ==== **/
+
+NWindow *createNativeWindow()
+{
+    return new NXcbWindow();
+}
+
+int nativeInit(AppContext *appCtx)
+{
+    int screenIndex = 0;
+    xcb_connection_t *c = xcb_connect(nullptr, &screenIndex);
+    if (!c || xcb_connection_has_error(c)) {
+        if (c) {
+            xcb_disconnect(c);
+        }
+        return EXIT_FAILURE;
+    }
+    sXcbApp.connection = c;
+
+    auto screens = xcb_setup_roots_iterator(xcb_get_setup(c));
+    for (int i = 0; i < screenIndex && screens.rem; i++) {
+        xcb_screen_next(&screens);
+    }
+    sXcbApp.screen = screens.data;
+
+    // Every startup request is sent before the first reply is read, so they share one round trip
+    static const struct
+    {
+        const char *name;
+        xcb_atom_t XcbGlobal::*atom;
+    } atoms[] = {
+            {"UTF8_STRING",                  &XcbGlobal::UTF8_STRING},
+            {"_NET_WM_NAME",                 &XcbGlobal::NET_WM_NAME},
+            {"_NET_WM_ICON_NAME",            &XcbGlobal::NET_WM_ICON_NAME},
+            {"WM_PROTOCOLS",                 &XcbGlobal::WM_PROTOCOLS},
+            {"WM_DELETE_WINDOW",             &XcbGlobal::WM_DELETE_WINDOW},
+            {"WM_CHANGE_STATE",              &XcbGlobal::WM_CHANGE_STATE},
+            {"_GXX_WAKEUP",                  &XcbGlobal::GXX_WAKEUP},
+            {"_NET_WM_STATE",                &XcbGlobal::NET_WM_STATE},
+            {"_NET_WM_STATE_MAXIMIZED_VERT", &XcbGlobal::NET_WM_STATE_MAXIMIZED_VERT},
+            {"_NET_WM_STATE_MAXIMIZED_HORZ", &XcbGlobal::NET_WM_STATE_MAXIMIZED_HORZ},
+            {"_NET_WM_STATE_HIDDEN",         &XcbGlobal::NET_WM_STATE_HIDDEN},
+            {"_NET_WM_STATE_FULLSCREEN",     &XcbGlobal::NET_WM_STATE_FULLSCREEN},
+            {"_MOTIF_WM_HINTS",              &XcbGlobal::MOTIF_WM_HINTS},
+    };
+    xcb_intern_atom_cookie_t atomCookies[ARRAY_LEN(atoms)];
+    for (size_t i = 0; i < ARRAY_LEN(atoms); i++) {
+        atomCookies[i] = xcb_intern_atom(c, 0, (uint16_t) strlen(atoms[i].name), atoms[i].name);
+    }
+    xcb_prefetch_extension_data(c, &xcb_shm_id);
+    xcb_prefetch_extension_data(c, &xcb_render_id);
+    xcb_prefetch_maximum_request_length(c);
+    requestKeymap();
+
+    sXcbApp.wakeupWindow = xcb_generate_id(c);
+    xcb_create_window(c, XCB_COPY_FROM_PARENT, sXcbApp.wakeupWindow, sXcbApp.screen->root,
+                      0, 0, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY, XCB_COPY_FROM_PARENT, 0, nullptr);
+
+    countRoundTrip();
+    for (size_t i = 0; i < ARRAY_LEN(atoms); i++) {
+        xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(c, atomCookies[i], nullptr);
+        sXcbApp.*(atoms[i].atom) = reply ? reply->atom : XCB_ATOM_NONE;
+        free(reply);
+    }
+
+    const xcb_query_extension_reply_t *shm = xcb_get_extension_data(c, &xcb_shm_id);
+    if (shm && shm->present) {
+        sXcbApp.shm = true;
+        sXcbApp.shmCompletionEvent = shm->first_event + XCB_SHM_COMPLETION;
+    }
+    const xcb_query_extension_reply_t *render = xcb_get_extension_data(c, &xcb_render_id);
+    if (render && render->present) {
+        sXcbApp.render = true;
+        sXcbApp.renderFormatsCookie = xcb_render_query_pict_formats(c);
+        sXcbApp.renderFormatsPending = true;
+    }
+    // In 4-byte units
+    sXcbApp.maxRequestBytes = xcb_get_maximum_request_length(c) * 4;
+
+    return 0;
+}
+
+int nativeTerminate(AppContext *appCtx)
+{
+    xcb_connection_t *c = sXcbApp.connection;
+    if (c) {
+        if (sXcbApp.keymapPending) {
+            xcb_discard_reply(c, sXcbApp.keymapCookie.sequence);
+        }
+        if (sXcbApp.renderFormatsPending) {
+            xcb_discard_reply(c, sXcbApp.renderFormatsCookie.sequence);
+        }
+        sCursorCache.clear();
+        if (sXcbApp.cursorFont) {
+            xcb_close_font(c, sXcbApp.cursorFont);
+            sXcbApp.cursorFont = 0;
+        }
+        if (sXcbApp.wakeupWindow) {
+            xcb_destroy_window(c, sXcbApp.wakeupWindow);
+            sXcbApp.wakeupWindow = 0;
+        }
+        xcb_flush(c);
+        xcb_disconnect(c);
+        sXcbApp.connection = nullptr;
+        sXcbApp.connectionBroken = false;
+    }
+    return EXIT_SUCCESS;
+}
+
+void nativeWakeup()
+{
+    if (!sXcbApp.connection || !sXcbApp.wakeupWindow) {
+        return;
+    }
+    // XCB connections are thread safe
+    xcb_client_message_event_t event;
+    memset(&event, 0, sizeof(event));
+    event.response_type = XCB_CLIENT_MESSAGE;
+    event.format = 32;
+    event.window = sXcbApp.wakeupWindow;
+    event.type = sXcbApp.GXX_WAKEUP;
+
+    xcb_send_event(sXcbApp.connection, 0, sXcbApp.wakeupWindow, XCB_EVENT_MASK_NO_EVENT,
+                   reinterpret_cast<const char *>(&event));
+    xcb_flush(sXcbApp.connection);
+}
+
+void nativePollEvents()
+{
+    xcb_connection_t *c = sXcbApp.connection;
+    if (!c || sXcbApp.connectionBroken) {
+        return;
+    }
+
+    // Read the socket once, then drain what was queued, looking one event ahead
+    xcb_generic_event_t *event = xcb_poll_for_event(c);
+    while (event) {
+        xcb_generic_event_t *next = xcb_poll_for_queued_event(c);
+        const uint8_t type = event->response_type & ~0x80;
+
+        if (type == 0) {
+            const auto *error = reinterpret_cast<const xcb_generic_error_t *>(event);
+            Log("XCB: error %d for request %d.%d", error->error_code, error->major_code, error->minor_code);
+        } else if (type == XCB_MAPPING_NOTIFY) {
+            // Keyboard mapping changes are global, they are not addressed to a window
+            const auto *mapping = reinterpret_cast<const xcb_mapping_notify_event_t *>(event);
+            if (mapping->request == XCB_MAPPING_KEYBOARD) {
+                if (sXcbApp.keymapPending) {
+                    xcb_discard_reply(c, sXcbApp.keymapCookie.sequence);
+                }
+                requestKeymap();
+            }
+        } else {
+            auto it = sXcbApp.windows.find(eventWindow(event));
+            if (it != sXcbApp.windows.end()) {
+                it->second->processEvent(event, next);
+            }
+        }
+
+        free(event);
+        event = next;
+    }
+
+    if (xcb_connection_has_error(c)) {
+        // No event will ever arrive again, close every window so the application can quit
+        Log("XCB: the connection to the X server is broken");
+        sXcbApp.connectionBroken = true;
+        for (auto &window : sXcbApp.windows) {
+            window.second->mExit = true;
+        }
+    }
+}
+
+void nativeFlush()
+{
+    // The only regular flush of the frame, all requests issued since the last one are written together
+    if (sXcbApp.connection) {
+        xcb_flush(sXcbApp.connection);
+        sXcbApp.frameStats.flushes++;
+    }
+
+    // Read through AppContext::nativeFrameStats(), logging here would cost a write on every frame
+    sXcbApp.lastFrameStats = sXcbApp.frameStats;
+    sXcbApp.frameStats = {};
+}
+
+NativeFrameStats nativeGetFrameStats()
+{
+    return sXcbApp.lastFrameStats;
+}
+
+bool nativeDeviceSupport(DeviceType::Enum type)
+{
+    switch (type) {
+        case DeviceType::Keyboard:
+        case DeviceType::Mouse:
+        case DeviceType::GamePad:
+        case DeviceType::CharInput:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::vector<GamepadStateInfo> nativeGetConnectedGamepadStateInfos()
+{
+    return {};
+}
+
+void nativeGetDesktopSize(uint32_t &w, uint32_t &h)
+{
+    w = sXcbApp.screen->width_in_pixels;
+    h = sXcbApp.screen->height_in_pixels;
+}
+
+}
+
+#endif
@@ -28,12 +28,17 @@
 
 #include <gx/debug.h>
 
+#include <cstdlib>
+#include <cstring>
+
 namespace gxx
 {
 
 /** Application **/
 Application *Application::sApplication = nullptr;
 
+bool Application::sHeadless = false;
+
 Application::Application(int argc, char **argv)
 {
     mAppARG.argc = argc;
@@ -90,6 +95,14 @@ void Application::addWindow(Window *window)
     }
 }
 
+bool Application::runOnMainThread(InlineTask task)
+{
+    if (mAppContext) {
+        return mAppContext->postMainThreadTask(std::move(task));
+    }
+    return false;
+}
+
 void Application::setName(const std::string &appName)
 {
     this->mName = appName;
@@ -145,4 +158,18 @@ Application *Application::application()
     return Application::sApplication;
 }
 
+void Application::setHeadless(bool headless)
+{
+    sHeadless = headless;
+}
+
+bool Application::isHeadless()
+{
+    if (sHeadless) {
+        return true;
+    }
+    const char *env = getenv("GXX_HEADLESS");
+    return env && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
 }
\ No newline at end of file
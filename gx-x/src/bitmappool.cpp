@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/bitmappool.h"
+
+#include <gx/allocator.h>
+#include <gx/debug.h>
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+namespace gxx
+{
+
+struct BitmapPoolState
+{
+    std::mutex mutex;
+    gx::HeapPond heap;
+    std::unordered_map<size_t, std::vector<void *>> freeLists;
+    BitmapPool::Stats stats;
+};
+
+/**
+ * Never destroyed, bitmaps in static storage may return their buffers during exit
+ */
+static BitmapPoolState &poolState()
+{
+    static auto *state = [] {
+        auto *s = new BitmapPoolState();
+        s->stats.maxCachedBytes = 64 * 1024 * 1024;
+        return s;
+    }();
+    return *state;
+}
+
+size_t BitmapPool::classSize(size_t size)
+{
+    if (size <= kMinClassSize) {
+        return kMinClassSize;
+    }
+    if (size > kMaxPooledSize) {
+        return (size + kAlignment - 1) / kAlignment * kAlignment;
+    }
+    // Four classes between consecutive powers of two
+    uint32_t top = 0;
+    while (((size_t) 1 << (top + 1)) < size) {
+        top++;
+    }
+    const size_t step = (size_t) 1 << (top - 2);
+    return (size + step - 1) / step * step;
+}
+
+void *BitmapPool::alloc(size_t size, size_t alignment)
+{
+    GX_ASSERT(alignment <= kAlignment);
+
+    const size_t capacity = classSize(size);
+    BitmapPoolState &state = poolState();
+    if (capacity <= kMaxPooledSize) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        auto it = state.freeLists.find(capacity);
+        if (it != state.freeLists.end() && !it->second.empty()) {
+            void *p = it->second.back();
+            it->second.pop_back();
+            state.stats.cachedBytes -= capacity;
+            state.stats.hits++;
+            return p;
+        }
+        state.stats.misses++;
+    }
+    return state.heap.alloc(capacity, kAlignment);
+}
+
+void BitmapPool::free(void *p, size_t size)
+{
+    if (!p) {
+        return;
+    }
+    const size_t capacity = classSize(size);
+    BitmapPoolState &state = poolState();
+    if (capacity <= kMaxPooledSize) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.stats.cachedBytes + capacity <= state.stats.maxCachedBytes) {
+            state.freeLists[capacity].push_back(p);
+            state.stats.cachedBytes += capacity;
+            return;
+        }
+    }
+    state.heap.free(p, capacity);
+}
+
+void BitmapPool::setMaxCachedBytes(uint64_t bytes)
+{
+    BitmapPoolState &state = poolState();
+    std::vector<std::pair<void *, size_t>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.stats.maxCachedBytes = bytes;
+
+        // Largest classes first, the fewest buffers are released to get under the limit
+        std::vector<size_t> classes;
+        for (auto &it : state.freeLists) {
+            classes.push_back(it.first);
+        }
+        std::sort(classes.begin(), classes.end(), std::greater<size_t>());
+        for (size_t capacity : classes) {
+            std::vector<void *> &list = state.freeLists[capacity];
+            while (state.stats.cachedBytes > bytes && !list.empty()) {
+                evicted.emplace_back(list.back(), capacity);
+                list.pop_back();
+                state.stats.cachedBytes -= capacity;
+            }
+        }
+    }
+    for (auto &it : evicted) {
+        state.heap.free(it.first, it.second);
+    }
+}
+
+void BitmapPool::trim()
+{
+    BitmapPoolState &state = poolState();
+    std::unordered_map<size_t, std::vector<void *>> freeLists;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        freeLists.swap(state.freeLists);
+        state.stats.cachedBytes = 0;
+    }
+    for (auto &it : freeLists) {
+        for (void *p : it.second) {
+            state.heap.free(p, it.first);
+        }
+    }
+}
+
+BitmapPool::Stats BitmapPool::stats()
+{
+    BitmapPoolState &state = poolState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.stats;
+}
+
+}
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/blit.h"
+#include "gxx/pixelconvert.h"
+
+#include "parallel_rows.h"
+#include "pixel_simd.h"
+
+#if GX_PLATFORM_LINUX || GX_PLATFORM_ANDROID
+#include <unistd.h>
+#endif
+
+
+namespace gxx
+{
+
+using SourceOverFunc = void (*)(uint8_t *dst, const uint8_t *src, uint32_t count, uint8_t opacity);
+using ColorKeyFunc = void (*)(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t key, uint32_t mask);
+
+
+/** ==== Scalar ==== **/
+
+static void scalarSourceOver(uint8_t *dst, const uint8_t *src, uint32_t count, uint8_t opacity)
+{
+    for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+        uint32_t s[4] = {src[0], src[1], src[2], src[3]};
+        if (opacity != 255) {
+            for (uint32_t &c : s) {
+                c = pixelDiv255(c * opacity);
+            }
+        }
+        const uint32_t inv = 255 - s[3];
+        for (int c = 0; c < 4; c++) {
+            dst[c] = (uint8_t) std::min<uint32_t>(255, s[c] + pixelDiv255(dst[c] * inv));
+        }
+    }
+}
+
+/**
+ * key and mask are the bytes of a pixel loaded as uint32, mask covers the colour channels
+ */
+static void scalarColorKey(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t key, uint32_t mask)
+{
+    for (uint32_t i = 0; i < count; i++, src += 4, dst += 4) {
+        uint32_t s;
+        memcpy(&s, src, sizeof(s));
+        if ((s & mask) != key) {
+            memcpy(dst, &s, sizeof(s));
+        }
+    }
+}
+
+
+#if GXX_PIXEL_SSE2
+
+/** ==== SSE2 ==== **/
+
+static inline __m128i sse2MulDiv255(__m128i v, __m128i factor)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = sse2Div255(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), factor));
+    const __m128i hi = sse2Div255(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), factor));
+    return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i sse2InverseAlpha16(__m128i v16)
+{
+    __m128i a = _mm_shufflelo_epi16(v16, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm_sub_epi16(_mm_set1_epi16(255), a);
+}
+
+static void sse2SourceOver(uint8_t *dst, const uint8_t *src, uint32_t count, uint8_t opacity)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8((char) 0xff);
+    const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+    const __m128i factor = _mm_set1_epi16(opacity);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        if (opacity != 255) {
+            s = sse2MulDiv255(s, factor);
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(s, zero)) == 0xffff) {
+            // Transparent
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(s, colorMask), ones)) == 0xffff) {
+            // Opaque
+            _mm_storeu_si128((__m128i *) (dst + i * 4), s);
+            continue;
+        }
+        const __m128i d = _mm_loadu_si128((const __m128i *) (dst + i * 4));
+        const __m128i lo = sse2Div255(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero),
+                                                      sse2InverseAlpha16(_mm_unpacklo_epi8(s, zero))));
+        const __m128i hi = sse2Div255(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero),
+                                                      sse2InverseAlpha16(_mm_unpackhi_epi8(s, zero))));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), _mm_adds_epu8(s, _mm_packus_epi16(lo, hi)));
+    }
+    scalarSourceOver(dst + i * 4, src + i * 4, count - i, opacity);
+}
+
+static void sse2ColorKey(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t key, uint32_t mask)
+{
+    const __m128i keyv = _mm_set1_epi32((int) key);
+    const __m128i maskv = _mm_set1_epi32((int) mask);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i s = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        const __m128i d = _mm_loadu_si128((const __m128i *) (dst + i * 4));
+        const __m128i keep = _mm_cmpeq_epi32(_mm_and_si128(s, maskv), keyv);
+        _mm_storeu_si128((__m128i *) (dst + i * 4), _mm_or_si128(_mm_and_si128(keep, d), _mm_andnot_si128(keep, s)));
+    }
+    scalarColorKey(dst + i * 4, src + i * 4, count - i, key, mask);
+}
+
+#endif
+
+
+#if GXX_PIXEL_AVX2
+
+/** ==== AVX2 ==== **/
+
+GXX_TARGET_AVX2 static inline __m256i avx2InverseAlpha16(__m256i v16)
+{
+    __m256i a = _mm256_shufflelo_epi16(v16, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    return _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+}
+
+GXX_TARGET_AVX2 static void avx2SourceOver(uint8_t *dst, const uint8_t *src, uint32_t count, uint8_t opacity)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alphaMask = _mm256_set1_epi32((int) 0xff000000);
+    const __m256i factor = _mm256_set1_epi16(opacity);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        if (opacity != 255) {
+            const __m256i lo = avx2Div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), factor));
+            const __m256i hi = avx2Div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), factor));
+            s = _mm256_packus_epi16(lo, hi);
+        }
+        if (_mm256_testz_si256(s, s)) {
+            // Transparent
+            continue;
+        }
+        if (_mm256_testc_si256(s, alphaMask)) {
+            // Opaque
+            _mm256_storeu_si256((__m256i *) (dst + i * 4), s);
+            continue;
+        }
+        const __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i * 4));
+        const __m256i lo = avx2Div255(_mm256_mullo_epi16(_mm256_unpacklo_epi8(d, zero),
+                                                         avx2InverseAlpha16(_mm256_unpacklo_epi8(s, zero))));
+        const __m256i hi = avx2Div255(_mm256_mullo_epi16(_mm256_unpackhi_epi8(d, zero),
+                                                         avx2InverseAlpha16(_mm256_unpackhi_epi8(s, zero))));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_adds_epu8(s, _mm256_packus_epi16(lo, hi)));
+    }
+    scalarSourceOver(dst + i * 4, src + i * 4, count - i, opacity);
+}
+
+GXX_TARGET_AVX2 static void avx2ColorKey(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t key, uint32_t mask)
+{
+    const __m256i keyv = _mm256_set1_epi32((int) key);
+    const __m256i maskv = _mm256_set1_epi32((int) mask);
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i s = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        const __m256i d = _mm256_loadu_si256((const __m256i *) (dst + i * 4));
+        const __m256i keep = _mm256_cmpeq_epi32(_mm256_and_si256(s, maskv), keyv);
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_blendv_epi8(s, d, keep));
+    }
+    scalarColorKey(dst + i * 4, src + i * 4, count - i, key, mask);
+}
+
+#endif
+
+
+#if GXX_PIXEL_NEON
+
+/** ==== NEON ==== **/
+
+static void neonSourceOver(uint8_t *dst, const uint8_t *src, uint32_t count, uint8_t opacity)
+{
+    const uint8x16_t factor = vdupq_n_u8(opacity);
+    uint32_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t s = vld4q_u8(src + i * 4);
+        if (opacity != 255) {
+            for (int c = 0; c < 4; c++) {
+                s.val[c] = neonMulDiv255(s.val[c], factor);
+            }
+        }
+        uint8x16x4_t d = vld4q_u8(dst + i * 4);
+        const uint8x16_t inv = vmvnq_u8(s.val[3]);
+        for (int c = 0; c < 4; c++) {
+            d.val[c] = vqaddq_u8(s.val[c], neonMulDiv255(d.val[c], inv));
+        }
+        vst4q_u8(dst + i * 4, d);
+    }
+    scalarSourceOver(dst + i * 4, src + i * 4, count - i, opacity);
+}
+
+static void neonColorKey(uint8_t *dst, const uint8_t *src, uint32_t count, uint32_t key, uint32_t mask)
+{
+    const uint32x4_t keyv = vdupq_n_u32(key);
+    const uint32x4_t maskv = vdupq_n_u32(mask);
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const uint32x4_t s = vreinterpretq_u32_u8(vld1q_u8(src + i * 4));
+        const uint32x4_t d = vreinterpretq_u32_u8(vld1q_u8(dst + i * 4));
+        const uint32x4_t keep = vceqq_u32(vandq_u32(s, maskv), keyv);
+        vst1q_u8(dst + i * 4, vreinterpretq_u8_u32(vbslq_u32(keep, d, s)));
+    }
+    scalarColorKey(dst + i * 4, src + i * 4, count - i, key, mask);
+}
+
+#endif
+
+
+/** ==== Fill ==== **/
+
+/**
+ * Repeat the pixel over dst by doubling the written prefix, size is a multiple of pixelSize
+ */
+static void patternFill(uint8_t *dst, uint64_t size, const uint8_t *pixel, uint32_t pixelSize)
+{
+    if (size == 0) {
+        return;
+    }
+    memcpy(dst, pixel, pixelSize);
+    uint64_t done = pixelSize;
+    while (done < size) {
+        const uint64_t n = std::min(done, size - done);
+        memcpy(dst + done, dst, n);
+        done += n;
+    }
+}
+
+/**
+ * Fills larger than this would only evict data that is still needed, streaming stores bypass the cache
+ */
+static uint64_t lastLevelCacheBytes()
+{
+    static const uint64_t bytes = [] {
+        long size = 0;
+#if defined(_SC_LEVEL3_CACHE_SIZE)
+        size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        if (size <= 0) {
+            size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        }
+#endif
+        return size > 0 ? (uint64_t) size : (uint64_t) 8 * 1024 * 1024;
+    }();
+    return bytes;
+}
+
+#if GXX_PIXEL_SSE2
+
+/**
+ * Fill with non-temporal stores, the pattern is split into whole registers covering lcm(pixelSize, 16) bytes
+ */
+static void sse2StreamFill(uint8_t *dst, uint64_t size, const uint8_t *pixel, uint32_t pixelSize)
+{
+    // Unaligned head with plain stores
+    const auto head = (uint32_t) std::min<uint64_t>((16 - ((uintptr_t) dst & 15)) & 15, size);
+    for (uint32_t i = 0; i < head; i++) {
+        dst[i] = pixel[i % pixelSize];
+    }
+
+    uint32_t period = 16;
+    while (period % pixelSize != 0) {
+        period += 16;
+    }
+    alignas(16) uint8_t pattern[16 * 16];   // pixelSize <= 16
+    for (uint32_t i = 0; i < period; i++) {
+        pattern[i] = pixel[(head + i) % pixelSize];
+    }
+    const uint32_t registers = period / 16;
+
+    uint64_t i = head;
+    if (registers == 1) {
+        const __m128i v = _mm_load_si128((const __m128i *) pattern);
+        for (; i + 64 <= size; i += 64) {
+            _mm_stream_si128((__m128i *) (dst + i), v);
+            _mm_stream_si128((__m128i *) (dst + i + 16), v);
+            _mm_stream_si128((__m128i *) (dst + i + 32), v);
+            _mm_stream_si128((__m128i *) (dst + i + 48), v);
+        }
+        for (; i + 16 <= size; i += 16) {
+            _mm_stream_si128((__m128i *) (dst + i), v);
+        }
+    } else {
+        for (; i + period <= size; i += period) {
+            for (uint32_t r = 0; r < registers; r++) {
+                _mm_stream_si128((__m128i *) (dst + i + r * 16), _mm_load_si128((const __m128i *) pattern + r));
+            }
+        }
+    }
+    // Streaming stores are weakly ordered, fence before other threads or the caller read the pixels
+    _mm_sfence();
+
+    for (; i < size; i++) {
+        dst[i] = pattern[(i - head) % period];
+    }
+}
+
+#endif
+
+
+/** ==== Dispatch ==== **/
+
+static SourceOverFunc sourceOverKernel()
+{
+    switch (PixelConvert::kernel()) {
+#if GXX_PIXEL_SSE2
+        case PixelConvert::Kernel::SSE2:
+            return sse2SourceOver;
+#endif
+#if GXX_PIXEL_AVX2
+        case PixelConvert::Kernel::AVX2:
+            return avx2SourceOver;
+#endif
+#if GXX_PIXEL_NEON
+        case PixelConvert::Kernel::NEON:
+            return neonSourceOver;
+#endif
+        default:
+            return scalarSourceOver;
+    }
+}
+
+static ColorKeyFunc colorKeyKernel()
+{
+    switch (PixelConvert::kernel()) {
+#if GXX_PIXEL_SSE2
+        case PixelConvert::Kernel::SSE2:
+            return sse2ColorKey;
+#endif
+#if GXX_PIXEL_AVX2
+        case PixelConvert::Kernel::AVX2:
+            return avx2ColorKey;
+#endif
+#if GXX_PIXEL_NEON
+        case PixelConvert::Kernel::NEON:
+            return neonColorKey;
+#endif
+        default:
+            return scalarColorKey;
+    }
+}
+
+void Blit::sourceOverRows(unsigned char *dst, uint32_t dstBytesPerLine,
+                          const unsigned char *src, uint32_t srcBytesPerLine,
+                          uint32_t width, uint32_t height, uint8_t opacity)
+{
+    const SourceOverFunc kernel = sourceOverKernel();
+    for (uint32_t y = 0; y < height; y++) {
+        kernel(dst + (uint64_t) dstBytesPerLine * y, src + (uint64_t) srcBytesPerLine * y, width, opacity);
+    }
+}
+
+void Blit::colorKeyRows(unsigned char *dst, uint32_t dstBytesPerLine,
+                        const unsigned char *src, uint32_t srcBytesPerLine,
+                        uint32_t width, uint32_t height, const unsigned char *key)
+{
+    // Built from bytes so the comparison does not depend on the host byte order
+    static const uint8_t colorBytes[4] = {0xff, 0xff, 0xff, 0x00};
+    uint32_t mask;
+    uint32_t keyValue;
+    memcpy(&mask, colorBytes, sizeof(mask));
+    memcpy(&keyValue, key, sizeof(keyValue));
+    keyValue &= mask;
+
+    const ColorKeyFunc kernel = colorKeyKernel();
+    for (uint32_t y = 0; y < height; y++) {
+        kernel(dst + (uint64_t) dstBytesPerLine * y, src + (uint64_t) srcBytesPerLine * y, width, keyValue, mask);
+    }
+}
+
+void Blit::fillRows(unsigned char *dst, uint32_t dstBytesPerLine, uint32_t width, uint32_t height,
+                    const unsigned char *pixel, uint32_t pixelSize)
+{
+    const uint64_t rowBytes = (uint64_t) width * pixelSize;
+#if GXX_PIXEL_SSE2
+    const bool streaming = rowBytes * height > lastLevelCacheBytes() && pixelSize <= 16;
+#else
+    // NEON has no streaming store, large fills are only parallel there
+    const bool streaming = false;
+#endif
+    const auto fillSpan = [&](uint8_t *p, uint64_t size) {
+#if GXX_PIXEL_SSE2
+        if (streaming) {
+            sse2StreamFill(p, size, pixel, pixelSize);
+            return;
+        }
+#endif
+        patternFill(p, size, pixel, pixelSize);
+    };
+
+    parallelRows(height, parallelRowsMinBand(width), [&](uint32_t begin, uint32_t end) {
+        if (rowBytes == dstBytesPerLine) {
+            // Contiguous rows, the band is one span
+            fillSpan(dst + (uint64_t) dstBytesPerLine * begin, rowBytes * (end - begin));
+            return;
+        }
+        for (uint32_t y = begin; y < end; y++) {
+            fillSpan(dst + (uint64_t) dstBytesPerLine * y, rowBytes);
+        }
+    });
+}
+
+}
@@ -46,7 +46,13 @@ Cursor::Cursor(CursorBitmap bitmap, int32_t hotX, int32_t hotY)
 }
 
 Cursor::Cursor(const Cursor &b) noexcept
-= default;
+        : mStyle(b.mStyle),
+          mShape(b.mShape),
+          mBitmap(b.mBitmap.share()),
+          mHotX(b.mHotX),
+          mHotY(b.mHotY)
+{
+}
 
 Cursor::Cursor(Cursor &&b) noexcept
         : mStyle(b.mStyle),
@@ -62,7 +68,7 @@ Cursor &Cursor::operator=(const Cursor &b) noexcept
     if (this != &b) {
         this->mStyle = b.mStyle;
         this->mShape = b.mShape;
-        this->mBitmap = b.mBitmap;
+        this->mBitmap = b.mBitmap.share();
         this->mHotX = b.mHotX;
         this->mHotY = b.mHotY;
     }
@@ -44,14 +44,26 @@ void DeviceDriver::registerDeviceHandler(BaseDeviceHandler *deviceHandler)
 {
     mEventMana->addEventHandler(deviceHandler->deviceType(), deviceHandler);
     deviceHandler->mDeviceDriver = this;
+    onDeviceHandlerRegistered(deviceHandler);
 }
 
 void DeviceDriver::unregisterDeviceHandler(BaseDeviceHandler *deviceHandler)
 {
+    onDeviceHandlerUnregistered(deviceHandler);
     mEventMana->removeEventHandler(deviceHandler->deviceType(), deviceHandler);
     deviceHandler->mDeviceDriver = nullptr;
 }
 
+void DeviceDriver::onDeviceHandlerRegistered(BaseDeviceHandler *deviceHandler)
+{
+    GX_UNUSED(deviceHandler);
+}
+
+void DeviceDriver::onDeviceHandlerUnregistered(BaseDeviceHandler *deviceHandler)
+{
+    GX_UNUSED(deviceHandler);
+}
+
 void DeviceDriver::postDeviceEvent(BaseDeviceEvent *event)
 {
     mEventMana->postEvent(event);
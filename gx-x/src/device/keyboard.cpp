@@ -36,6 +36,11 @@ void Keyboard::setKeyReleaseEventCallback(gxx::Keyboard::KeyReleaseEventFunc cal
     mKeyReleaseEventCb = std::move(callback);
 }
 
+void Keyboard::setKeyRepeatEventCallback(gxx::Keyboard::KeyRepeatEventFunc callback)
+{
+    mKeyRepeatEventCb = std::move(callback);
+}
+
 void Keyboard::handleDeviceEEvent(Event *eEvent)
 {
     if (!eEvent) {
@@ -51,6 +56,8 @@ void Keyboard::handleDeviceEEvent(Event *eEvent)
             if (mKeyReleaseEventCb) {
                 mKeyReleaseEventCb(_e->key, _e->modifier);
             }
+        } else if (_e->action == KeyAction::Enum::Repeat && mKeyRepeatEventCb) {
+            mKeyRepeatEventCb(_e->key, _e->modifier);
         } else {
             if (mKeyPressEventCb) {
                 mKeyPressEventCb(_e->key, _e->modifier);
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "gxx/framebuffer.h"
+#include "gxx/pixelconvert.h"
+
+#include <memory.h>
+
+
+namespace gxx
+{
+
+FrameBuffer::FrameBuffer(uint32_t width, uint32_t height, uint32_t bytesPerLine,
+                         PixelFormat::Enum format, unsigned char *data)
+        : mWidth(width),
+          mHeight(height),
+          mBytesPerLine(bytesPerLine),
+          mFormat(format),
+          mData(data)
+{
+    GX_ASSERT(bytesPerLine >= width * sizeof(uint32_t));
+    GX_ASSERT(bytesPerLine % sizeof(uint32_t) == 0);
+}
+
+FrameBuffer::~FrameBuffer() = default;
+
+uint32_t FrameBuffer::width() const
+{
+    return mWidth;
+}
+
+uint32_t FrameBuffer::height() const
+{
+    return mHeight;
+}
+
+uint64_t FrameBuffer::byteSize() const
+{
+    return (uint64_t) mBytesPerLine * mHeight;
+}
+
+uint32_t FrameBuffer::pixelBytes() const
+{
+    return sizeof(uint32_t);
+}
+
+uint32_t FrameBuffer::bytesPerLine() const
+{
+    return mBytesPerLine;
+}
+
+uint32_t FrameBuffer::pixelIndex(uint32_t x, uint32_t y) const
+{
+    return mBytesPerLine / sizeof(uint32_t) * y + x;
+}
+
+FrameBuffer::PixelFormat::Enum FrameBuffer::pixelFormat() const
+{
+    return mFormat;
+}
+
+unsigned char *FrameBuffer::data()
+{
+    return mData;
+}
+
+const unsigned char *FrameBuffer::data() const
+{
+    return mData;
+}
+
+void FrameBuffer::setData(const unsigned char *data, uint64_t size)
+{
+    uint64_t maxSize = byteSize();
+    size = size > maxSize ? maxSize : size;
+    memcpy(mData, data, size);
+}
+
+void FrameBuffer::fill(Rgba pixel)
+{
+    const uint32_t native = toNative(pixel);
+    for (uint32_t y = 0; y < mHeight; y++) {
+        auto *row = (uint32_t *) (mData + (uint64_t) mBytesPerLine * y);
+        std::fill_n(row, mWidth, native);
+    }
+}
+
+void FrameBuffer::setPixel(uint32_t x, uint32_t y, Rgba pixel)
+{
+    GX_ASSERT(x < mWidth);
+    GX_ASSERT(y < mHeight);
+
+    ((uint32_t *) mData)[pixelIndex(x, y)] = toNative(pixel);
+}
+
+Rgba FrameBuffer::getPixel(uint32_t x, uint32_t y) const
+{
+    GX_ASSERT(x < mWidth);
+    GX_ASSERT(y < mHeight);
+
+    return fromNative(((const uint32_t *) mData)[pixelIndex(x, y)]);
+}
+
+BitmapView<uint32_t> FrameBuffer::view()
+{
+    return BitmapView<uint32_t>(mData, mWidth, mHeight, mBytesPerLine);
+}
+
+BitmapView<const uint32_t> FrameBuffer::view() const
+{
+    return BitmapView<const uint32_t>(mData, mWidth, mHeight, mBytesPerLine);
+}
+
+void FrameBuffer::draw(const Bitmap<Rgba> &bitmap, int32_t x, int32_t y)
+{
+    draw(bitmap.view(), x, y);
+}
+
+void FrameBuffer::draw(const BitmapView<const Rgba> &bitmap, int32_t x, int32_t y)
+{
+    const int32_t x0 = std::max(x, 0);
+    const int32_t y0 = std::max(y, 0);
+    const int32_t x1 = std::min<int64_t>((int64_t) x + bitmap.width(), mWidth);
+    const int32_t y1 = std::min<int64_t>((int64_t) y + bitmap.height(), mHeight);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    for (int32_t dy = y0; dy < y1; dy++) {
+        const Rgba *srcRow = bitmap.row(dy - y) + (x0 - x);
+        auto *dstRow = (uint32_t *) (mData + (uint64_t) mBytesPerLine * dy) + x0;
+        if (mFormat == PixelFormat::Rgba) {
+            memcpy(dstRow, srcRow, (x1 - x0) * sizeof(uint32_t));
+        } else {
+            PixelConvert::rgbaToBgra(srcRow, (Bgra *) dstRow, x1 - x0);
+        }
+    }
+}
+
+/**
+ * Overlapping on one axis and at least touching on the other, rects that only share a corner are kept apart
+ */
+static bool canMerge(const FrameBuffer::Rect &a, const FrameBuffer::Rect &b)
+{
+    const int64_t ax1 = (int64_t) a.x + a.width, ay1 = (int64_t) a.y + a.height;
+    const int64_t bx1 = (int64_t) b.x + b.width, by1 = (int64_t) b.y + b.height;
+
+    const bool overlapX = a.x < bx1 && b.x < ax1;
+    const bool overlapY = a.y < by1 && b.y < ay1;
+    const bool touchX = a.x <= bx1 && b.x <= ax1;
+    const bool touchY = a.y <= by1 && b.y <= ay1;
+    return (overlapX && touchY) || (touchX && overlapY);
+}
+
+static FrameBuffer::Rect unite(const FrameBuffer::Rect &a, const FrameBuffer::Rect &b)
+{
+    const int64_t x0 = std::min(a.x, b.x);
+    const int64_t y0 = std::min(a.y, b.y);
+    const int64_t x1 = std::max((int64_t) a.x + a.width, (int64_t) b.x + b.width);
+    const int64_t y1 = std::max((int64_t) a.y + a.height, (int64_t) b.y + b.height);
+
+    FrameBuffer::Rect rect;
+    rect.x = (int32_t) x0;
+    rect.y = (int32_t) y0;
+    rect.width = (uint32_t) (x1 - x0);
+    rect.height = (uint32_t) (y1 - y0);
+    return rect;
+}
+
+void FrameBuffer::markDirty(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    const int64_t x0 = std::max<int64_t>(x, 0);
+    const int64_t y0 = std::max<int64_t>(y, 0);
+    const int64_t x1 = std::min<int64_t>((int64_t) x + width, mWidth);
+    const int64_t y1 = std::min<int64_t>((int64_t) y + height, mHeight);
+    if (x0 >= x1 || y0 >= y1) {
+        return;
+    }
+
+    Rect rect;
+    rect.x = (int32_t) x0;
+    rect.y = (int32_t) y0;
+    rect.width = (uint32_t) (x1 - x0);
+    rect.height = (uint32_t) (y1 - y0);
+
+    // A merged rect may now reach others, scan again until nothing merges
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (auto it = mDirtyRects.begin(); it != mDirtyRects.end(); ++it) {
+            if (canMerge(*it, rect)) {
+                rect = unite(*it, rect);
+                mDirtyRects.erase(it);
+                merged = true;
+                break;
+            }
+        }
+    }
+    mDirtyRects.push_back(rect);
+
+    if (mDirtyRects.size() > kMaxDirtyRects) {
+        Rect bounds = mDirtyRects.front();
+        for (const Rect &r : mDirtyRects) {
+            bounds = unite(bounds, r);
+        }
+        mDirtyRects.clear();
+        mDirtyRects.push_back(bounds);
+    }
+}
+
+void FrameBuffer::markDirty()
+{
+    mDirtyRects.clear();
+    markDirty(0, 0, mWidth, mHeight);
+}
+
+const std::vector<FrameBuffer::Rect> &FrameBuffer::dirtyRects() const
+{
+    return mDirtyRects;
+}
+
+void FrameBuffer::clearDirty()
+{
+    mDirtyRects.clear();
+}
+
+uint32_t FrameBuffer::toNative(Rgba pixel) const
+{
+    Rgba native = pixel;
+    if (mFormat == PixelFormat::Bgra) {
+        native.r = pixel.b;
+        native.b = pixel.r;
+    }
+    uint32_t value;
+    memcpy(&value, native.v, sizeof(value));
+    return value;
+}
+
+Rgba FrameBuffer::fromNative(uint32_t pixel) const
+{
+    Rgba value;
+    memcpy(value.v, &pixel, sizeof(pixel));
+    if (mFormat == PixelFormat::Bgra) {
+        std::swap(value.r, value.b);
+    }
+    return value;
+}
+
+}
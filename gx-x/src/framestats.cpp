@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "gxx/framestats.h"
+
+#include <gx/gtime.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+using namespace gx;
+
+namespace gxx
+{
+
+void FrameStats::addFrame(const FrameTiming &timing)
+{
+    mFrames[mHead] = timing;
+    mHead = (mHead + 1) % kCapacity;
+    if (mCount < kCapacity) {
+        mCount++;
+    }
+
+    if (mHitchBudget > 0 && timing.total > mHitchBudget) {
+        mHitchCount++;
+        if (mHitchCallback) {
+            mHitchCallback(timing);
+        }
+    }
+}
+
+void FrameStats::reset()
+{
+    mHead = 0;
+    mCount = 0;
+    mHitchCount = 0;
+}
+
+uint32_t FrameStats::count() const
+{
+    return mCount;
+}
+
+const FrameTiming &FrameStats::frame(uint32_t index) const
+{
+    return mFrames[(mHead + kCapacity - mCount + index) % kCapacity];
+}
+
+const FrameTiming &FrameStats::lastFrame() const
+{
+    return mFrames[(mHead + kCapacity - 1) % kCapacity];
+}
+
+FrameSummary FrameStats::summary() const
+{
+    FrameSummary summary;
+    summary.frames = mCount;
+    if (mCount == 0) {
+        return summary;
+    }
+
+    double totals[kCapacity];
+    for (uint32_t i = 0; i < mCount; i++) {
+        const FrameTiming &t = frame(i);
+        totals[i] = t.total;
+        summary.average.total += t.total;
+        for (uint32_t p = 0; p < FramePhase::Count; p++) {
+            summary.average.phases[p] += t.phases[p];
+        }
+    }
+    std::sort(totals, totals + mCount);
+
+    // Nearest-rank percentile
+    auto percentile = [&](double p) {
+        auto rank = (uint32_t) std::ceil(p * mCount);
+        return totals[rank > 0 ? rank - 1 : 0];
+    };
+    summary.p50 = percentile(0.50);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.max = totals[mCount - 1];
+
+    summary.average.total /= mCount;
+    for (uint32_t p = 0; p < FramePhase::Count; p++) {
+        summary.average.phases[p] /= mCount;
+    }
+    return summary;
+}
+
+void FrameStats::setHitchCallback(double budget, FrameStats::HitchCallback callback)
+{
+    mHitchBudget = budget > 0 ? budget : 0;
+    mHitchCallback = std::move(callback);
+}
+
+double FrameStats::hitchBudget() const
+{
+    return mHitchBudget;
+}
+
+uint64_t FrameStats::hitchCount() const
+{
+    return mHitchCount;
+}
+
+int64_t FrameStats::now()
+{
+    return GTime::currentSteadyTime().nanosecond();
+}
+
+}
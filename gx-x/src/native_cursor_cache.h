@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_NATIVE_CURSOR_CACHE_H
+#define GXX_NATIVE_CURSOR_CACHE_H
+
+#include "gxx/cursor.h"
+
+#include <list>
+#include <unordered_map>
+
+#include <gx/debug.h>
+
+
+namespace gxx
+{
+
+/**
+ * Process-wide cache of native cursor handles, shared by all windows of a backend
+ *
+ * System cursors are keyed by their shape and custom cursors by a FNV-1a hash of the bitmap and hotspot,
+ * a hash hit is confirmed by comparing the pixels. Handles are reference counted, a released handle is kept
+ * for reuse and only destroyed when more than maxUnused handles are unused, least recently released first.
+ *
+ * Like the other native calls the cache is only used from the native event loop thread.
+ *
+ * @tparam Handle  Native cursor handle, 0 is invalid
+ */
+template<typename Handle>
+class NativeCursorCache
+{
+public:
+    using CreateFunc = Handle (*)(const Cursor &cursor);
+    using DestroyFunc = void (*)(Handle handle);
+
+    explicit NativeCursorCache(CreateFunc create, DestroyFunc destroy, uint32_t maxUnused = 16)
+            : mCreate(create),
+              mDestroy(destroy),
+              mMaxUnused(maxUnused)
+    {}
+
+    ~NativeCursorCache() = default;
+
+    NativeCursorCache(const NativeCursorCache &) = delete;
+
+    NativeCursorCache &operator=(const NativeCursorCache &) = delete;
+
+public:
+    /**
+     * Native handle of the cursor, created on a miss, release it with release()
+     */
+    Handle acquire(const Cursor &cursor);
+
+    void release(Handle handle);
+
+    /**
+     * Destroy every handle, called before the connection to the window system is closed
+     */
+    void clear();
+
+    static uint64_t hashOf(const Cursor &cursor);
+
+private:
+    struct Entry
+    {
+        Cursor cursor;
+        uint64_t hash;
+        Handle handle;
+        uint32_t refs;
+        typename std::list<Entry *>::iterator unusedIt;
+    };
+
+    static bool sameCursor(const Cursor &a, const Cursor &b);
+
+    void evict();
+
+private:
+    CreateFunc mCreate;
+    DestroyFunc mDestroy;
+    uint32_t mMaxUnused;
+
+    std::unordered_multimap<uint64_t, Entry *> mEntries;
+    std::unordered_map<Handle, Entry *> mHandles;
+
+    // Entries without references, the most recently released at the front
+    std::list<Entry *> mUnused;
+};
+
+
+template<typename Handle>
+Handle NativeCursorCache<Handle>::acquire(const Cursor &cursor)
+{
+    const uint64_t hash = hashOf(cursor);
+
+    auto range = mEntries.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        Entry *entry = it->second;
+        if (sameCursor(entry->cursor, cursor)) {
+            if (entry->refs++ == 0) {
+                mUnused.erase(entry->unusedIt);
+            }
+            return entry->handle;
+        }
+    }
+
+    Handle handle = mCreate(cursor);
+    if (!handle) {
+        return handle;
+    }
+    auto *entry = new Entry{cursor, hash, handle, 1, mUnused.end()};
+    mEntries.emplace(hash, entry);
+    mHandles[handle] = entry;
+    return handle;
+}
+
+template<typename Handle>
+void NativeCursorCache<Handle>::release(Handle handle)
+{
+    auto it = mHandles.find(handle);
+    if (it == mHandles.end()) {
+        return;
+    }
+    Entry *entry = it->second;
+    GX_ASSERT(entry->refs > 0);
+    if (--entry->refs == 0) {
+        mUnused.push_front(entry);
+        entry->unusedIt = mUnused.begin();
+        evict();
+    }
+}
+
+template<typename Handle>
+void NativeCursorCache<Handle>::clear()
+{
+    for (auto &it : mEntries) {
+        mDestroy(it.second->handle);
+        delete it.second;
+    }
+    mEntries.clear();
+    mHandles.clear();
+    mUnused.clear();
+}
+
+template<typename Handle>
+uint64_t NativeCursorCache<Handle>::hashOf(const Cursor &cursor)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const unsigned char *data, uint64_t size) {
+        for (uint64_t i = 0; i < size; i++) {
+            hash ^= data[i];
+            hash *= 0x100000001b3ull;
+        }
+    };
+
+    const uint32_t style = cursor.getCursorStyle();
+    mix((const unsigned char *) &style, sizeof(style));
+    if (cursor.getCursorStyle() == Cursor::System) {
+        const uint32_t shape = cursor.getCursorShape();
+        mix((const unsigned char *) &shape, sizeof(shape));
+        return hash;
+    }
+
+    const CursorBitmap &bitmap = cursor.getBitmap();
+    const int32_t header[] = {(int32_t) bitmap.width(), (int32_t) bitmap.height(),
+                              cursor.getHotX(), cursor.getHotY()};
+    mix((const unsigned char *) header, sizeof(header));
+    mix(bitmap.data(), bitmap.byteSize());
+    return hash;
+}
+
+template<typename Handle>
+bool NativeCursorCache<Handle>::sameCursor(const Cursor &a, const Cursor &b)
+{
+    if (a.getCursorStyle() != b.getCursorStyle()) {
+        return false;
+    }
+    if (a.getCursorStyle() == Cursor::System) {
+        return a.getCursorShape() == b.getCursorShape();
+    }
+    const CursorBitmap &ab = a.getBitmap();
+    const CursorBitmap &bb = b.getBitmap();
+    return a.getHotX() == b.getHotX() && a.getHotY() == b.getHotY() &&
+           ab.width() == bb.width() && ab.height() == bb.height() &&
+           memcmp(ab.data(), bb.data(), ab.byteSize()) == 0;
+}
+
+template<typename Handle>
+void NativeCursorCache<Handle>::evict()
+{
+    while (mUnused.size() > mMaxUnused) {
+        Entry *entry = mUnused.back();
+        mUnused.pop_back();
+
+        auto range = mEntries.equal_range(entry->hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == entry) {
+                mEntries.erase(it);
+                break;
+            }
+        }
+        mHandles.erase(entry->handle);
+        mDestroy(entry->handle);
+        delete entry;
+    }
+}
+
+}
+
+#endif //GXX_NATIVE_CURSOR_CACHE_H
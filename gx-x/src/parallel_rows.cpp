@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "parallel_rows.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace gxx
+{
+
+/**
+ * Worker threads started on first use and joined at exit,
+ * one job at a time, its bands are claimed with an atomic counter by workers and caller alike
+ */
+class RowBandPool
+{
+public:
+    explicit RowBandPool()
+    {
+        const uint32_t cpus = std::thread::hardware_concurrency();
+        const uint32_t count = std::min<uint32_t>(cpus > 1 ? cpus - 1 : 0, kMaxWorkers);
+        mWorkers.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            mWorkers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~RowBandPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWakeCond.notify_all();
+        for (auto &t : mWorkers) {
+            t.join();
+        }
+    }
+
+    uint32_t workerCount() const
+    {
+        return (uint32_t) mWorkers.size();
+    }
+
+    /**
+     * @return false if another job is running, the caller then runs its rows itself
+     */
+    bool run(uint32_t rows, uint32_t bandCount, const RowBandFunc &func)
+    {
+        std::unique_lock<std::mutex> submit(mSubmitMutex, std::try_to_lock);
+        if (!submit.owns_lock()) {
+            return false;
+        }
+
+        const Job job = {&func, rows, bandCount};
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJob = job;
+            mNextBand.store(0, std::memory_order_relaxed);
+            mPendingBands = bandCount;
+            mGeneration++;
+        }
+        mWakeCond.notify_all();
+
+        const uint32_t done = runBands(job);
+
+        // Also wait for the workers to leave runBands, so none of them claims a band of the next job
+        std::unique_lock<std::mutex> lock(mMutex);
+        mPendingBands -= done;
+        mDoneCond.wait(lock, [this] { return mPendingBands == 0 && mActiveWorkers == 0; });
+        mJob = Job();
+        return true;
+    }
+
+private:
+    struct Job
+    {
+        const RowBandFunc *func = nullptr;
+        uint32_t rows = 0;
+        uint32_t bandCount = 0;
+    };
+
+private:
+    void workerLoop()
+    {
+        uint64_t seen = 0;
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWakeCond.wait(lock, [&] { return mStop || mGeneration != seen; });
+                if (mStop) {
+                    return;
+                }
+                seen = mGeneration;
+                // Woken too late, the caller already ran every band and may be setting up the next job
+                if (mPendingBands == 0) {
+                    continue;
+                }
+                job = mJob;
+                mActiveWorkers++;
+            }
+            const uint32_t done = runBands(job);
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mPendingBands -= done;
+                mActiveWorkers--;
+            }
+            mDoneCond.notify_one();
+        }
+    }
+
+    /**
+     * @return the number of bands run
+     */
+    uint32_t runBands(const Job &job)
+    {
+        uint32_t done = 0;
+        for (;;) {
+            const uint32_t band = mNextBand.fetch_add(1, std::memory_order_relaxed);
+            if (band >= job.bandCount) {
+                break;
+            }
+            // Even split, the first rows % bandCount bands get one extra row
+            const uint64_t begin = (uint64_t) job.rows * band / job.bandCount;
+            const uint64_t end = (uint64_t) job.rows * (band + 1) / job.bandCount;
+            (*job.func)((uint32_t) begin, (uint32_t) end);
+            done++;
+        }
+        return done;
+    }
+
+private:
+    static constexpr const uint32_t kMaxWorkers = 15;
+
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mSubmitMutex;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeCond;
+    std::condition_variable mDoneCond;
+    bool mStop = false;
+    uint64_t mGeneration = 0;
+
+    /**
+     * Current job, written under mMutex before mGeneration changes and copied by the workers under mMutex.
+     * A worker only joins while bands are pending, and the caller waits for joined workers to leave,
+     * so mNextBand is never reset under a worker that is still claiming bands.
+     */
+    Job mJob;
+    std::atomic<uint32_t> mNextBand{0};
+    uint32_t mPendingBands = 0;
+    uint32_t mActiveWorkers = 0;
+};
+
+static RowBandPool &rowBandPool()
+{
+    static RowBandPool pool;
+    return pool;
+}
+
+void parallelRows(uint32_t rows, uint32_t minRowsPerBand, const RowBandFunc &func)
+{
+    if (rows == 0) {
+        return;
+    }
+    const uint32_t maxBands = rows / std::max<uint32_t>(minRowsPerBand, 1);
+    if (maxBands < 2 || std::thread::hardware_concurrency() < 2) {
+        func(0, rows);
+        return;
+    }
+
+    RowBandPool &pool = rowBandPool();
+    // A few bands per thread so a slow band does not hold up the others
+    const uint32_t bandCount = std::min<uint32_t>(maxBands, (pool.workerCount() + 1) * 4);
+    if (pool.workerCount() == 0 || !pool.run(rows, bandCount, func)) {
+        func(0, rows);
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_PARALLEL_ROWS_H
+#define GXX_PARALLEL_ROWS_H
+
+#include <gx/gglobal.h>
+
+#include <algorithm>
+#include <functional>
+
+
+namespace gxx
+{
+
+using RowBandFunc = std::function<void(uint32_t begin, uint32_t end)>;
+
+/**
+ * Split the rows [0, rows) into bands of at least minRowsPerBand rows and run func on each band,
+ * on the shared worker threads and the calling thread, returns after every band is done.
+ * Runs func(0, rows) inline when there is only one band, one CPU, or the workers are busy
+ * with another call (including a nested call from inside func).
+ */
+extern void parallelRows(uint32_t rows, uint32_t minRowsPerBand, const RowBandFunc &func);
+
+/**
+ * minRowsPerBand giving bands of about 64K pixels, less than that is not worth waking a worker
+ */
+static inline uint32_t parallelRowsMinBand(uint32_t width)
+{
+    constexpr uint32_t kPixelsPerBand = 64 * 1024;
+    return width >= kPixelsPerBand ? 1 : kPixelsPerBand / std::max<uint32_t>(width, 1);
+}
+
+}
+
+#endif //GXX_PARALLEL_ROWS_H
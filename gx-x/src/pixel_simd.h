@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_PIXEL_SIMD_H
+#define GXX_PIXEL_SIMD_H
+
+#include <gx/gglobal.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GXX_PIXEL_SSE2 1
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+#define GXX_PIXEL_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define GXX_PIXEL_NEON 1
+#include <arm_neon.h>
+#endif
+
+// AVX2 kernels are built without global compiler flags and only called when PixelConvert selected AVX2
+#if GXX_PIXEL_AVX2 && (defined(__GNUC__) || defined(__clang__))
+#define GXX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define GXX_TARGET_AVX2
+#endif
+
+
+namespace gxx
+{
+
+/**
+ * Exact round(t / 255) for t <= 255 * 255, the rounding shared by every kernel
+ */
+static inline uint32_t pixelDiv255(uint32_t t)
+{
+    t += 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+#if GXX_PIXEL_SSE2
+
+static inline __m128i sse2Div255(__m128i t)
+{
+    t = _mm_add_epi16(t, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+#endif
+
+#if GXX_PIXEL_AVX2
+
+GXX_TARGET_AVX2 static inline __m256i avx2Div255(__m256i t)
+{
+    t = _mm256_add_epi16(t, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+#endif
+
+#if GXX_PIXEL_NEON
+
+/**
+ * round(c * a / 255) for 16 channels
+ */
+static inline uint8x16_t neonMulDiv255(uint8x16_t c, uint8x16_t a)
+{
+    // (t + 128 + ((t + 128) >> 8)) >> 8, the same rounding as pixelDiv255
+    const uint16x8_t lo = vmull_u8(vget_low_u8(c), vget_low_u8(a));
+    const uint16x8_t hi = vmull_u8(vget_high_u8(c), vget_high_u8(a));
+    return vcombine_u8(vrshrn_n_u16(vrsraq_n_u16(lo, lo, 8), 8),
+                       vrshrn_n_u16(vrsraq_n_u16(hi, hi, 8), 8));
+}
+
+#endif
+
+}
+
+#endif //GXX_PIXEL_SIMD_H
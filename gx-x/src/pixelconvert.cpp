@@ -0,0 +1,761 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/pixelconvert.h"
+
+#include <atomic>
+#include <algorithm>
+#include <memory.h>
+
+#include "pixel_simd.h"
+
+
+namespace gxx
+{
+
+using ConvertFunc = void (*)(const uint8_t *src, uint8_t *dst, uint64_t count);
+
+struct ConvertKernels
+{
+    PixelConvert::Kernel::Enum kernel;
+    ConvertFunc rgbToRgba;
+    ConvertFunc rgbaToRgb;
+    ConvertFunc greyToRgba;
+    ConvertFunc greyAlphaToRgba;
+    ConvertFunc swapRedBlue;
+    ConvertFunc premultiply;
+    ConvertFunc unpremultiply;
+    ConvertFunc premultiplySwapRedBlue;
+};
+
+
+/** ==== Scalar ==== **/
+
+static void scalarRgbToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 3, dst += 4) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+        dst[3] = 0xff;
+    }
+}
+
+static void scalarRgbaToRgb(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 4, dst += 3) {
+        dst[0] = src[0];
+        dst[1] = src[1];
+        dst[2] = src[2];
+    }
+}
+
+static void scalarGreyToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, dst += 4) {
+        dst[0] = dst[1] = dst[2] = src[i];
+        dst[3] = 0xff;
+    }
+}
+
+static void scalarGreyAlphaToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 2, dst += 4) {
+        const uint8_t g = src[0];
+        const uint8_t a = src[1];
+        dst[0] = dst[1] = dst[2] = g;
+        dst[3] = a;
+    }
+}
+
+static void scalarSwapRedBlue(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 4, dst += 4) {
+        const uint8_t r = src[0];
+        const uint8_t b = src[2];
+        dst[0] = b;
+        dst[1] = src[1];
+        dst[2] = r;
+        dst[3] = src[3];
+    }
+}
+
+static void scalarPremultiply(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 4, dst += 4) {
+        const uint32_t a = src[3];
+        dst[0] = (uint8_t) pixelDiv255(src[0] * a);
+        dst[1] = (uint8_t) pixelDiv255(src[1] * a);
+        dst[2] = (uint8_t) pixelDiv255(src[2] * a);
+        dst[3] = (uint8_t) a;
+    }
+}
+
+static void scalarUnpremultiply(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 4, dst += 4) {
+        const uint32_t a = src[3];
+        if (a == 0) {
+            dst[0] = dst[1] = dst[2] = dst[3] = 0;
+            continue;
+        }
+        for (int c = 0; c < 3; c++) {
+            const uint32_t v = std::min<uint32_t>(src[c], a);
+            dst[c] = (uint8_t) ((v * 255 + a / 2) / a);
+        }
+        dst[3] = (uint8_t) a;
+    }
+}
+
+static void scalarPremultiplySwapRedBlue(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++, src += 4, dst += 4) {
+        const uint32_t a = src[3];
+        const uint8_t r = (uint8_t) pixelDiv255(src[0] * a);
+        const uint8_t g = (uint8_t) pixelDiv255(src[1] * a);
+        const uint8_t b = (uint8_t) pixelDiv255(src[2] * a);
+        dst[0] = b;
+        dst[1] = g;
+        dst[2] = r;
+        dst[3] = (uint8_t) a;
+    }
+}
+
+static const ConvertKernels sScalarKernels = {
+        PixelConvert::Kernel::Scalar,
+        scalarRgbToRgba,
+        scalarRgbaToRgb,
+        scalarGreyToRgba,
+        scalarGreyAlphaToRgba,
+        scalarSwapRedBlue,
+        scalarPremultiply,
+        scalarUnpremultiply,
+        scalarPremultiplySwapRedBlue,
+};
+
+
+#if GXX_PIXEL_SSE2
+
+/** ==== SSE2 ==== **/
+
+static inline __m128i sse2SwapRedBlue(__m128i v)
+{
+    const __m128i ga = _mm_set1_epi32((int) 0xff00ff00);
+    const __m128i low = _mm_set1_epi32(0xff);
+    const __m128i r = _mm_and_si128(v, low);
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+    return _mm_or_si128(_mm_and_si128(v, ga), _mm_or_si128(_mm_slli_epi32(r, 16), b));
+}
+
+/**
+ * Two pixels widened to 16 bits per channel
+ */
+static inline __m128i sse2Premultiply16(__m128i v)
+{
+    __m128i a = _mm_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    return sse2Div255(_mm_mullo_epi16(v, a));
+}
+
+static inline __m128i sse2Premultiply(__m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+    const __m128i lo = sse2Premultiply16(_mm_unpacklo_epi8(v, zero));
+    const __m128i hi = sse2Premultiply16(_mm_unpackhi_epi8(v, zero));
+    const __m128i color = _mm_packus_epi16(lo, hi);
+    return _mm_or_si128(_mm_andnot_si128(alpha, color), _mm_and_si128(v, alpha));
+}
+
+/**
+ * One pixel as 4 x int32 (r, g, b, a)
+ */
+static inline __m128i sse2Unpremultiply32(__m128i p)
+{
+    const __m128 f = _mm_cvtepi32_ps(p);
+    const __m128 a = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 3, 3, 3));
+    const __m128 c = _mm_min_ps(f, a);
+    __m128 q = _mm_add_ps(_mm_div_ps(_mm_mul_ps(c, _mm_set1_ps(255.0f)), a), _mm_set1_ps(0.5f));
+    q = _mm_and_ps(q, _mm_cmpneq_ps(a, _mm_setzero_ps()));
+    return _mm_cvttps_epi32(q);
+}
+
+static inline __m128i sse2Unpremultiply(__m128i v)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    const __m128i p01 = _mm_packs_epi32(sse2Unpremultiply32(_mm_unpacklo_epi16(lo, zero)),
+                                        sse2Unpremultiply32(_mm_unpackhi_epi16(lo, zero)));
+    const __m128i p23 = _mm_packs_epi32(sse2Unpremultiply32(_mm_unpacklo_epi16(hi, zero)),
+                                        sse2Unpremultiply32(_mm_unpackhi_epi16(hi, zero)));
+    const __m128i color = _mm_packus_epi16(p01, p23);
+    return _mm_or_si128(_mm_andnot_si128(alpha, color), _mm_and_si128(v, alpha));
+}
+
+static void sse2GreyToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m128i opaque = _mm_set1_epi8((char) 0xff);
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i g = _mm_loadu_si128((const __m128i *) (src + i));
+        const __m128i ggLo = _mm_unpacklo_epi8(g, g);
+        const __m128i ggHi = _mm_unpackhi_epi8(g, g);
+        const __m128i gaLo = _mm_unpacklo_epi8(g, opaque);
+        const __m128i gaHi = _mm_unpackhi_epi8(g, opaque);
+        auto *out = (__m128i *) (dst + i * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(ggLo, gaLo));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(ggLo, gaLo));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(ggHi, gaHi));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(ggHi, gaHi));
+    }
+    scalarGreyToRgba(src + i, dst + i * 4, count - i);
+}
+
+static void sse2GreyAlphaToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m128i low = _mm_set1_epi16(0xff);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i ga = _mm_loadu_si128((const __m128i *) (src + i * 2));
+        const __m128i g = _mm_and_si128(ga, low);
+        const __m128i gg = _mm_or_si128(g, _mm_slli_epi16(g, 8));
+        auto *out = (__m128i *) (dst + i * 4);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(gg, ga));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(gg, ga));
+    }
+    scalarGreyAlphaToRgba(src + i * 2, dst + i * 4, count - i);
+}
+
+static void sse2SwapRedBlueSpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), sse2SwapRedBlue(v));
+    }
+    scalarSwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+static void sse2PremultiplySpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), sse2Premultiply(v));
+    }
+    scalarPremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+static void sse2UnpremultiplySpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), sse2Unpremultiply(v));
+    }
+    scalarUnpremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+static void sse2PremultiplySwapRedBlueSpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) (src + i * 4));
+        _mm_storeu_si128((__m128i *) (dst + i * 4), sse2SwapRedBlue(sse2Premultiply(v)));
+    }
+    scalarPremultiplySwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+// SSE2 has no byte shuffle, the 3 byte conversions stay scalar
+static const ConvertKernels sSse2Kernels = {
+        PixelConvert::Kernel::SSE2,
+        scalarRgbToRgba,
+        scalarRgbaToRgb,
+        sse2GreyToRgba,
+        sse2GreyAlphaToRgba,
+        sse2SwapRedBlueSpan,
+        sse2PremultiplySpan,
+        sse2UnpremultiplySpan,
+        sse2PremultiplySwapRedBlueSpan,
+};
+
+#endif
+
+
+#if GXX_PIXEL_AVX2
+
+/** ==== AVX2 ==== **/
+
+GXX_TARGET_AVX2 static inline __m256i avx2Premultiply16(__m256i v)
+{
+    __m256i a = _mm256_shufflelo_epi16(v, _MM_SHUFFLE(3, 3, 3, 3));
+    a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+    return avx2Div255(_mm256_mullo_epi16(v, a));
+}
+
+GXX_TARGET_AVX2 static inline __m256i avx2Premultiply(__m256i v)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i alpha = _mm256_set1_epi32((int) 0xff000000);
+    const __m256i lo = avx2Premultiply16(_mm256_unpacklo_epi8(v, zero));
+    const __m256i hi = avx2Premultiply16(_mm256_unpackhi_epi8(v, zero));
+    const __m256i color = _mm256_packus_epi16(lo, hi);
+    return _mm256_blendv_epi8(color, v, alpha);
+}
+
+GXX_TARGET_AVX2 static inline __m256i avx2SwapRedBlue(__m256i v)
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                             2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    return _mm256_shuffle_epi8(v, shuffle);
+}
+
+/**
+ * 8 pixels as 8 x float of one channel
+ */
+GXX_TARGET_AVX2 static inline __m256i avx2Unpremultiply32(__m256i c, __m256 a)
+{
+    const __m256 f = _mm256_min_ps(_mm256_cvtepi32_ps(c), a);
+    __m256 q = _mm256_add_ps(_mm256_div_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)), a), _mm256_set1_ps(0.5f));
+    q = _mm256_and_ps(q, _mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+    return _mm256_cvttps_epi32(q);
+}
+
+GXX_TARGET_AVX2 static void avx2RgbToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                             0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i opaque = _mm256_set1_epi32((int) 0xff000000);
+    uint64_t i = 0;
+    // Each 16 byte load reads 4 bytes past the 4 pixels it converts
+    for (; (i + 8) * 3 + 4 <= count * 3; i += 8) {
+        const __m128i lo = _mm_loadu_si128((const __m128i *) (src + i * 3));
+        const __m128i hi = _mm_loadu_si128((const __m128i *) (src + i * 3 + 12));
+        const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), opaque));
+    }
+    scalarRgbToRgba(src + i * 3, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2RgbaToRgb(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                             0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    uint64_t i = 0;
+    // Each 16 byte store writes 4 bytes past its 4 pixels, they are overwritten by the next store
+    for (; (i + 8) * 3 + 4 <= count * 3; i += 8) {
+        const __m256i v = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (src + i * 4)), shuffle);
+        _mm_storeu_si128((__m128i *) (dst + i * 3), _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i *) (dst + i * 3 + 12), _mm256_extracti128_si256(v, 1));
+    }
+    scalarRgbaToRgb(src + i * 4, dst + i * 3, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2GreyToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m256i opaque = _mm256_set1_epi32((int) 0xff000000);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i g = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (src + i)));
+        const __m256i rgb = _mm256_mullo_epi32(g, _mm256_set1_epi32(0x010101));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_or_si256(rgb, opaque));
+    }
+    scalarGreyToRgba(src + i, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2GreyAlphaToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7,
+                                             0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i ga = _mm_loadu_si128((const __m128i *) (src + i * 2));
+        const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(ga), _mm_srli_si128(ga, 8), 1);
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_shuffle_epi8(v, shuffle));
+    }
+    scalarGreyAlphaToRgba(src + i * 2, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2SwapRedBlueSpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), avx2SwapRedBlue(v));
+    }
+    scalarSwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2PremultiplySpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), avx2Premultiply(v));
+    }
+    scalarPremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2UnpremultiplySpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    const __m256i low = _mm256_set1_epi32(0xff);
+    const __m256i alphaMask = _mm256_set1_epi32((int) 0xff000000);
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        const __m256 a = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 24));
+        const __m256i r = avx2Unpremultiply32(_mm256_and_si256(v, low), a);
+        const __m256i g = avx2Unpremultiply32(_mm256_and_si256(_mm256_srli_epi32(v, 8), low), a);
+        const __m256i b = avx2Unpremultiply32(_mm256_and_si256(_mm256_srli_epi32(v, 16), low), a);
+        const __m256i rgb = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 8), _mm256_slli_epi32(b, 16)));
+        // A zero alpha gives zero colour channels
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), _mm256_or_si256(rgb, _mm256_and_si256(v, alphaMask)));
+    }
+    scalarUnpremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+GXX_TARGET_AVX2 static void avx2PremultiplySwapRedBlueSpan(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) (src + i * 4));
+        _mm256_storeu_si256((__m256i *) (dst + i * 4), avx2SwapRedBlue(avx2Premultiply(v)));
+    }
+    scalarPremultiplySwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+static const ConvertKernels sAvx2Kernels = {
+        PixelConvert::Kernel::AVX2,
+        avx2RgbToRgba,
+        avx2RgbaToRgb,
+        avx2GreyToRgba,
+        avx2GreyAlphaToRgba,
+        avx2SwapRedBlueSpan,
+        avx2PremultiplySpan,
+        avx2UnpremultiplySpan,
+        avx2PremultiplySwapRedBlueSpan,
+};
+
+static bool cpuSupportsAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+
+#if GXX_PIXEL_NEON
+
+/** ==== NEON ==== **/
+
+static void neonRgbToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(0xff);
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    scalarRgbToRgba(src + i * 3, dst + i * 4, count - i);
+}
+
+static void neonRgbaToRgb(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x4_t rgba = vld4q_u8(src + i * 4);
+        uint8x16x3_t rgb;
+        rgb.val[0] = rgba.val[0];
+        rgb.val[1] = rgba.val[1];
+        rgb.val[2] = rgba.val[2];
+        vst3q_u8(dst + i * 3, rgb);
+    }
+    scalarRgbaToRgb(src + i * 4, dst + i * 3, count - i);
+}
+
+static void neonGreyToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16_t g = vld1q_u8(src + i);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgba.val[1] = rgba.val[2] = g;
+        rgba.val[3] = vdupq_n_u8(0xff);
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    scalarGreyToRgba(src + i, dst + i * 4, count - i);
+}
+
+static void neonGreyAlphaToRgba(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16x2_t ga = vld2q_u8(src + i * 2);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgba.val[1] = rgba.val[2] = ga.val[0];
+        rgba.val[3] = ga.val[1];
+        vst4q_u8(dst + i * 4, rgba);
+    }
+    scalarGreyAlphaToRgba(src + i * 2, dst + i * 4, count - i);
+}
+
+static void neonSwapRedBlue(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        const uint8x16_t r = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = r;
+        vst4q_u8(dst + i * 4, v);
+    }
+    scalarSwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+static void neonPremultiply(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        v.val[0] = neonMulDiv255(v.val[0], v.val[3]);
+        v.val[1] = neonMulDiv255(v.val[1], v.val[3]);
+        v.val[2] = neonMulDiv255(v.val[2], v.val[3]);
+        vst4q_u8(dst + i * 4, v);
+    }
+    scalarPremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+static void neonPremultiplySwapRedBlue(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        const uint8x16_t r = neonMulDiv255(v.val[0], v.val[3]);
+        v.val[1] = neonMulDiv255(v.val[1], v.val[3]);
+        v.val[0] = neonMulDiv255(v.val[2], v.val[3]);
+        v.val[2] = r;
+        vst4q_u8(dst + i * 4, v);
+    }
+    scalarPremultiplySwapRedBlue(src + i * 4, dst + i * 4, count - i);
+}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+static inline uint32x4_t neonUnpremultiply32(uint32x4_t c, uint32x4_t a)
+{
+    const float32x4_t af = vcvtq_f32_u32(a);
+    const float32x4_t q = vaddq_f32(vdivq_f32(vmulq_n_f32(vcvtq_f32_u32(c), 255.0f), af), vdupq_n_f32(0.5f));
+    return vandq_u32(vcvtq_u32_f32(q), vmvnq_u32(vceqq_u32(a, vdupq_n_u32(0))));
+}
+
+static inline uint16x8_t neonUnpremultiply16(uint16x8_t c, uint16x8_t a)
+{
+    const uint32x4_t lo = neonUnpremultiply32(vmovl_u16(vget_low_u16(c)), vmovl_u16(vget_low_u16(a)));
+    const uint32x4_t hi = neonUnpremultiply32(vmovl_u16(vget_high_u16(c)), vmovl_u16(vget_high_u16(a)));
+    return vcombine_u16(vmovn_u32(lo), vmovn_u32(hi));
+}
+
+static inline uint8x16_t neonUnpremultiply(uint8x16_t c, uint8x16_t a)
+{
+    c = vminq_u8(c, a);
+    const uint16x8_t lo = neonUnpremultiply16(vmovl_u8(vget_low_u8(c)), vmovl_u8(vget_low_u8(a)));
+    const uint16x8_t hi = neonUnpremultiply16(vmovl_u8(vget_high_u8(c)), vmovl_u8(vget_high_u8(a)));
+    return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static void neonUnpremultiply(const uint8_t *src, uint8_t *dst, uint64_t count)
+{
+    uint64_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        v.val[0] = neonUnpremultiply(v.val[0], v.val[3]);
+        v.val[1] = neonUnpremultiply(v.val[1], v.val[3]);
+        v.val[2] = neonUnpremultiply(v.val[2], v.val[3]);
+        vst4q_u8(dst + i * 4, v);
+    }
+    scalarUnpremultiply(src + i * 4, dst + i * 4, count - i);
+}
+
+#else
+
+// 32-bit ARM has no vector division
+#define neonUnpremultiply scalarUnpremultiply
+
+#endif
+
+static const ConvertKernels sNeonKernels = {
+        PixelConvert::Kernel::NEON,
+        neonRgbToRgba,
+        neonRgbaToRgb,
+        neonGreyToRgba,
+        neonGreyAlphaToRgba,
+        neonSwapRedBlue,
+        neonPremultiply,
+        neonUnpremultiply,
+        neonPremultiplySwapRedBlue,
+};
+
+#endif
+
+
+/** ==== Dispatch ==== **/
+
+static const ConvertKernels *kernelsOf(PixelConvert::Kernel::Enum kernel)
+{
+    switch (kernel) {
+        case PixelConvert::Kernel::Scalar:
+            return &sScalarKernels;
+#if GXX_PIXEL_SSE2
+        case PixelConvert::Kernel::SSE2:
+            return &sSse2Kernels;
+#endif
+#if GXX_PIXEL_AVX2
+        case PixelConvert::Kernel::AVX2:
+            return cpuSupportsAvx2() ? &sAvx2Kernels : nullptr;
+#endif
+#if GXX_PIXEL_NEON
+        case PixelConvert::Kernel::NEON:
+            return &sNeonKernels;
+#endif
+        default:
+            return nullptr;
+    }
+}
+
+static const ConvertKernels *bestKernels()
+{
+    static const ConvertKernels *best = kernelsOf(PixelConvert::bestKernel());
+    return best;
+}
+
+static std::atomic<const ConvertKernels *> sKernels{nullptr};
+
+static inline const ConvertKernels &kernels()
+{
+    const ConvertKernels *k = sKernels.load(std::memory_order_relaxed);
+    if (!k) {
+        k = bestKernels();
+        sKernels.store(k, std::memory_order_relaxed);
+    }
+    return *k;
+}
+
+PixelConvert::Kernel::Enum PixelConvert::bestKernel()
+{
+#if GXX_PIXEL_AVX2
+    if (cpuSupportsAvx2()) {
+        return Kernel::AVX2;
+    }
+#endif
+#if GXX_PIXEL_SSE2
+    return Kernel::SSE2;
+#elif GXX_PIXEL_NEON
+    return Kernel::NEON;
+#else
+    return Kernel::Scalar;
+#endif
+}
+
+PixelConvert::Kernel::Enum PixelConvert::kernel()
+{
+    return kernels().kernel;
+}
+
+bool PixelConvert::setKernel(Kernel::Enum kernel)
+{
+    const ConvertKernels *k = kernelsOf(kernel);
+    if (!k) {
+        return false;
+    }
+    sKernels.store(k, std::memory_order_relaxed);
+    return true;
+}
+
+void PixelConvert::rgbToRgba(const Rgb *src, Rgba *dst, uint64_t count)
+{
+    kernels().rgbToRgba((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::rgbaToRgb(const Rgba *src, Rgb *dst, uint64_t count)
+{
+    kernels().rgbaToRgb((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::greyToRgba(const Grey *src, Rgba *dst, uint64_t count)
+{
+    kernels().greyToRgba(src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::greyAlphaToRgba(const GreyAlpha *src, Rgba *dst, uint64_t count)
+{
+    kernels().greyAlphaToRgba((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::rgbaToBgra(const Rgba *src, Bgra *dst, uint64_t count)
+{
+    kernels().swapRedBlue((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::bgraToRgba(const Bgra *src, Rgba *dst, uint64_t count)
+{
+    kernels().swapRedBlue((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::premultiply(const Rgba *src, Rgba *dst, uint64_t count)
+{
+    kernels().premultiply((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::unpremultiply(const Rgba *src, Rgba *dst, uint64_t count)
+{
+    kernels().unpremultiply((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+void PixelConvert::premultiplyToBgra(const Rgba *src, Bgra *dst, uint64_t count)
+{
+    kernels().premultiplySwapRedBlue((const uint8_t *) src, (uint8_t *) dst, count);
+}
+
+}
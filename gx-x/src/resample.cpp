@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gxx/resample.h"
+#include "gxx/pixelconvert.h"
+
+#include "parallel_rows.h"
+#include "pixel_simd.h"
+
+#include <cmath>
+#include <vector>
+
+
+namespace gxx
+{
+
+/**
+ * Filtered source indices of every output index along one axis,
+ * output i reads taps source pixels from first[i] on with weights[i * taps ...], unused taps weigh zero
+ */
+struct Contributions
+{
+    uint32_t taps = 0;
+    std::vector<uint32_t> first;
+    std::vector<float> weights;
+};
+
+using HorizontalFunc = void (*)(float *dst, const float *src, uint32_t dstWidth,
+                                const uint32_t *first, const float *weights, uint32_t taps);
+using VerticalFunc = void (*)(float *dst, const float *const *rows, const float *weights, uint32_t taps,
+                              uint32_t count);
+
+
+/** ==== Filters ==== **/
+
+static float filterSupport(Resample::Filter::Enum filter)
+{
+    switch (filter) {
+        case Resample::Filter::Box:
+            return 0.5f;
+        case Resample::Filter::Lanczos3:
+            return 3.0f;
+        case Resample::Filter::Bilinear:
+        default:
+            return 1.0f;
+    }
+}
+
+static constexpr const double kPi = 3.14159265358979323846;
+
+static double filterWeight(Resample::Filter::Enum filter, double x)
+{
+    x = std::fabs(x);
+    if (filter == Resample::Filter::Lanczos3) {
+        if (x < 1e-8) {
+            return 1.0;
+        }
+        if (x >= 3.0) {
+            return 0.0;
+        }
+        const double px = kPi * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+    return std::max(0.0, 1.0 - x);
+}
+
+static Contributions makeContributions(uint32_t srcSize, uint32_t dstSize, Resample::Filter::Enum filter)
+{
+    // Widen the filter by the downscale factor so it covers every source pixel of an output pixel
+    const double scale = (double) srcSize / dstSize;
+    const double filterScale = std::max(1.0, scale);
+    const double support = filterSupport(filter) * filterScale;
+
+    Contributions c;
+    c.taps = std::min<uint32_t>((uint32_t) std::ceil(support * 2.0) + 1, srcSize);
+    c.first.resize(dstSize);
+    c.weights.assign((size_t) dstSize * c.taps, 0.0f);
+
+    std::vector<double> weights(c.taps);
+    for (uint32_t i = 0; i < dstSize; i++) {
+        const double center = (i + 0.5) * scale;
+        const auto left = (int64_t) std::floor(center - support);
+        const auto right = (int64_t) std::ceil(center + support);
+        const auto first = (uint32_t) std::min<int64_t>(std::max<int64_t>(left, 0), srcSize - c.taps);
+
+        std::fill(weights.begin(), weights.end(), 0.0);
+        double sum = 0.0;
+        for (int64_t j = left; j <= right; j++) {
+            double w;
+            if (filter == Resample::Filter::Box) {
+                // Coverage of source pixel j by the footprint of the output pixel, an exact area average
+                w = std::min<double>(j + 1, center + support) - std::max<double>(j, center - support);
+            } else {
+                w = filterWeight(filter, (j + 0.5 - center) / filterScale);
+            }
+            // Lanczos lobes weigh negative, a box only covers or misses
+            if (filter == Resample::Filter::Box ? w <= 0.0 : w == 0.0) {
+                continue;
+            }
+            // Edge pixels stand in for the pixels outside the image
+            const auto k = (uint32_t) std::min<int64_t>(std::max<int64_t>(j, 0), srcSize - 1);
+            weights[k - first] += w;
+            sum += w;
+        }
+        if (sum == 0.0) {
+            weights[0] = sum = 1.0;
+        }
+
+        c.first[i] = first;
+        for (uint32_t t = 0; t < c.taps; t++) {
+            c.weights[(size_t) i * c.taps + t] = (float) (weights[t] / sum);
+        }
+    }
+    return c;
+}
+
+
+/** ==== Light ==== **/
+
+/**
+ * Byte to filter space and back, linear light tables decode and encode sRGB
+ */
+struct LightTables
+{
+    static constexpr const uint32_t kEncodeSize = 16384;
+
+    float decode[256];
+    uint8_t encode[kEncodeSize];
+
+    explicit LightTables(bool linearLight)
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            const double v = i / 255.0;
+            decode[i] = (float) (!linearLight ? v : v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+        }
+        for (uint32_t i = 0; i < kEncodeSize; i++) {
+            const double v = (double) i / (kEncodeSize - 1);
+            const double e = !linearLight ? v : v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+            encode[i] = (uint8_t) std::lround(std::min(1.0, std::max(0.0, e)) * 255.0);
+        }
+    }
+
+    static const LightTables &get(bool linearLight)
+    {
+        static const LightTables gamma(false);
+        static const LightTables linear(true);
+        return linearLight ? linear : gamma;
+    }
+};
+
+/**
+ * Straight alpha bytes to alpha weighted floats in [0, 1]
+ */
+static void decodeRow(float *dst, const uint8_t *src, uint32_t width, const LightTables &light)
+{
+    for (uint32_t i = 0; i < width; i++, src += 4, dst += 4) {
+        // Alpha is linear coverage in either space
+        const float a = src[3] * (1.0f / 255.0f);
+        dst[0] = light.decode[src[0]] * a;
+        dst[1] = light.decode[src[1]] * a;
+        dst[2] = light.decode[src[2]] * a;
+        dst[3] = a;
+    }
+}
+
+static void encodeRow(uint8_t *dst, const float *src, uint32_t width, const LightTables &light)
+{
+    constexpr float kEncodeMax = LightTables::kEncodeSize - 1;
+    for (uint32_t i = 0; i < width; i++, src += 4, dst += 4) {
+        // Lanczos lobes overshoot, clamp before dividing out alpha
+        const float a = std::min(1.0f, src[3]);
+        if (a < 0.5f / 255.0f) {
+            dst[0] = dst[1] = dst[2] = dst[3] = 0;
+            continue;
+        }
+        const float scale = kEncodeMax / a;
+        for (int c = 0; c < 3; c++) {
+            const float v = std::min(kEncodeMax, std::max(0.0f, src[c] * scale));
+            dst[c] = light.encode[(uint32_t) (v + 0.5f)];
+        }
+        dst[3] = (uint8_t) (a * 255.0f + 0.5f);
+    }
+}
+
+
+/** ==== Scalar ==== **/
+
+static void scalarHorizontal(float *dst, const float *src, uint32_t dstWidth,
+                             const uint32_t *first, const float *weights, uint32_t taps)
+{
+    for (uint32_t x = 0; x < dstWidth; x++, dst += 4, weights += taps) {
+        const float *s = src + (size_t) first[x] * 4;
+        float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (uint32_t t = 0; t < taps; t++, s += 4) {
+            for (int c = 0; c < 4; c++) {
+                acc[c] += s[c] * weights[t];
+            }
+        }
+        memcpy(dst, acc, sizeof(acc));
+    }
+}
+
+static void scalarVertical(float *dst, const float *const *rows, const float *weights, uint32_t taps,
+                           uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        float acc = 0.0f;
+        for (uint32_t t = 0; t < taps; t++) {
+            acc += rows[t][i] * weights[t];
+        }
+        dst[i] = acc;
+    }
+}
+
+
+/** ==== SSE2 ==== **/
+
+#if GXX_PIXEL_SSE2
+
+// A float pixel is one register, taps accumulate with one multiply-add each
+static void sse2Horizontal(float *dst, const float *src, uint32_t dstWidth,
+                           const uint32_t *first, const float *weights, uint32_t taps)
+{
+    for (uint32_t x = 0; x < dstWidth; x++, dst += 4, weights += taps) {
+        const float *s = src + (size_t) first[x] * 4;
+        __m128 acc = _mm_setzero_ps();
+        for (uint32_t t = 0; t < taps; t++, s += 4) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s), _mm_set1_ps(weights[t])));
+        }
+        _mm_storeu_ps(dst, acc);
+    }
+}
+
+static void sse2Vertical(float *dst, const float *const *rows, const float *weights, uint32_t taps,
+                         uint32_t count)
+{
+    // count is a multiple of 4, one float pixel per register
+    for (uint32_t i = 0; i < count; i += 4) {
+        __m128 acc = _mm_setzero_ps();
+        for (uint32_t t = 0; t < taps; t++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[t] + i), _mm_set1_ps(weights[t])));
+        }
+        _mm_storeu_ps(dst + i, acc);
+    }
+}
+
+#endif
+
+
+/** ==== AVX2 ==== **/
+
+#if GXX_PIXEL_AVX2
+
+// The horizontal pass gathers one pixel per tap and stays on SSE2, the vertical pass runs two pixels per register
+GXX_TARGET_AVX2 static void avx2Vertical(float *dst, const float *const *rows, const float *weights, uint32_t taps,
+                                         uint32_t count)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (uint32_t t = 0; t < taps; t++) {
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(rows[t] + i), _mm256_set1_ps(weights[t])));
+        }
+        _mm256_storeu_ps(dst + i, acc);
+    }
+    if (i < count) {
+        __m128 acc = _mm_setzero_ps();
+        for (uint32_t t = 0; t < taps; t++) {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[t] + i), _mm_set1_ps(weights[t])));
+        }
+        _mm_storeu_ps(dst + i, acc);
+    }
+}
+
+#endif
+
+
+/** ==== NEON ==== **/
+
+#if GXX_PIXEL_NEON
+
+static void neonHorizontal(float *dst, const float *src, uint32_t dstWidth,
+                           const uint32_t *first, const float *weights, uint32_t taps)
+{
+    for (uint32_t x = 0; x < dstWidth; x++, dst += 4, weights += taps) {
+        const float *s = src + (size_t) first[x] * 4;
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (uint32_t t = 0; t < taps; t++, s += 4) {
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(s), weights[t]));
+        }
+        vst1q_f32(dst, acc);
+    }
+}
+
+static void neonVertical(float *dst, const float *const *rows, const float *weights, uint32_t taps,
+                         uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i += 4) {
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        for (uint32_t t = 0; t < taps; t++) {
+            acc = vaddq_f32(acc, vmulq_n_f32(vld1q_f32(rows[t] + i), weights[t]));
+        }
+        vst1q_f32(dst + i, acc);
+    }
+}
+
+#endif
+
+
+/** ==== Dispatch ==== **/
+
+static HorizontalFunc horizontalKernel()
+{
+    switch (PixelConvert::kernel()) {
+#if GXX_PIXEL_SSE2
+        case PixelConvert::Kernel::SSE2:
+        case PixelConvert::Kernel::AVX2:
+            return sse2Horizontal;
+#endif
+#if GXX_PIXEL_NEON
+        case PixelConvert::Kernel::NEON:
+            return neonHorizontal;
+#endif
+        default:
+            return scalarHorizontal;
+    }
+}
+
+static VerticalFunc verticalKernel()
+{
+    switch (PixelConvert::kernel()) {
+#if GXX_PIXEL_SSE2
+        case PixelConvert::Kernel::SSE2:
+            return sse2Vertical;
+#endif
+#if GXX_PIXEL_AVX2
+        case PixelConvert::Kernel::AVX2:
+            return avx2Vertical;
+#endif
+#if GXX_PIXEL_NEON
+        case PixelConvert::Kernel::NEON:
+            return neonVertical;
+#endif
+        default:
+            return scalarVertical;
+    }
+}
+
+void Resample::resampleRows(unsigned char *dst, uint32_t dstWidth, uint32_t dstHeight, uint32_t dstBytesPerLine,
+                            const unsigned char *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcBytesPerLine,
+                            Filter::Enum filter, bool linearLight)
+{
+    if (dstWidth == srcWidth && dstHeight == srcHeight) {
+        // Every filter is the identity at scale 1
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            memcpy(dst + (uint64_t) dstBytesPerLine * y, src + (uint64_t) srcBytesPerLine * y, (size_t) dstWidth * 4);
+        }
+        return;
+    }
+
+    const LightTables &light = LightTables::get(linearLight);
+    const Contributions columns = makeContributions(srcWidth, dstWidth, filter);
+    const Contributions rows = makeContributions(srcHeight, dstHeight, filter);
+    const HorizontalFunc horizontal = horizontalKernel();
+    const VerticalFunc vertical = verticalKernel();
+
+    // Horizontal pass, every source row filtered to the destination width
+    const size_t tempLine = (size_t) dstWidth * 4;
+    std::vector<float> temp(tempLine * srcHeight);
+    parallelRows(srcHeight, parallelRowsMinBand(std::max(srcWidth, dstWidth)), [&](uint32_t begin, uint32_t end) {
+        std::vector<float> line((size_t) srcWidth * 4);
+        for (uint32_t y = begin; y < end; y++) {
+            decodeRow(line.data(), src + (uint64_t) srcBytesPerLine * y, srcWidth, light);
+            horizontal(temp.data() + tempLine * y, line.data(), dstWidth,
+                       columns.first.data(), columns.weights.data(), columns.taps);
+        }
+    });
+
+    // Vertical pass, destination rows from the filtered rows
+    parallelRows(dstHeight, parallelRowsMinBand(dstWidth), [&](uint32_t begin, uint32_t end) {
+        std::vector<float> line(tempLine);
+        std::vector<const float *> taps(rows.taps);
+        for (uint32_t y = begin; y < end; y++) {
+            for (uint32_t t = 0; t < rows.taps; t++) {
+                taps[t] = temp.data() + tempLine * (rows.first[y] + t);
+            }
+            vertical(line.data(), taps.data(), rows.weights.data() + (size_t) y * rows.taps, rows.taps,
+                     (uint32_t) tempLine);
+            encodeRow(dst + (uint64_t) dstBytesPerLine * y, line.data(), dstWidth, light);
+        }
+    });
+}
+
+}
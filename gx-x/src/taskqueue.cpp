@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "gxx/taskqueue.h"
+
+
+namespace gxx
+{
+
+static size_t roundUpPowerOfTwo(uint32_t v)
+{
+    size_t n = 2;
+    while (n < v) {
+        n <<= 1;
+    }
+    return n;
+}
+
+TaskQueue::TaskQueue(uint32_t capacity)
+{
+    const size_t count = roundUpPowerOfTwo(capacity);
+    mSlots.reset(new Slot[count]);
+    mMask = count - 1;
+    for (size_t i = 0; i < count; i++) {
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+TaskQueue::~TaskQueue() = default;
+
+bool TaskQueue::push(InlineTask &&task)
+{
+    Slot *slot;
+    size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &mSlots[pos & mMask];
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = mEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->task = std::move(task);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool TaskQueue::pop(InlineTask &task)
+{
+    Slot *slot;
+    size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        slot = &mSlots[pos & mMask];
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = mDequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+    task = std::move(slot->task);
+    slot->sequence.store(pos + mMask + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t TaskQueue::capacity() const
+{
+    return (uint32_t) (mMask + 1);
+}
+
+}
@@ -183,6 +183,39 @@ void WindowContext::setCursorPosition(int32_t x, int32_t y)
     }
 }
 
+void WindowContext::setFixedTimeStep(double step, uint32_t maxSteps)
+{
+    mFixedStep = step > 0 ? step : 0;
+    mFixedMaxSteps = maxSteps > 0 ? maxSteps : 1;
+    mFixedAccumulator = 0;
+    mFixedAlpha = 0;
+}
+
+double WindowContext::getFixedTimeStep() const
+{
+    return mFixedStep;
+}
+
+uint32_t WindowContext::getFixedMaxSteps() const
+{
+    return mFixedMaxSteps;
+}
+
+double WindowContext::getFixedStepAlpha() const
+{
+    return mFixedAlpha;
+}
+
+void WindowContext::setMotionCompression(bool enable)
+{
+    mMotionCompression = enable;
+}
+
+bool WindowContext::isMotionCompression() const
+{
+    return mMotionCompression;
+}
+
 /** ======== WindowHandle ======== **/
 
 WindowHandle::WindowHandle(Window *window)
@@ -220,8 +253,11 @@ void WindowHandle::init()
 void WindowHandle::frame(bool update)
 {
     if (mRunning) {
+        const int64_t eventsStart = FrameStats::now();
         mEventMana->processEvents();
         mAppContext->processDeviceEvents();
+        const int64_t updateStart = FrameStats::now();
+        setPhaseTime(FramePhase::Events, eventsStart, updateStart);
 
         //
         double delta = 0;
@@ -231,11 +267,54 @@ void WindowHandle::frame(bool update)
         }
         mFrameTime.update();
 
-        if (!mRunning || (update && !mWindow->update(delta))) {
+        // A failed fixedUpdate skips update() but still records the phase time
+        if (!mRunning || (update && (!fixedUpdate(delta) || !mWindow->update(delta)))) {
 //            mAppContext->postExitWindow(this);
             mExited = true;
         }
+        setPhaseTime(FramePhase::Update, updateStart, FrameStats::now());
+    }
+}
+
+bool WindowHandle::fixedUpdate(double delta)
+{
+    if (mFixedStep <= 0) {
+        return true;
+    }
+
+    mFixedAccumulator += delta;
+
+    // Drop the time that cannot be caught up within maxSteps, otherwise a slow simulation
+    // makes every following frame even slower
+    const double maxAccumulated = mFixedStep * mFixedMaxSteps;
+    if (mFixedAccumulator > maxAccumulated) {
+        mFixedAccumulator = maxAccumulated;
+    }
+
+    while (mRunning && mFixedAccumulator >= mFixedStep) {
+        if (!mWindow->fixedUpdate(mFixedStep)) {
+            return false;
+        }
+        mFixedAccumulator -= mFixedStep;
     }
+
+    mFixedAlpha = mFixedAccumulator / mFixedStep;
+    return true;
+}
+
+void WindowHandle::beginFrameTiming(int64_t now)
+{
+    if (mFrameStart != 0) {
+        mFrameTiming.total = (double) (now - mFrameStart) * 1e-9;
+        mFrameStats.addFrame(mFrameTiming);
+        mFrameTiming = FrameTiming();
+    }
+    mFrameStart = now;
+}
+
+void WindowHandle::setPhaseTime(FramePhase::Enum phase, int64_t start, int64_t end)
+{
+    mFrameTiming.phases[phase] = (double) (end - start) * 1e-9;
 }
 
 void WindowHandle::destroy()
@@ -469,6 +548,59 @@ void Window::getCursorPosition(int32_t &x, int32_t &y) const
     mWinContext->getCursorPosition(x, y);
 }
 
+void Window::setFixedTimeStep(double step, uint32_t maxSteps)
+{
+    mWinContext->setFixedTimeStep(step, maxSteps);
+}
+
+double Window::fixedTimeStep() const
+{
+    return mWinContext->getFixedTimeStep();
+}
+
+double Window::fixedStepAlpha() const
+{
+    return mWinContext->getFixedStepAlpha();
+}
+
+void Window::setMotionCompression(bool enable)
+{
+    mWinContext->setMotionCompression(enable);
+}
+
+bool Window::motionCompression() const
+{
+    return mWinContext->isMotionCompression();
+}
+
+const FrameStats &Window::frameStats() const
+{
+    return std::static_pointer_cast<WindowHandle>(mWinContext)->mFrameStats;
+}
+
+void Window::setFrameHitchCallback(double budget, FrameStats::HitchCallback callback)
+{
+    std::static_pointer_cast<WindowHandle>(mWinContext)->mFrameStats.setHitchCallback(budget, std::move(callback));
+}
+
+FrameBuffer *Window::frameBuffer()
+{
+    NWindow *nw = std::static_pointer_cast<WindowHandle>(mWinContext)->mNativeWindow;
+    if (!nw || !nw->isInited()) {
+        return nullptr;
+    }
+    return nw->getFrameBuffer();
+}
+
+bool Window::presentFrameBuffer()
+{
+    NWindow *nw = std::static_pointer_cast<WindowHandle>(mWinContext)->mNativeWindow;
+    if (!nw || !nw->isInited()) {
+        return false;
+    }
+    return nw->presentFrameBuffer();
+}
+
 /** virtual functions **/
 
 void Window::init()
@@ -482,6 +614,10 @@ void Window::init()
             [this](auto &&PH1, auto &&PH2) {
                 keyReleaseEvent(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2));
             });
+    mKeyboard->setKeyRepeatEventCallback(
+            [this](auto &&PH1, auto &&PH2) {
+                keyRepeatEvent(std::forward<decltype(PH1)>(PH1), std::forward<decltype(PH2)>(PH2));
+            });
 
     mMouse = std::make_shared<Mouse>(mWinContext->mWindowId);
     mMouse->setMouseMoveEventCallback(
@@ -508,6 +644,12 @@ bool Window::update(double delta)
     return true;
 }
 
+bool Window::fixedUpdate(double step)
+{
+    GX_UNUSED(step);
+    return true;
+}
+
 void Window::resetSize(int32_t w, int32_t h)
 {
 
@@ -550,6 +692,11 @@ void Window::keyReleaseEvent(gxx::Key::Enum key, uint8_t modifier)
 
 }
 
+void Window::keyRepeatEvent(gxx::Key::Enum key, uint8_t modifier)
+{
+    keyPressEvent(key, modifier);
+}
+
 void Window::mouseMoveEvent(int32_t x, int32_t y)
 {
 
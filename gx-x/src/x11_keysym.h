@@ -0,0 +1,169 @@
+/*
+ * Copyright (c) 2024 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GXX_X11_KEYSYM_H
+#define GXX_X11_KEYSYM_H
+
+/**
+ * Keysym translation shared by the Xlib and XCB backends
+ */
+
+#define XK_MISCELLANY
+#define XK_LATIN1
+#include <X11/keysymdef.h>
+
+#include <gxx/gui.h>
+
+
+namespace gxx
+{
+
+inline Modifier::Enum x11TranslateModifier(uint32_t keysym)
+{
+    switch (keysym) {
+        case XK_Meta_L:
+        case XK_Super_L:   return Modifier::LeftMeta;
+        case XK_Meta_R:
+        case XK_Super_R:   return Modifier::RightMeta;
+        case XK_Control_L: return Modifier::LeftCtrl;
+        case XK_Control_R: return Modifier::RightCtrl;
+        case XK_Shift_L:   return Modifier::LeftShift;
+        case XK_Shift_R:   return Modifier::RightShift;
+        case XK_Alt_L:     return Modifier::LeftAlt;
+        case XK_Alt_R:     return Modifier::RightAlt;
+        default:           return Modifier::None;
+    }
+}
+
+inline Key::Enum x11TranslateKey(uint32_t keysym)
+{
+    if (keysym >= XK_a && keysym <= XK_z) {
+        return (Key::Enum) (Key::KeyA + (keysym - XK_a));
+    }
+    if (keysym >= XK_A && keysym <= XK_Z) {
+        return (Key::Enum) (Key::KeyA + (keysym - XK_A));
+    }
+    if (keysym >= XK_0 && keysym <= XK_9) {
+        return (Key::Enum) (Key::Key0 + (keysym - XK_0));
+    }
+    if (keysym >= XK_KP_0 && keysym <= XK_KP_9) {
+        return (Key::Enum) (Key::NumPad0 + (keysym - XK_KP_0));
+    }
+    if (keysym >= XK_F1 && keysym <= XK_F12) {
+        return (Key::Enum) (Key::F1 + (keysym - XK_F1));
+    }
+
+    switch (keysym) {
+        case XK_Escape:       return Key::Esc;
+        case XK_Return:
+        case XK_KP_Enter:     return Key::Return;
+        case XK_Tab:          return Key::Tab;
+        case XK_BackSpace:    return Key::Backspace;
+        case XK_space:        return Key::Space;
+        case XK_Up:           return Key::Up;
+        case XK_Down:         return Key::Down;
+        case XK_Left:         return Key::Left;
+        case XK_Right:        return Key::Right;
+        case XK_Insert:       return Key::Insert;
+        case XK_Delete:       return Key::Delete;
+        case XK_Home:         return Key::Home;
+        case XK_End:          return Key::End;
+        case XK_Page_Up:      return Key::PageUp;
+        case XK_Page_Down:    return Key::PageDown;
+        case XK_Print:        return Key::Print;
+        case XK_equal:
+        case XK_plus:
+        case XK_KP_Add:       return Key::Plus;
+        case XK_minus:
+        case XK_KP_Subtract:  return Key::Minus;
+        case XK_bracketleft:  return Key::LeftBracket;
+        case XK_bracketright: return Key::RightBracket;
+        case XK_semicolon:    return Key::Semicolon;
+        case XK_apostrophe:   return Key::Quote;
+        case XK_comma:        return Key::Comma;
+        case XK_period:       return Key::Period;
+        case XK_slash:
+        case XK_KP_Divide:    return Key::Slash;
+        case XK_backslash:    return Key::Backslash;
+        case XK_grave:        return Key::Tilde;
+        case XK_Caps_Lock:    return Key::CapsLock;
+        case XK_Num_Lock:     return Key::NumLock;
+        case XK_Menu:         return Key::Menu;
+        default:              return Key::None;
+    }
+}
+
+struct KeycodeEntry
+{
+    Key::Enum key;
+    Modifier::Enum modifier;
+};
+
+/**
+ * @param base      Keysym of the first shift level
+ * @param shifted   Keysym of the second shift level, keypad digits live there
+ */
+inline KeycodeEntry x11KeycodeEntry(uint32_t base, uint32_t shifted)
+{
+    KeycodeEntry entry;
+    entry.modifier = x11TranslateModifier(base);
+    if (shifted >= XK_KP_0 && shifted <= XK_KP_9) {
+        entry.key = x11TranslateKey(shifted);
+    } else {
+        entry.key = x11TranslateKey(base);
+    }
+    return entry;
+}
+
+/**
+ * Unicode codepoint of a keysym, 0 for keysyms that do not produce text
+ */
+inline uint32_t x11KeysymToCodepoint(uint32_t keysym)
+{
+    // Latin-1 keysyms are their own codepoints
+    if ((keysym >= 0x20 && keysym <= 0x7e) || (keysym >= 0xa0 && keysym <= 0xff)) {
+        return keysym;
+    }
+    // Directly encoded Unicode keysyms
+    if ((keysym & 0xff000000) == 0x01000000) {
+        return keysym & 0x00ffffff;
+    }
+    switch (keysym) {
+        case XK_KP_Space:    return ' ';
+        case XK_KP_Equal:    return '=';
+        case XK_KP_Multiply: return '*';
+        case XK_KP_Add:      return '+';
+        case XK_KP_Subtract: return '-';
+        case XK_KP_Decimal:  return '.';
+        case XK_KP_Divide:   return '/';
+        default:
+            break;
+    }
+    if (keysym >= XK_KP_0 && keysym <= XK_KP_9) {
+        return '0' + (keysym - XK_KP_0);
+    }
+    return 0;
+}
+
+}
+
+#endif //GXX_X11_KEYSYM_H
@@ -0,0 +1,109 @@
+//
+// PixelConvert throughput of each kernel set supported by this CPU against the scalar kernels
+//
+// Usage: BenchPixelConvert [pixels=1048576]
+//
+
+#include "bench_timer.h"
+
+#include <gxx/pixelconvert.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+using namespace gxx;
+
+static const char *kernelName(PixelConvert::Kernel::Enum kernel)
+{
+    switch (kernel) {
+        case PixelConvert::Kernel::Scalar:
+            return "Scalar";
+        case PixelConvert::Kernel::SSE2:
+            return "SSE2";
+        case PixelConvert::Kernel::AVX2:
+            return "AVX2";
+        case PixelConvert::Kernel::NEON:
+            return "NEON";
+    }
+    return "?";
+}
+
+int main(int argc, char *argv[])
+{
+    const uint64_t count = argc > 1 ? (uint64_t) std::max(1, atoi(argv[1])) : 1024 * 1024;
+
+    std::vector<uint8_t> src(count * 4);
+    std::vector<uint8_t> dst(count * 4);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = (uint8_t) (i * 131 + 7);
+    }
+
+    struct Case
+    {
+        const char *name;
+        void (*run)(const uint8_t *src, uint8_t *dst, uint64_t count);
+    } cases[] = {
+            {"rgbToRgba",         [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::rgbToRgba((const Rgb *) s, (Rgba *) d, n);
+            }},
+            {"rgbaToRgb",         [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::rgbaToRgb((const Rgba *) s, (Rgb *) d, n);
+            }},
+            {"greyToRgba",        [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::greyToRgba((const Grey *) s, (Rgba *) d, n);
+            }},
+            {"greyAlphaToRgba",   [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::greyAlphaToRgba((const GreyAlpha *) s, (Rgba *) d, n);
+            }},
+            {"rgbaToBgra",        [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::rgbaToBgra((const Rgba *) s, (Bgra *) d, n);
+            }},
+            {"premultiply",       [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::premultiply((const Rgba *) s, (Rgba *) d, n);
+            }},
+            {"unpremultiply",     [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::unpremultiply((const Rgba *) s, (Rgba *) d, n);
+            }},
+            {"premultiplyToBgra", [](const uint8_t *s, uint8_t *d, uint64_t n) {
+                PixelConvert::premultiplyToBgra((const Rgba *) s, (Bgra *) d, n);
+            }},
+    };
+
+    const PixelConvert::Kernel::Enum kernels[] = {
+            PixelConvert::Kernel::Scalar, PixelConvert::Kernel::SSE2,
+            PixelConvert::Kernel::AVX2, PixelConvert::Kernel::NEON
+    };
+
+    printf("%llu pixels, best of 20, Mpixel/s (speedup over scalar)\n", (unsigned long long) count);
+    printf("%-18s", "");
+    for (auto kernel : kernels) {
+        if (PixelConvert::setKernel(kernel)) {
+            printf("%18s", kernelName(kernel));
+        }
+    }
+    printf("\n");
+
+    for (const Case &c : cases) {
+        printf("%-18s", c.name);
+        double scalar = 0;
+        for (auto kernel : kernels) {
+            if (!PixelConvert::setKernel(kernel)) {
+                continue;
+            }
+            const double seconds = bestOf(20, [&] { c.run(src.data(), dst.data(), count); });
+            const double rate = count / seconds / 1e6;
+            if (kernel == PixelConvert::Kernel::Scalar) {
+                scalar = rate;
+                printf("%18.1f", rate);
+            } else {
+                printf("%10.1f (%4.1fx)", rate, rate / scalar);
+            }
+        }
+        printf("\n");
+    }
+    PixelConvert::setKernel(PixelConvert::bestKernel());
+    return 0;
+}
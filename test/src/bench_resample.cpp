@@ -0,0 +1,83 @@
+//
+// Resample throughput of each filter for common down and up scales, with the scalar kernels and the best
+// kernel set of this CPU, in sRGB and linear light
+//
+// Usage: BenchResample [width=1920] [height=1080]
+//
+
+#include "bench_timer.h"
+
+#include <gxx/bitmap.h>
+#include <gxx/color.h>
+#include <gxx/pixelconvert.h>
+#include <gxx/resample.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+
+using namespace gxx;
+
+int main(int argc, char *argv[])
+{
+    const uint32_t width = argc > 1 ? (uint32_t) std::max(8, atoi(argv[1])) : 1920;
+    const uint32_t height = argc > 2 ? (uint32_t) std::max(8, atoi(argv[2])) : 1080;
+
+    Bitmap<Rgba> src(width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        Rgba *row = src.view().row(y);
+        for (uint32_t x = 0; x < width; x++) {
+            row[x].r = (uint8_t) (x * 7);
+            row[x].g = (uint8_t) (y * 3);
+            row[x].b = (uint8_t) (x ^ y);
+            row[x].a = (uint8_t) (x + y < 64 ? x + y : 255);
+        }
+    }
+
+    struct Scale
+    {
+        const char *name;
+        double factor;
+    } scales[] = {
+            {"down 1/4", 0.25},
+            {"down 1/2", 0.5},
+            {"down 2/3", 2.0 / 3.0},
+            {"up 3/2", 1.5},
+            {"up 2", 2.0},
+    };
+    struct FilterCase
+    {
+        const char *name;
+        Resample::Filter::Enum filter;
+    } filters[] = {
+            {"Box",      Resample::Filter::Box},
+            {"Bilinear", Resample::Filter::Bilinear},
+            {"Lanczos3", Resample::Filter::Lanczos3},
+    };
+    const PixelConvert::Kernel::Enum best = PixelConvert::bestKernel();
+
+    printf("source %ux%u, best of 3, ms per call\n", width, height);
+    printf("%-10s %-9s %12s %12s %12s %12s\n", "scale", "filter", "scalar", "simd", "scalar lin", "simd lin");
+    for (const Scale &scale : scales) {
+        const auto dstWidth = (uint32_t) std::max(1.0, width * scale.factor);
+        const auto dstHeight = (uint32_t) std::max(1.0, height * scale.factor);
+        Bitmap<Rgba> dst(dstWidth, dstHeight);
+
+        for (const FilterCase &f : filters) {
+            printf("%-10s %-9s", scale.name, f.name);
+            for (bool linear : {false, true}) {
+                for (auto kernel : {PixelConvert::Kernel::Scalar, best}) {
+                    PixelConvert::setKernel(kernel);
+                    const double seconds = bestOf(3, [&] {
+                        Resample::resample(dst.view(), src.view(), f.filter, linear);
+                    });
+                    printf(" %12.2f", seconds * 1e3);
+                }
+            }
+            printf("\n");
+        }
+    }
+    PixelConvert::setKernel(best);
+    return 0;
+}
@@ -0,0 +1,81 @@
+//
+// Flip, rotate and transpose of a row-major bitmap against the same image in 64 x 64 tiles,
+// and against a naive per pixel loop for reference
+//
+// Usage: BenchRotate [width=4096] [height=4096]
+//
+
+#include "bench_timer.h"
+
+#include <gxx/bitmap.h>
+#include <gxx/tiledbitmap.h>
+#include <gxx/transform.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+
+using namespace gxx;
+
+using Op = BitmapTransform::Op;
+
+/**
+ * Clockwise quarter turn reading the source row by row, the destination is written by columns
+ */
+static void naiveRotate90(const BitmapView<uint32_t> &dst, const BitmapView<const uint32_t> &src)
+{
+    const uint32_t height = src.height();
+    for (uint32_t y = 0; y < height; y++) {
+        const uint32_t *row = src.row(y);
+        for (uint32_t x = 0; x < src.width(); x++) {
+            dst.row(x)[height - 1 - y] = row[x];
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const uint32_t width = argc > 1 ? (uint32_t) std::max(1, atoi(argv[1])) : 4096;
+    const uint32_t height = argc > 2 ? (uint32_t) std::max(1, atoi(argv[2])) : 4096;
+
+    Bitmap<uint32_t> linear(width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        uint32_t *row = linear.view().row(y);
+        for (uint32_t x = 0; x < width; x++) {
+            row[x] = y * width + x;
+        }
+    }
+    const TiledBitmap<uint32_t> tiled(linear.view());
+    const double megapixels = (double) width * height / 1e6;
+
+    struct OpCase
+    {
+        const char *name;
+        Op::Enum op;
+    } ops[] = {
+            {"FlipHorizontal", Op::FlipHorizontal},
+            {"FlipVertical",   Op::FlipVertical},
+            {"Rotate90",       Op::Rotate90},
+            {"Rotate180",      Op::Rotate180},
+            {"Rotate270",      Op::Rotate270},
+            {"Transpose",      Op::Transpose},
+    };
+
+    printf("%ux%u of 4 byte pixels, best of 5, ms per call\n", width, height);
+    printf("%-16s %10s %10s %10s\n", "op", "linear", "tiled", "best Mpx/s");
+
+    Bitmap<uint32_t> naive(height, width);
+    const double naiveSeconds = bestOf(5, [&] { naiveRotate90(naive.view(), linear.view()); });
+    printf("%-16s %10.2f %10s %10.1f\n", "Rotate90 naive", naiveSeconds * 1e3, "-", megapixels / naiveSeconds);
+
+    for (const OpCase &c : ops) {
+        Bitmap<uint32_t> linearResult;
+        TiledBitmap<uint32_t> tiledResult;
+        const double linearSeconds = bestOf(5, [&] { linearResult = BitmapTransform::applied(linear, c.op); });
+        const double tiledSeconds = bestOf(5, [&] { tiledResult = BitmapTransform::applied(tiled, c.op); });
+        printf("%-16s %10.2f %10.2f %10.1f\n", c.name, linearSeconds * 1e3, tiledSeconds * 1e3,
+               megapixels / std::min(linearSeconds, tiledSeconds));
+    }
+    return 0;
+}
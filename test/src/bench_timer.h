@@ -0,0 +1,31 @@
+//
+// Timing helper of the benchmarks, reports the best of several runs to hide scheduler noise
+//
+
+#ifndef GXX_BENCH_TIMER_H
+#define GXX_BENCH_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+
+/**
+ * @return The fastest run of fn in seconds, after one warm-up call
+ */
+template<typename F>
+static double bestOf(uint32_t runs, F &&fn)
+{
+    fn();
+    double best = 1e30;
+    for (uint32_t i = 0; i < runs; i++) {
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+    return best;
+}
+
+#endif //GXX_BENCH_TIMER_H
@@ -0,0 +1,96 @@
+//
+// Many-window event pump benchmark
+// Opens N windows that nudge their position every frame so each one receives configure events,
+// and reports the native pump time per window and the window system traffic per frame.
+//
+// Usage: BenchWindowPump [windows=32] [frames=600]
+// Needs a display, e.g. xvfb-run ./BenchWindowPump 64 1000
+//
+
+#include <gxx/application.h>
+#include <gxx/app_entry.h>
+#include <gxx/window.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+using namespace gxx;
+
+class PumpWindow;
+
+static std::vector<PumpWindow *> sWindows;
+static uint32_t sFrames = 600;
+
+class PumpWindow : public Window
+{
+public:
+    explicit PumpWindow(uint32_t index)
+            : Window("BenchWindowPump"),
+              mIndex(index)
+    {
+        setSize(160, 120);
+        setWindowPos((int32_t) (index % 8) * 170, (int32_t) (index / 8) * 130);
+    }
+
+protected:
+    bool update(double delta) override
+    {
+        // Alternate by one pixel so the window system sends a ConfigureNotify every frame
+        const auto pos = position();
+        setWindowPos(pos.first + ((mFrame & 1) ? -1 : 1), pos.second);
+        mFrame++;
+
+        if (mIndex == 0 && mFrame > 1) {
+            const NativeFrameStats native = Application::application()->getAppContext()->nativeFrameStats();
+            mRoundTrips += native.roundTrips;
+            mFlushes += native.flushes;
+            if (mFrame == sFrames) {
+                report();
+                Application::application()->quit();
+            }
+        }
+        return Window::update(delta);
+    }
+
+private:
+    void report() const
+    {
+        double pump = 0;
+        for (PumpWindow *w : sWindows) {
+            pump += w->frameStats().summary().average.phases[FramePhase::NativePump];
+        }
+        const FrameSummary loop = frameStats().summary();
+        const double frames = mFrame - 1;
+
+        printf("windows %zu, frames %u\n", sWindows.size(), mFrame);
+        printf("loop            p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n",
+               loop.p50 * 1e3, loop.p99 * 1e3, loop.max * 1e3);
+        printf("native pump     %8.3f us per window per frame\n", pump / sWindows.size() * 1e6);
+        printf("round trips     %8.3f per frame\n", mRoundTrips / frames);
+        printf("flushes         %8.3f per frame\n", mFlushes / frames);
+    }
+
+private:
+    uint32_t mIndex;
+    uint32_t mFrame = 0;
+    uint64_t mRoundTrips = 0;
+    uint64_t mFlushes = 0;
+};
+
+int main(int argc, char *argv[])
+{
+    const uint32_t windows = argc > 1 ? (uint32_t) std::max(1, atoi(argv[1])) : 32;
+    sFrames = argc > 2 ? (uint32_t) std::max(2, atoi(argv[2])) : 600;
+
+    Application app(argc, argv);
+    app.setName("BenchWindowPump");
+    for (uint32_t i = 0; i < windows; i++) {
+        auto *window = new PumpWindow(i);
+        sWindows.push_back(window);
+        app.addWindow(window);
+    }
+    return app.exec();
+}
@@ -0,0 +1,129 @@
+//
+// BitmapPool: size class boundaries, reuse of freed buffers, eviction down to the cache limit
+// and bitmaps growing within the capacity of their class
+//
+
+#include "test_check.h"
+
+#include <gxx/bitmappool.h>
+#include <gxx/color.h>
+
+
+using namespace gxx;
+
+static void testClassBoundaries()
+{
+    CHECK_EQ(BitmapPool::classSize(0), BitmapPool::kMinClassSize);
+    CHECK_EQ(BitmapPool::classSize(1), BitmapPool::kMinClassSize);
+    CHECK_EQ(BitmapPool::classSize(4096), 4096u);
+
+    // Four classes between consecutive powers of two
+    CHECK_EQ(BitmapPool::classSize(4097), 5120u);
+    CHECK_EQ(BitmapPool::classSize(5120), 5120u);
+    CHECK_EQ(BitmapPool::classSize(5121), 6144u);
+    CHECK_EQ(BitmapPool::classSize(7169), 8192u);
+    CHECK_EQ(BitmapPool::classSize(8192), 8192u);
+    CHECK_EQ(BitmapPool::classSize(8193), 10240u);
+    CHECK_EQ(BitmapPool::classSize(1024 * 1024 + 1), 1024u * 1024 + 256 * 1024);
+
+    // Largest pooled class, beyond it sizes are only rounded to the alignment
+    CHECK_EQ(BitmapPool::classSize(BitmapPool::kMaxPooledSize), BitmapPool::kMaxPooledSize);
+    CHECK_EQ(BitmapPool::classSize(BitmapPool::kMaxPooledSize + 1),
+             BitmapPool::kMaxPooledSize + BitmapPool::kAlignment);
+    CHECK_EQ(BitmapPool::classSize(BitmapPool::kMaxPooledSize + 64), BitmapPool::kMaxPooledSize + 64);
+
+    bool valid = true;
+    size_t previous = 0;
+    for (size_t size = 1; size < 300000; size += 7) {
+        const size_t capacity = BitmapPool::classSize(size);
+        valid = valid && capacity >= size;
+        valid = valid && capacity % BitmapPool::kAlignment == 0;
+        valid = valid && capacity >= previous;
+        // A class never wastes a quarter or more of the largest request it serves
+        valid = valid && (size <= BitmapPool::kMinClassSize || capacity * 4 < size * 5 + 4 * BitmapPool::kAlignment);
+        // Capacities are classes themselves
+        valid = valid && BitmapPool::classSize(capacity) == capacity;
+        previous = capacity;
+    }
+    CHECK(valid);
+}
+
+static void testReuseAndEviction()
+{
+    BitmapPool::trim();
+    BitmapPool::setMaxCachedBytes(64 * 1024 * 1024);
+    BitmapPool pool;
+
+    // Requests of one class share buffers
+    const BitmapPool::Stats start = BitmapPool::stats();
+    void *a = pool.alloc(5000);
+    pool.free(a, 5000);
+    CHECK_EQ(BitmapPool::stats().cachedBytes, 5120u);
+    void *b = pool.alloc(5100);
+    CHECK(a == b);
+    CHECK_EQ(BitmapPool::stats().hits, start.hits + 1);
+    CHECK_EQ(BitmapPool::stats().misses, start.misses + 1);
+    pool.free(b, 5100);
+
+    void *buffers[4];
+    const size_t sizes[4] = {4096, 8192, 65536, 65536};
+    for (int i = 0; i < 4; i++) {
+        buffers[i] = pool.alloc(sizes[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pool.free(buffers[i], sizes[i]);
+    }
+    CHECK_EQ(BitmapPool::stats().cachedBytes, 5120u + 4096 + 8192 + 65536 * 2);
+
+    // Lowering the limit only evicts until the cache fits
+    BitmapPool::setMaxCachedBytes(100000);
+    const uint64_t cached = BitmapPool::stats().cachedBytes;
+    CHECK(cached <= 100000);
+    CHECK(cached > 0);
+    const uint64_t hits = BitmapPool::stats().hits;
+    void *small = pool.alloc(4096);
+    CHECK_EQ(BitmapPool::stats().hits, hits + 1);
+    pool.free(small, 4096);
+
+    BitmapPool::trim();
+    CHECK_EQ(BitmapPool::stats().cachedBytes, 0u);
+    BitmapPool::setMaxCachedBytes(64 * 1024 * 1024);
+}
+
+static void testBitmapCapacity()
+{
+    // 100x100 of 4 bytes is 40000 bytes in the 40960 class, growing within it keeps the buffer
+    PooledBitmap<uint32_t> bitmap(100, 100);
+    const unsigned char *pixels = bitmap.data();
+    bitmap.reset(101, 100);
+    CHECK(bitmap.data() == pixels);
+    bitmap.reset(102, 100);
+    CHECK(bitmap.data() == pixels);
+    CHECK_EQ(bitmap.getPixel(101, 99), 0u);
+    bitmap.reset(200, 100);
+    CHECK(bitmap.data() != pixels);
+
+    // An empty bitmap has no buffer to grow into
+    PooledBitmap<Rgba> empty(0, 0);
+    CHECK(empty.data() == nullptr);
+    empty.reset(16, 16);
+    CHECK(empty.data() != nullptr);
+    CHECK_EQ(empty.getPixel(15, 15).a, 0);
+
+    // Nor has a shared bitmap reset to empty
+    PooledBitmap<Rgba> shared(8, 8);
+    PooledBitmap<Rgba> other = shared.share();
+    shared.reset(0, 0);
+    shared.reset(4, 4);
+    CHECK(shared.data() != nullptr);
+    CHECK(shared.data() != other.data());
+    CHECK_EQ(shared.getPixel(3, 3).a, 0);
+}
+
+int main()
+{
+    testClassBoundaries();
+    testReuseAndEviction();
+    testBitmapCapacity();
+    return checkResult("TestBitmapPool");
+}
@@ -0,0 +1,197 @@
+//
+// Blit: clipping of sources placed at negative and overflowing offsets, and source-over rounding
+// of every kernel set against an exact reference
+//
+
+#include "test_check.h"
+
+#include <gxx/bitmap.h>
+#include <gxx/blit.h>
+#include <gxx/color.h>
+#include <gxx/pixelconvert.h>
+
+#include <cstdint>
+#include <cstring>
+#include <random>
+
+
+using namespace gxx;
+
+static Bitmap<uint32_t> numbered(uint32_t width, uint32_t height, uint32_t base)
+{
+    Bitmap<uint32_t> bitmap(width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            bitmap.setPixel(x, y, base + y * 1000 + x);
+        }
+    }
+    return bitmap;
+}
+
+/**
+ * Copies a numbered source to (x, y) of an empty destination and compares every destination pixel
+ * with the source pixel that lands on it
+ */
+static bool copyLandsAt(int32_t x, int32_t y, uint32_t srcW, uint32_t srcH, uint32_t dstW, uint32_t dstH)
+{
+    const Bitmap<uint32_t> src = numbered(srcW, srcH, 1);
+    Bitmap<uint32_t> dst(dstW, dstH);
+    Blit::copy(dst.view(), x, y, src.view());
+
+    for (uint32_t dy = 0; dy < dstH; dy++) {
+        for (uint32_t dx = 0; dx < dstW; dx++) {
+            const int64_t sx = (int64_t) dx - x;
+            const int64_t sy = (int64_t) dy - y;
+            const bool inside = sx >= 0 && sy >= 0 && sx < srcW && sy < srcH;
+            const uint32_t expected = inside ? src.getPixel((uint32_t) sx, (uint32_t) sy) : 0;
+            if (dst.getPixel(dx, dy) != expected) {
+                fprintf(stderr, "copy to (%d, %d): pixel (%u, %u) is %u, expected %u\n",
+                        x, y, dx, dy, dst.getPixel(dx, dy), expected);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void testClip()
+{
+    CHECK(copyLandsAt(0, 0, 5, 4, 10, 8));
+    CHECK(copyLandsAt(-3, 0, 5, 4, 10, 8));
+    CHECK(copyLandsAt(0, -2, 5, 4, 10, 8));
+    CHECK(copyLandsAt(-4, -3, 5, 4, 10, 8));
+    CHECK(copyLandsAt(7, 6, 5, 4, 10, 8));
+    CHECK(copyLandsAt(-2, 5, 5, 4, 10, 8));
+    // Larger than the destination on both sides
+    CHECK(copyLandsAt(-3, -2, 20, 20, 10, 8));
+    // Entirely outside, nothing is written
+    CHECK(copyLandsAt(-5, 0, 5, 4, 10, 8));
+    CHECK(copyLandsAt(0, -4, 5, 4, 10, 8));
+    CHECK(copyLandsAt(10, 0, 5, 4, 10, 8));
+    CHECK(copyLandsAt(0, 8, 5, 4, 10, 8));
+    CHECK(copyLandsAt(INT32_MIN, INT32_MIN, 5, 4, 10, 8));
+    CHECK(copyLandsAt(INT32_MAX, INT32_MAX, 5, 4, 10, 8));
+
+    // sourceOver clips the same way, opaque pixels replace the destination
+    Bitmap<Rgba> src(4, 4);
+    Rgba red;
+    red.r = 255;
+    red.g = red.b = 0;
+    red.a = 255;
+    src.fill(red);
+    Bitmap<Rgba> dst(6, 6);
+    Blit::sourceOver(dst.view(), -2, -3, src.view());
+    for (uint32_t y = 0; y < 6; y++) {
+        for (uint32_t x = 0; x < 6; x++) {
+            const bool covered = x < 2 && y < 1;
+            CHECK_EQ(dst.getPixel(x, y).a, covered ? 255 : 0);
+        }
+    }
+}
+
+static uint32_t div255(uint32_t t)
+{
+    // Exact nearest, 255 is odd so there are no ties
+    return (t * 2 + 255) / 510;
+}
+
+static Rgba referenceOver(Rgba d, Rgba s, uint8_t opacity)
+{
+    for (auto &c : s.v) {
+        c = (uint8_t) div255(c * opacity);
+    }
+    Rgba out;
+    for (int c = 0; c < 4; c++) {
+        out.v[c] = (uint8_t) std::min<uint32_t>(255, s.v[c] + div255(d.v[c] * (255 - s.a)));
+    }
+    return out;
+}
+
+static bool overMatchesReference(uint8_t opacity, uint32_t width)
+{
+    constexpr uint32_t kHeight = 3;
+    std::mt19937 rng(width * 31 + opacity);
+    Bitmap<Rgba> src(width, kHeight);
+    Bitmap<Rgba> dst(width, kHeight);
+    for (uint32_t y = 0; y < kHeight; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            // Premultiplied source, the colour never exceeds alpha
+            Rgba s;
+            s.a = (uint8_t) rng();
+            s.r = (uint8_t) (s.a ? rng() % (s.a + 1) : 0);
+            s.g = (uint8_t) (s.a ? rng() % (s.a + 1) : 0);
+            s.b = (uint8_t) (s.a ? rng() % (s.a + 1) : 0);
+            Rgba d;
+            for (auto &c : d.v) {
+                c = (uint8_t) rng();
+            }
+            src.setPixel(x, y, s);
+            dst.setPixel(x, y, d);
+        }
+    }
+    const Bitmap<Rgba> before = dst;
+    Blit::sourceOver(dst.view(), 0, 0, src.view(), opacity);
+
+    for (uint32_t y = 0; y < kHeight; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const Rgba expected = referenceOver(before.getPixel(x, y), src.getPixel(x, y), opacity);
+            const Rgba actual = dst.getPixel(x, y);
+            if (memcmp(expected.v, actual.v, 4) != 0) {
+                fprintf(stderr, "sourceOver kernel %d, opacity %u, width %u: pixel (%u, %u) differs\n",
+                        PixelConvert::kernel(), opacity, width, x, y);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void testSourceOver()
+{
+    const PixelConvert::Kernel::Enum kernels[] = {
+            PixelConvert::Kernel::Scalar, PixelConvert::Kernel::SSE2,
+            PixelConvert::Kernel::AVX2, PixelConvert::Kernel::NEON
+    };
+    const uint8_t opacities[] = {255, 254, 128, 1};
+    for (auto kernel : kernels) {
+        if (!PixelConvert::setKernel(kernel)) {
+            continue;
+        }
+        for (uint8_t opacity : opacities) {
+            // Widths around the vector sizes exercise the scalar tails
+            for (uint32_t width = 1; width <= 37; width++) {
+                CHECK(overMatchesReference(opacity, width));
+            }
+            CHECK(overMatchesReference(opacity, 1023));
+        }
+    }
+    PixelConvert::setKernel(PixelConvert::bestKernel());
+
+    // Fully transparent sources and zero opacity leave the destination alone
+    Bitmap<Rgba> dst(3, 1);
+    Rgba grey;
+    grey.r = grey.g = grey.b = 100;
+    grey.a = 200;
+    dst.fill(grey);
+    Bitmap<Rgba> clear(3, 1);
+    Blit::sourceOver(dst.view(), 0, 0, clear.view());
+    CHECK_EQ(dst.getPixel(1, 0).r, 100);
+    CHECK_EQ(dst.getPixel(1, 0).a, 200);
+
+    Bitmap<Rgba> white(3, 1);
+    Rgba w;
+    w.r = w.g = w.b = w.a = 255;
+    white.fill(w);
+    Blit::sourceOver(dst.view(), 0, 0, white.view(), 0);
+    CHECK_EQ(dst.getPixel(1, 0).r, 100);
+    Blit::sourceOver(dst.view(), 0, 0, white.view());
+    CHECK_EQ(dst.getPixel(1, 0).r, 255);
+    CHECK_EQ(dst.getPixel(1, 0).a, 255);
+}
+
+int main()
+{
+    testClip();
+    testSourceOver();
+    return checkResult("TestBlit");
+}
@@ -0,0 +1,42 @@
+//
+// Minimal checks for the behavior tests, a failed check is reported and the test exits non-zero
+//
+
+#ifndef GXX_TEST_CHECK_H
+#define GXX_TEST_CHECK_H
+
+#include <cstdio>
+
+
+static int sCheckFailures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #cond); \
+            sCheckFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        const auto _a = (a); \
+        const auto _b = (b); \
+        if (!(_a == _b)) { \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s == %s (%lld vs %lld)\n", __FILE__, __LINE__, #a, #b, \
+                    (long long) _a, (long long) _b); \
+            sCheckFailures++; \
+        } \
+    } while (0)
+
+static int checkResult(const char *name)
+{
+    if (sCheckFailures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", name, sCheckFailures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif //GXX_TEST_CHECK_H
@@ -0,0 +1,135 @@
+//
+// FrameBuffer dirty rects: clipping, merging of overlapping and adjacent rects, collapse above kMaxDirtyRects
+//
+
+#include "test_check.h"
+
+#include <gxx/framebuffer.h>
+
+#include <vector>
+
+
+using namespace gxx;
+
+class MemoryFrameBuffer : public FrameBuffer
+{
+public:
+    MemoryFrameBuffer(uint32_t width, uint32_t height)
+            : FrameBuffer(width, height, width * 4, PixelFormat::Bgra, allocate(width, height))
+    {}
+
+private:
+    unsigned char *allocate(uint32_t width, uint32_t height)
+    {
+        mPixels.resize((size_t) width * height * 4);
+        return mPixels.data();
+    }
+
+    std::vector<unsigned char> mPixels;
+};
+
+static bool hasRect(const FrameBuffer &fb, int32_t x, int32_t y, uint32_t w, uint32_t h)
+{
+    for (const FrameBuffer::Rect &r : fb.dirtyRects()) {
+        if (r.x == x && r.y == y && r.width == w && r.height == h) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void testClip()
+{
+    MemoryFrameBuffer fb(100, 50);
+    fb.markDirty(-20, -20, 10, 10);
+    fb.markDirty(100, 0, 10, 10);
+    fb.markDirty(0, 0, 0, 10);
+    CHECK(fb.dirtyRects().empty());
+
+    fb.markDirty(-10, -5, 20, 10);
+    fb.markDirty(90, 45, 30, 30);
+    CHECK_EQ(fb.dirtyRects().size(), 2u);
+    CHECK(hasRect(fb, 0, 0, 10, 5));
+    CHECK(hasRect(fb, 90, 45, 10, 5));
+
+    fb.markDirty();
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 0, 0, 100, 50));
+
+    fb.clearDirty();
+    CHECK(fb.dirtyRects().empty());
+}
+
+static void testMerge()
+{
+    MemoryFrameBuffer fb(100, 100);
+
+    // Overlapping
+    fb.markDirty(0, 0, 10, 10);
+    fb.markDirty(5, 5, 10, 10);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 0, 0, 15, 15));
+    fb.clearDirty();
+
+    // Sharing an edge
+    fb.markDirty(0, 0, 10, 10);
+    fb.markDirty(10, 0, 10, 10);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 0, 0, 20, 10));
+    fb.clearDirty();
+
+    // Sharing only a corner stays apart
+    fb.markDirty(0, 0, 10, 10);
+    fb.markDirty(10, 10, 10, 10);
+    CHECK_EQ(fb.dirtyRects().size(), 2u);
+    fb.clearDirty();
+
+    // A bridging rect pulls in rects that only reach the merged result
+    fb.markDirty(0, 0, 10, 10);
+    fb.markDirty(30, 0, 10, 10);
+    fb.markDirty(60, 0, 10, 10);
+    CHECK_EQ(fb.dirtyRects().size(), 3u);
+    fb.markDirty(5, 2, 30, 4);
+    CHECK_EQ(fb.dirtyRects().size(), 2u);
+    CHECK(hasRect(fb, 0, 0, 40, 10));
+    fb.markDirty(35, 2, 30, 4);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 0, 0, 70, 10));
+    fb.clearDirty();
+
+    // Contained
+    fb.markDirty(10, 10, 50, 50);
+    fb.markDirty(20, 20, 5, 5);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 10, 10, 50, 50));
+}
+
+static void testCollapse()
+{
+    MemoryFrameBuffer fb(200, 100);
+
+    // Separate 2x2 rects 4 pixels apart, kMaxDirtyRects of them are kept as they are
+    for (uint32_t i = 0; i < FrameBuffer::kMaxDirtyRects; i++) {
+        fb.markDirty((int32_t) i * 6, 10, 2, 2);
+    }
+    CHECK_EQ(fb.dirtyRects().size(), FrameBuffer::kMaxDirtyRects);
+
+    // One more collapses everything into the bounding box
+    fb.markDirty(150, 50, 3, 3);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    CHECK(hasRect(fb, 0, 10, 153, 43));
+
+    // Later rects merge into the box or start a new list
+    fb.markDirty(20, 20, 5, 5);
+    CHECK_EQ(fb.dirtyRects().size(), 1u);
+    fb.markDirty(190, 90, 5, 5);
+    CHECK_EQ(fb.dirtyRects().size(), 2u);
+}
+
+int main()
+{
+    testClip();
+    testMerge();
+    testCollapse();
+    return checkResult("TestFrameBuffer");
+}
@@ -0,0 +1,125 @@
+//
+// FrameStats: nearest-rank percentiles, ring buffer overwrite, phase averages and hitch reports
+//
+
+#include "test_check.h"
+
+#include <gxx/framestats.h>
+
+#include <cmath>
+
+
+using namespace gxx;
+
+static bool near(double a, double b)
+{
+    return std::fabs(a - b) < 1e-9;
+}
+
+static FrameTiming timing(double total)
+{
+    FrameTiming t;
+    t.total = total;
+    t.phases[FramePhase::NativePump] = total * 0.25;
+    t.phases[FramePhase::Update] = total * 0.5;
+    return t;
+}
+
+static void testEmptyAndSingle()
+{
+    FrameStats stats;
+    FrameSummary summary = stats.summary();
+    CHECK_EQ(summary.frames, 0u);
+    CHECK(near(summary.p50, 0) && near(summary.max, 0));
+
+    stats.addFrame(timing(0.016));
+    summary = stats.summary();
+    CHECK_EQ(summary.frames, 1u);
+    CHECK(near(summary.p50, 0.016));
+    CHECK(near(summary.p99, 0.016));
+    CHECK(near(summary.max, 0.016));
+}
+
+static void testPercentiles()
+{
+    // Totals 1..100 ms added out of order, nearest rank gives the k-th smallest for pk
+    FrameStats stats;
+    for (int i = 0; i < 100; i++) {
+        const int ms = (i * 37) % 100 + 1;
+        stats.addFrame(timing(ms / 1000.0));
+    }
+    const FrameSummary summary = stats.summary();
+    CHECK_EQ(summary.frames, 100u);
+    CHECK(near(summary.p50, 0.050));
+    CHECK(near(summary.p95, 0.095));
+    CHECK(near(summary.p99, 0.099));
+    CHECK(near(summary.max, 0.100));
+    CHECK(near(summary.average.total, 0.0505));
+    CHECK(near(summary.average.phases[FramePhase::NativePump], 0.0505 * 0.25));
+    CHECK(near(summary.average.phases[FramePhase::Update], 0.0505 * 0.5));
+    CHECK(near(summary.average.phases[FramePhase::Events], 0));
+
+    // Ten frames: p95 and p99 both land on the slowest one
+    FrameStats small;
+    for (int i = 1; i <= 10; i++) {
+        small.addFrame(timing(i));
+    }
+    const FrameSummary smallSummary = small.summary();
+    CHECK(near(smallSummary.p50, 5));
+    CHECK(near(smallSummary.p95, 10));
+    CHECK(near(smallSummary.p99, 10));
+}
+
+static void testRingOverwrite()
+{
+    // Only the last kCapacity frames count, the early slow frames fall out of the window
+    FrameStats stats;
+    for (uint32_t i = 0; i < 44; i++) {
+        stats.addFrame(timing(1.0));
+    }
+    for (uint32_t i = 0; i < FrameStats::kCapacity; i++) {
+        stats.addFrame(timing((i + 1) / 1000.0));
+    }
+    CHECK_EQ(stats.count(), FrameStats::kCapacity);
+    CHECK(near(stats.frame(0).total, 0.001));
+    CHECK(near(stats.lastFrame().total, FrameStats::kCapacity / 1000.0));
+
+    const FrameSummary summary = stats.summary();
+    CHECK(near(summary.max, FrameStats::kCapacity / 1000.0));
+    CHECK(near(summary.p50, 0.128));
+
+    stats.reset();
+    CHECK_EQ(stats.count(), 0u);
+    CHECK_EQ(stats.summary().frames, 0u);
+}
+
+static void testHitches()
+{
+    FrameStats stats;
+    int calls = 0;
+    double lastHitch = 0;
+    stats.setHitchCallback(0.020, [&](const FrameTiming &t) {
+        calls++;
+        lastHitch = t.total;
+    });
+    stats.addFrame(timing(0.010));
+    stats.addFrame(timing(0.020));
+    stats.addFrame(timing(0.030));
+    stats.addFrame(timing(0.015));
+    CHECK_EQ(calls, 1);
+    CHECK_EQ(stats.hitchCount(), 1u);
+    CHECK(near(lastHitch, 0.030));
+
+    stats.setHitchCallback(0, nullptr);
+    stats.addFrame(timing(1.0));
+    CHECK_EQ(stats.hitchCount(), 1u);
+}
+
+int main()
+{
+    testEmptyAndSingle();
+    testPercentiles();
+    testRingOverwrite();
+    testHitches();
+    return checkResult("TestFrameStats");
+}
@@ -0,0 +1,161 @@
+//
+// PixelConvert: every SIMD kernel set matches the scalar reference, for odd counts, unaligned
+// starts and tails shorter than a vector, and the scalar rounding matches its documented formula
+//
+
+#include "test_check.h"
+
+#include <gxx/pixelconvert.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+using namespace gxx;
+
+static const uint32_t kCounts[] = {
+        0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 47, 63, 64, 65, 95, 127, 129, 1021, 1024, 1027
+};
+
+static std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> bytes(size);
+    for (auto &b : bytes) {
+        b = (uint8_t) rng();
+    }
+    return bytes;
+}
+
+/**
+ * Runs the conversion with the scalar kernels and with the kernel set under test from every pixel
+ * offset in 0..3, the destination is guarded past the count so a kernel that writes a full vector
+ * into the tail is caught as well
+ */
+template<typename S, typename D>
+static bool matchesScalar(PixelConvert::Kernel::Enum kernel, void (*convert)(const S *, D *, uint64_t))
+{
+    constexpr uint32_t kGuard = 64;
+    bool match = true;
+    for (uint32_t count : kCounts) {
+        for (uint32_t offset = 0; offset < 4; offset++) {
+            const std::vector<uint8_t> src = randomBytes((count + offset) * sizeof(S), count * 7 + offset);
+            std::vector<uint8_t> expected((count + offset + kGuard) * sizeof(D), 0xcd);
+            std::vector<uint8_t> actual = expected;
+
+            PixelConvert::setKernel(PixelConvert::Kernel::Scalar);
+            convert((const S *) src.data() + offset, (D *) expected.data() + offset, count);
+            PixelConvert::setKernel(kernel);
+            convert((const S *) src.data() + offset, (D *) actual.data() + offset, count);
+
+            if (expected != actual) {
+                fprintf(stderr, "kernel %d differs from scalar, count %u, offset %u\n", kernel, count, offset);
+                match = false;
+            }
+        }
+    }
+    return match;
+}
+
+/**
+ * Conversions between 4 byte pixels may run in place
+ */
+template<typename S, typename D>
+static bool matchesInPlace(PixelConvert::Kernel::Enum kernel, void (*convert)(const S *, D *, uint64_t))
+{
+    const std::vector<uint8_t> src = randomBytes(1027 * 4, 99);
+    std::vector<uint8_t> expected(src.size());
+    std::vector<uint8_t> inPlace = src;
+
+    PixelConvert::setKernel(kernel);
+    convert((const S *) src.data(), (D *) expected.data(), 1027);
+    convert((const S *) inPlace.data(), (D *) inPlace.data(), 1027);
+    return expected == inPlace;
+}
+
+static void testKernel(PixelConvert::Kernel::Enum kernel)
+{
+    CHECK(matchesScalar(kernel, PixelConvert::rgbToRgba));
+    CHECK(matchesScalar(kernel, PixelConvert::rgbaToRgb));
+    CHECK(matchesScalar(kernel, PixelConvert::greyToRgba));
+    CHECK(matchesScalar(kernel, PixelConvert::greyAlphaToRgba));
+    CHECK(matchesScalar(kernel, PixelConvert::rgbaToBgra));
+    CHECK(matchesScalar(kernel, PixelConvert::bgraToRgba));
+    CHECK(matchesScalar(kernel, PixelConvert::premultiply));
+    CHECK(matchesScalar(kernel, PixelConvert::unpremultiply));
+    CHECK(matchesScalar(kernel, PixelConvert::premultiplyToBgra));
+
+    CHECK(matchesInPlace(kernel, PixelConvert::rgbaToBgra));
+    CHECK(matchesInPlace(kernel, PixelConvert::premultiply));
+    CHECK(matchesInPlace(kernel, PixelConvert::unpremultiply));
+    CHECK(matchesInPlace(kernel, PixelConvert::premultiplyToBgra));
+}
+
+static void testScalarRounding()
+{
+    // Every colour and alpha pair
+    std::vector<Rgba> src(256 * 256);
+    for (uint32_t a = 0; a < 256; a++) {
+        for (uint32_t c = 0; c < 256; c++) {
+            Rgba &p = src[a * 256 + c];
+            p.r = (uint8_t) c;
+            p.g = (uint8_t) (255 - c);
+            p.b = (uint8_t) (c / 2);
+            p.a = (uint8_t) a;
+        }
+    }
+    std::vector<Rgba> premul(src.size());
+    std::vector<Rgba> unpremul(src.size());
+    CHECK(PixelConvert::setKernel(PixelConvert::Kernel::Scalar));
+    PixelConvert::premultiply(src.data(), premul.data(), src.size());
+    PixelConvert::unpremultiply(src.data(), unpremul.data(), src.size());
+
+    bool premulOk = true;
+    bool unpremulOk = true;
+    for (size_t i = 0; i < src.size(); i++) {
+        const uint32_t a = src[i].a;
+        for (int ch = 0; ch < 3; ch++) {
+            const uint32_t c = src[i].v[ch];
+            // Nearest of c * a / 255, ties cannot happen as 255 is odd
+            premulOk = premulOk && premul[i].v[ch] == (c * a * 2 + 255) / 510;
+            const uint32_t clamped = c < a ? c : a;
+            const uint32_t un = a == 0 ? 0 : (clamped * 255 * 2 + a) / (2 * a);
+            unpremulOk = unpremulOk && unpremul[i].v[ch] == un;
+        }
+        premulOk = premulOk && premul[i].a == a;
+        unpremulOk = unpremulOk && unpremul[i].a == a;
+    }
+    CHECK(premulOk);
+    CHECK(unpremulOk);
+
+    // Opaque pixels survive the round trip
+    Rgba opaque;
+    opaque.r = 10;
+    opaque.g = 128;
+    opaque.b = 250;
+    opaque.a = 255;
+    Rgba out;
+    PixelConvert::premultiply(&opaque, &out, 1);
+    PixelConvert::unpremultiply(&out, &out, 1);
+    CHECK(memcmp(&opaque, &out, sizeof(Rgba)) == 0);
+}
+
+int main()
+{
+    const PixelConvert::Kernel::Enum best = PixelConvert::bestKernel();
+
+    testScalarRounding();
+
+    const PixelConvert::Kernel::Enum kernels[] = {
+            PixelConvert::Kernel::SSE2, PixelConvert::Kernel::AVX2, PixelConvert::Kernel::NEON
+    };
+    for (auto kernel : kernels) {
+        if (PixelConvert::setKernel(kernel)) {
+            printf("Testing kernel %d\n", kernel);
+            testKernel(kernel);
+        }
+    }
+    PixelConvert::setKernel(best);
+    return checkResult("TestPixelConvert");
+}
@@ -0,0 +1,241 @@
+//
+// Resample: identity and constant colour invariance of every filter, no colour bleed from transparent
+// pixels, every kernel set against the scalar one, the linear light round trip and the row band split
+//
+
+#include "test_check.h"
+
+#include <gxx/bitmap.h>
+#include <gxx/color.h>
+#include <gxx/pixelconvert.h>
+#include <gxx/resample.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+
+
+using namespace gxx;
+
+static const Resample::Filter::Enum kFilters[] = {
+        Resample::Filter::Box, Resample::Filter::Bilinear, Resample::Filter::Lanczos3
+};
+
+static Rgba rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    Rgba c;
+    c.r = r;
+    c.g = g;
+    c.b = b;
+    c.a = a;
+    return c;
+}
+
+static Bitmap<Rgba> randomImage(uint32_t width, uint32_t height, uint32_t seed, uint8_t minAlpha)
+{
+    std::mt19937 rng(seed);
+    Bitmap<Rgba> bitmap(width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            bitmap.setPixel(x, y, rgba((uint8_t) rng(), (uint8_t) rng(), (uint8_t) rng(),
+                                       (uint8_t) (minAlpha + rng() % (256 - minAlpha))));
+        }
+    }
+    return bitmap;
+}
+
+/**
+ * Largest channel difference between two images of the same size
+ */
+static int maxDifference(const Bitmap<Rgba> &a, const Bitmap<Rgba> &b)
+{
+    int diff = 0;
+    for (uint32_t y = 0; y < a.height(); y++) {
+        for (uint32_t x = 0; x < a.width(); x++) {
+            for (int c = 0; c < 4; c++) {
+                diff = std::max(diff, std::abs(a.getPixel(x, y).v[c] - b.getPixel(x, y).v[c]));
+            }
+        }
+    }
+    return diff;
+}
+
+static Bitmap<Rgba> resampleTo(const Bitmap<Rgba> &src, uint32_t width, uint32_t height,
+                               Resample::Filter::Enum filter, bool linearLight)
+{
+    Bitmap<Rgba> dst(width, height);
+    Resample::resample(dst.view(), src.view(), filter, linearLight);
+    return dst;
+}
+
+static void testIdentity()
+{
+    const Bitmap<Rgba> src = randomImage(37, 23, 1, 0);
+    for (auto filter : kFilters) {
+        for (bool linearLight : {false, true}) {
+            CHECK_EQ(maxDifference(resampleTo(src, 37, 23, filter, linearLight), src), 0);
+        }
+    }
+
+    // Same size shares the source instead of copying it
+    const Bitmap<Rgba> same = Resample::resampled(src, 37, 23);
+    CHECK(same.isShared());
+    CHECK_EQ(same.getPixel(5, 7).r, src.getPixel(5, 7).r);
+}
+
+static void testConstantColour()
+{
+    const Rgba colours[] = {rgba(200, 100, 30, 255), rgba(10, 240, 128, 77)};
+    const uint32_t sizes[][2] = {{13, 9}, {50, 70}, {1, 1}, {100, 3}};
+    for (const Rgba &colour : colours) {
+        Bitmap<Rgba> src(31, 29);
+        src.fill(colour);
+        for (auto filter : kFilters) {
+            for (bool linearLight : {false, true}) {
+                for (const auto &size : sizes) {
+                    Bitmap<Rgba> expected(size[0], size[1]);
+                    expected.fill(colour);
+                    const int diff = maxDifference(resampleTo(src, size[0], size[1], filter, linearLight), expected);
+                    if (diff > 1) {
+                        fprintf(stderr, "constant colour, filter %d, linear %d, %ux%u: off by %d\n",
+                                filter, linearLight, size[0], size[1], diff);
+                    }
+                    CHECK(diff <= 1);
+                }
+            }
+        }
+    }
+}
+
+static void testNoBleed()
+{
+    // Opaque red next to transparent green, the green must not show up in any covered pixel
+    Bitmap<Rgba> src(40, 40);
+    for (uint32_t y = 0; y < 40; y++) {
+        for (uint32_t x = 0; x < 40; x++) {
+            const bool left = ((x / 5) + (y / 5)) % 2 == 0;
+            src.setPixel(x, y, left ? rgba(255, 0, 0, 255) : rgba(0, 255, 0, 0));
+        }
+    }
+    for (auto filter : kFilters) {
+        for (bool linearLight : {false, true}) {
+            const uint32_t sizes[] = {7, 17, 93};
+            for (uint32_t size : sizes) {
+                const Bitmap<Rgba> dst = resampleTo(src, size, size, filter, linearLight);
+                bool clean = true;
+                for (uint32_t y = 0; y < size; y++) {
+                    for (uint32_t x = 0; x < size; x++) {
+                        const Rgba p = dst.getPixel(x, y);
+                        if (p.a > 0 && (p.r < 254 || p.g > 1 || p.b > 1)) {
+                            clean = false;
+                        }
+                    }
+                }
+                if (!clean) {
+                    fprintf(stderr, "colour bleed, filter %d, linear %d, size %u\n", filter, linearLight, size);
+                }
+                CHECK(clean);
+            }
+        }
+    }
+}
+
+static void testKernels()
+{
+    const PixelConvert::Kernel::Enum kernels[] = {
+            PixelConvert::Kernel::SSE2, PixelConvert::Kernel::AVX2, PixelConvert::Kernel::NEON
+    };
+    // Widths around the vector sizes exercise the scalar tails
+    const uint32_t sizes[][4] = {{37, 21, 13, 9}, {16, 16, 41, 35}, {64, 7, 33, 19}, {5, 5, 3, 2}};
+    for (const auto &size : sizes) {
+        const Bitmap<Rgba> src = randomImage(size[0], size[1], size[0] * 31 + size[2], 64);
+        for (auto filter : kFilters) {
+            for (bool linearLight : {false, true}) {
+                PixelConvert::setKernel(PixelConvert::Kernel::Scalar);
+                const Bitmap<Rgba> expected = resampleTo(src, size[2], size[3], filter, linearLight);
+                for (auto kernel : kernels) {
+                    if (!PixelConvert::setKernel(kernel)) {
+                        continue;
+                    }
+                    const int diff = maxDifference(resampleTo(src, size[2], size[3], filter, linearLight), expected);
+                    if (diff > 1) {
+                        fprintf(stderr, "kernel %d, filter %d, linear %d, %ux%u to %ux%u: off by %d\n",
+                                kernel, filter, linearLight, size[0], size[1], size[2], size[3], diff);
+                    }
+                    CHECK(diff <= 1);
+                }
+            }
+        }
+    }
+    PixelConvert::setKernel(PixelConvert::bestKernel());
+}
+
+static void testLinearLightRoundTrip()
+{
+    // Two equal rows averaged into one, every byte value goes through decode and encode
+    Bitmap<Rgba> src(256, 2);
+    for (uint32_t x = 0; x < 256; x++) {
+        src.setPixel(x, 0, rgba((uint8_t) x, (uint8_t) (255 - x), (uint8_t) x, 255));
+        src.setPixel(x, 1, src.getPixel(x, 0));
+    }
+    for (auto filter : kFilters) {
+        const Bitmap<Rgba> dst = resampleTo(src, 256, 1, filter, true);
+        bool exact = true;
+        for (uint32_t x = 0; x < 256; x++) {
+            const Rgba p = dst.getPixel(x, 0);
+            if (p.r != x || p.g != 255 - x || p.b != x || p.a != 255) {
+                fprintf(stderr, "linear light filter %d: %u became %u\n", filter, x, p.r);
+                exact = false;
+            }
+        }
+        CHECK(exact);
+    }
+}
+
+static void testRowBands()
+{
+    // Large enough to be split in row bands, only the width changes so every destination row
+    // must match the same row resampled on its own
+    const uint32_t width = 1024, height = 512, dstWidth = 701;
+    const Bitmap<Rgba> src = randomImage(width, height, 7, 0);
+    for (auto filter : kFilters) {
+        const Bitmap<Rgba> dst = resampleTo(src, dstWidth, height, filter, false);
+        Bitmap<Rgba> row(width, 1);
+        Bitmap<Rgba> expected(dstWidth, 1);
+        bool match = true;
+        for (uint32_t y = 0; y < height && match; y++) {
+            for (uint32_t x = 0; x < width; x++) {
+                row.setPixel(x, 0, src.getPixel(x, y));
+            }
+            Resample::resample(expected.view(), row.view(), filter);
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                for (int c = 0; c < 4; c++) {
+                    if (std::abs(dst.getPixel(x, y).v[c] - expected.getPixel(x, 0).v[c]) > 1) {
+                        fprintf(stderr, "row bands, filter %d: pixel (%u, %u) differs\n", filter, x, y);
+                        match = false;
+                    }
+                }
+            }
+        }
+        CHECK(match);
+    }
+
+    // Both directions scaled, a constant image stays constant across the band seams
+    Bitmap<Rgba> flat(width, height);
+    flat.fill(rgba(90, 180, 45, 255));
+    const Bitmap<Rgba> scaled = resampleTo(flat, 777, 1031, Resample::Filter::Lanczos3, true);
+    Bitmap<Rgba> expected(777, 1031);
+    expected.fill(rgba(90, 180, 45, 255));
+    CHECK(maxDifference(scaled, expected) <= 1);
+}
+
+int main()
+{
+    testIdentity();
+    testConstantColour();
+    testNoBleed();
+    testKernels();
+    testLinearLightRoundTrip();
+    testRowBands();
+    return checkResult("TestResample");
+}
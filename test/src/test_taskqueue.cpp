@@ -0,0 +1,173 @@
+//
+// TaskQueue: FIFO order, full/empty reports, index wraparound and concurrent producers/consumers
+//
+
+#include "test_check.h"
+
+#include <gxx/taskqueue.h>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+
+using namespace gxx;
+
+static void testFifoAndBounds()
+{
+    TaskQueue queue(8);
+    CHECK_EQ(queue.capacity(), 8u);
+
+    InlineTask task;
+    CHECK(!queue.pop(task));
+
+    std::vector<int> ran;
+    for (int i = 0; i < 8; i++) {
+        CHECK(queue.push([&ran, i] { ran.push_back(i); }));
+    }
+    // A rejected task stays with the caller
+    InlineTask extra([&ran] { ran.push_back(100); });
+    CHECK(!queue.push(std::move(extra)));
+    CHECK(static_cast<bool>(extra));
+
+    while (queue.pop(task)) {
+        task();
+    }
+    CHECK_EQ(ran.size(), 8u);
+    for (int i = 0; i < (int) ran.size(); i++) {
+        CHECK_EQ(ran[i], i);
+    }
+}
+
+static void testWraparound()
+{
+    // Interleaved pushes and pops walk the positions around the ring many times
+    TaskQueue queue(4);
+    int next = 0;
+    int expected = 0;
+    bool ordered = true;
+    InlineTask task;
+    for (int round = 0; round < 1000; round++) {
+        const int pushes = 1 + round % 4;
+        for (int i = 0; i < pushes; i++) {
+            const int value = next;
+            if (queue.push([&expected, &ordered, value] {
+                ordered = ordered && value == expected;
+                expected++;
+            })) {
+                next++;
+            }
+        }
+        const int pops = 1 + (round + 2) % 4;
+        for (int i = 0; i < pops && queue.pop(task); i++) {
+            task();
+        }
+    }
+    while (queue.pop(task)) {
+        task();
+    }
+    CHECK(ordered);
+    CHECK_EQ(expected, next);
+    CHECK(next > 1000);
+}
+
+static void produce(TaskQueue &queue, int producer, int count, const std::function<void(int, int)> &sink)
+{
+    for (int i = 0; i < count; i++) {
+        InlineTask task([&sink, producer, i] { sink(producer, i); });
+        while (!queue.push(std::move(task))) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static void testProducersKeepOrder()
+{
+    constexpr int kProducers = 4;
+    constexpr int kPerProducer = 50000;
+
+    // The single consumer must see the tasks of every producer in the order they were pushed
+    TaskQueue queue(256);
+    std::vector<int> next(kProducers, 0);
+    bool ordered = true;
+    const std::function<void(int, int)> sink = [&next, &ordered](int producer, int i) {
+        ordered = ordered && next[producer] == i;
+        next[producer] = i + 1;
+    };
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < kProducers; p++) {
+        producers.emplace_back([&queue, &sink, p] { produce(queue, p, kPerProducer, sink); });
+    }
+    InlineTask task;
+    int consumed = 0;
+    while (consumed < kProducers * kPerProducer) {
+        if (queue.pop(task)) {
+            task();
+            consumed++;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (auto &t : producers) {
+        t.join();
+    }
+
+    CHECK(ordered);
+    CHECK(!queue.pop(task));
+    for (int p = 0; p < kProducers; p++) {
+        CHECK_EQ(next[p], kPerProducer);
+    }
+}
+
+static void testConsumersRunEachTaskOnce()
+{
+    constexpr int kProducers = 4;
+    constexpr int kConsumers = 3;
+    constexpr int kPerProducer = 50000;
+    constexpr int kTotal = kProducers * kPerProducer;
+
+    TaskQueue queue(256);
+    std::vector<std::atomic<int>> runs(kTotal);
+    std::atomic<int> consumed{0};
+    const std::function<void(int, int)> sink = [&runs](int producer, int i) {
+        runs[producer * kPerProducer + i].fetch_add(1, std::memory_order_relaxed);
+    };
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; p++) {
+        threads.emplace_back([&queue, &sink, p] { produce(queue, p, kPerProducer, sink); });
+    }
+    for (int c = 0; c < kConsumers; c++) {
+        threads.emplace_back([&queue, &consumed] {
+            InlineTask task;
+            while (consumed.load() < kTotal) {
+                if (queue.pop(task)) {
+                    task();
+                    consumed.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    bool once = true;
+    for (auto &count : runs) {
+        once = once && count.load() == 1;
+    }
+    CHECK(once);
+}
+
+int main()
+{
+    testFifoAndBounds();
+    testWraparound();
+    testProducersKeepOrder();
+    testConsumersRunEachTaskOnce();
+    return checkResult("TestTaskQueue");
+}
@@ -0,0 +1,219 @@
+//
+// TiledBitmap: round trips with row-major bitmaps, and every BitmapTransform op on linear and
+// tiled bitmaps against a per pixel reference, including sizes that are not tile multiples
+//
+
+#include "test_check.h"
+
+#include <gxx/bitmap.h>
+#include <gxx/tiledbitmap.h>
+#include <gxx/transform.h>
+
+#include <cstring>
+#include <vector>
+
+
+using namespace gxx;
+
+using Op = BitmapTransform::Op;
+
+static const uint32_t kSizes[][2] = {
+        {1,   1},
+        {3,   5},
+        {8,   8},
+        {9,   7},
+        {64,  64},
+        {65,  63},
+        {100, 37},
+        {130, 129},
+};
+
+static Bitmap<uint32_t> numbered(uint32_t width, uint32_t height)
+{
+    Bitmap<uint32_t> bitmap(width, height);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            bitmap.setPixel(x, y, 1 + y * 1000 + x);
+        }
+    }
+    return bitmap;
+}
+
+/**
+ * Where the pixel (x, y) of a width x height source lands
+ */
+static void mapPixel(Op::Enum op, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+                     uint32_t &dx, uint32_t &dy)
+{
+    switch (op) {
+        case Op::FlipHorizontal:
+            dx = width - 1 - x;
+            dy = y;
+            break;
+        case Op::FlipVertical:
+            dx = x;
+            dy = height - 1 - y;
+            break;
+        case Op::Rotate90:
+            dx = height - 1 - y;
+            dy = x;
+            break;
+        case Op::Rotate180:
+            dx = width - 1 - x;
+            dy = height - 1 - y;
+            break;
+        case Op::Rotate270:
+            dx = y;
+            dy = width - 1 - x;
+            break;
+        case Op::Transpose:
+        default:
+            dx = y;
+            dy = x;
+            break;
+    }
+}
+
+template<typename RESULT>
+static bool matchesReference(const Bitmap<uint32_t> &src, const RESULT &result, Op::Enum op)
+{
+    const bool swap = BitmapTransform::swapsAxes(op);
+    if (result.width() != (swap ? src.height() : src.width()) ||
+        result.height() != (swap ? src.width() : src.height())) {
+        fprintf(stderr, "op %d: result size %ux%u\n", op, result.width(), result.height());
+        return false;
+    }
+    for (uint32_t y = 0; y < src.height(); y++) {
+        for (uint32_t x = 0; x < src.width(); x++) {
+            uint32_t dx, dy;
+            mapPixel(op, src.width(), src.height(), x, y, dx, dy);
+            if (result.getPixel(dx, dy) != src.getPixel(x, y)) {
+                fprintf(stderr, "op %d, %ux%u: source pixel (%u, %u) not at (%u, %u)\n",
+                        op, src.width(), src.height(), x, y, dx, dy);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template<uint32_t TILE_SIZE>
+static void testRoundTrip()
+{
+    using Tiled = TiledBitmapBase<gx::HeapPond, uint32_t, TILE_SIZE>;
+
+    for (const auto &size : kSizes) {
+        const Bitmap<uint32_t> linear = numbered(size[0], size[1]);
+        const Tiled tiled(linear.view());
+        CHECK_EQ(tiled.width(), size[0]);
+        CHECK_EQ(tiled.height(), size[1]);
+        CHECK_EQ(tiled.tilesX(), (size[0] + TILE_SIZE - 1) / TILE_SIZE);
+        CHECK_EQ(tiled.tilesY(), (size[1] + TILE_SIZE - 1) / TILE_SIZE);
+
+        bool same = true;
+        for (uint32_t y = 0; y < size[1]; y++) {
+            for (uint32_t x = 0; x < size[0]; x++) {
+                same = same && tiled.getPixel(x, y) == linear.getPixel(x, y);
+            }
+        }
+        CHECK(same);
+
+        const Bitmap<uint32_t> back = tiled.toBitmap();
+        CHECK(back.width() == linear.width() && back.height() == linear.height());
+        bool roundTrip = true;
+        for (uint32_t y = 0; y < size[1]; y++) {
+            roundTrip = roundTrip && memcmp(back.view().row(y), linear.view().row(y), size[0] * 4) == 0;
+        }
+        CHECK(roundTrip);
+
+        // Edge tiles only expose the part inside the image
+        const BitmapView<const uint32_t> edge = tiled.tile(tiled.tilesX() - 1, tiled.tilesY() - 1);
+        CHECK_EQ(edge.width(), size[0] - (tiled.tilesX() - 1) * TILE_SIZE);
+        CHECK_EQ(edge.height(), size[1] - (tiled.tilesY() - 1) * TILE_SIZE);
+        CHECK_EQ(edge.getPixel(edge.width() - 1, edge.height() - 1), linear.getPixel(size[0] - 1, size[1] - 1));
+
+        // copyTo clips to a smaller destination
+        Bitmap<uint32_t> part((size[0] + 1) / 2, (size[1] + 1) / 2);
+        tiled.copyTo(part.view());
+        CHECK_EQ(part.getPixel(part.width() - 1, part.height() - 1),
+                 linear.getPixel(part.width() - 1, part.height() - 1));
+    }
+
+    // Copy-on-write sharing
+    Tiled a(numbered(20, 20).view());
+    Tiled b = a.share();
+    CHECK(a.isShared() && b.isShared());
+    b.setPixel(3, 4, 7);
+    CHECK_EQ(b.getPixel(3, 4), 7u);
+    CHECK_EQ(a.getPixel(3, 4), 4004u);
+}
+
+/**
+ * Every pixel of the tile buffer outside the image is zero
+ */
+template<typename TILED>
+static bool paddingIsClear(const TILED &tiled)
+{
+    std::vector<bool> inside(tiled.byteSize() / sizeof(uint32_t));
+    for (uint32_t y = 0; y < tiled.height(); y++) {
+        for (uint32_t x = 0; x < tiled.width(); x++) {
+            inside[tiled.pixelIndex(x, y)] = true;
+        }
+    }
+    const auto *pixels = reinterpret_cast<const uint32_t *>(tiled.data());
+    for (size_t i = 0; i < inside.size(); i++) {
+        if (!inside[i] && pixels[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<uint32_t TILE_SIZE>
+static void testTransforms()
+{
+    using Tiled = TiledBitmapBase<gx::HeapPond, uint32_t, TILE_SIZE>;
+
+    const Op::Enum ops[] = {
+            Op::FlipHorizontal, Op::FlipVertical, Op::Rotate90, Op::Rotate180, Op::Rotate270, Op::Transpose
+    };
+    for (const auto &size : kSizes) {
+        const Bitmap<uint32_t> linear = numbered(size[0], size[1]);
+        const Tiled tiled(linear.view());
+        for (Op::Enum op : ops) {
+            CHECK(matchesReference(linear, BitmapTransform::applied(linear, op), op));
+            const Tiled result = BitmapTransform::applied(tiled, op);
+            CHECK(matchesReference(linear, result, op));
+            CHECK(paddingIsClear(result));
+        }
+        CHECK(paddingIsClear(tiled));
+
+        // A reused buffer keeps its old pixels inside the image but not in the padding
+        Tiled reused(size[0], size[1]);
+        reused.fill(0xffffffffu);
+        reused.resetUninitialized(size[1], size[0]);
+        CHECK(paddingIsClear(reused));
+
+        // Four quarter turns are the identity
+        Tiled turned = tiled;
+        for (int i = 0; i < 4; i++) {
+            turned = BitmapTransform::applied(turned, Op::Rotate90);
+        }
+        bool identity = turned.width() == tiled.width() && turned.height() == tiled.height();
+        for (uint32_t y = 0; identity && y < size[1]; y++) {
+            for (uint32_t x = 0; x < size[0]; x++) {
+                identity = identity && turned.getPixel(x, y) == tiled.getPixel(x, y);
+            }
+        }
+        CHECK(identity);
+    }
+}
+
+int main()
+{
+    testRoundTrip<8>();
+    testRoundTrip<64>();
+    testTransforms<8>();
+    testTransforms<64>();
+    return checkResult("TestTiledBitmap");
+}